@@ -27,6 +27,10 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include "bw_cache.h"
+#include "bw_parallel.h"
+#include "linphase.h"
 
 /*
  *                    Q^2*s^4 + 2*Q^2*s^2 + Q^2
@@ -78,6 +82,9 @@ enum {
     PORT_N,
     PORT_FREQUENCY,
     PORT_Q,
+    PORT_PARALLEL,
+    PORT_LINEAR,
+    PORT_LATENCY,
     PORT_NPORTS
 };
 
@@ -200,6 +207,10 @@ typedef struct {
     BQ_Filter    m_bq[N_BQ];
     int          m_N_bq;
     int          m_sp_on;
+    BW_Parallel  m_pf;
+    BW_Cache_Key m_key;
+    Linphase    *m_plinphase;
+    int          m_linear;
 } BW_BS_Data;
 
 void BW_BS_set(BW_BS_Data *p_pBW_BS, int p_N, LADSPA_Data p_K,
@@ -238,14 +249,127 @@ LADSPA_Data BW_BS_eval( BW_BS_Data *p_pBW_BS, LADSPA_Data x)
     return (LADSPA_Data)a;
 }
 
+static int BW_BS_ncoeff(int p_N)
+{
+    return 5 + 9*(p_N/2);
+}
+
+static void BW_BS_pack(BW_BS_Data *p_pBW_BS, double *p_pcoeff)
+{
+    p_pcoeff[0] = p_pBW_BS->m_sp.m_a1;
+    p_pcoeff[1] = p_pBW_BS->m_sp.m_a2;
+    p_pcoeff[2] = p_pBW_BS->m_sp.m_b0;
+    p_pcoeff[3] = p_pBW_BS->m_sp.m_b1;
+    p_pcoeff[4] = p_pBW_BS->m_sp.m_b2;
+    for(int i=0;i<p_pBW_BS->m_N_bq;i++){
+        double *l_pc = &p_pcoeff[5+9*i];
+        l_pc[0] = p_pBW_BS->m_bq[i].m_a1;
+        l_pc[1] = p_pBW_BS->m_bq[i].m_a2;
+        l_pc[2] = p_pBW_BS->m_bq[i].m_a3;
+        l_pc[3] = p_pBW_BS->m_bq[i].m_a4;
+        l_pc[4] = p_pBW_BS->m_bq[i].m_b0;
+        l_pc[5] = p_pBW_BS->m_bq[i].m_b1;
+        l_pc[6] = p_pBW_BS->m_bq[i].m_b2;
+        l_pc[7] = p_pBW_BS->m_bq[i].m_b3;
+        l_pc[8] = p_pBW_BS->m_bq[i].m_b4;
+    }
+}
+
+static void BW_BS_unpack(BW_BS_Data *p_pBW_BS, int p_N, const double *p_pcoeff)
+{
+    p_pBW_BS->m_sp.m_a1 = p_pcoeff[0];
+    p_pBW_BS->m_sp.m_a2 = p_pcoeff[1];
+    p_pBW_BS->m_sp.m_b0 = p_pcoeff[2];
+    p_pBW_BS->m_sp.m_b1 = p_pcoeff[3];
+    p_pBW_BS->m_sp.m_b2 = p_pcoeff[4];
+    p_pBW_BS->m_sp_on = p_N&1;
+    p_pBW_BS->m_N_bq = p_N/2;
+    for(int i=0;i<p_pBW_BS->m_N_bq;i++){
+        const double *l_pc = &p_pcoeff[5+9*i];
+        p_pBW_BS->m_bq[i].m_a1 = l_pc[0];
+        p_pBW_BS->m_bq[i].m_a2 = l_pc[1];
+        p_pBW_BS->m_bq[i].m_a3 = l_pc[2];
+        p_pBW_BS->m_bq[i].m_a4 = l_pc[3];
+        p_pBW_BS->m_bq[i].m_b0 = l_pc[4];
+        p_pBW_BS->m_bq[i].m_b1 = l_pc[5];
+        p_pBW_BS->m_bq[i].m_b2 = l_pc[6];
+        p_pBW_BS->m_bq[i].m_b3 = l_pc[7];
+        p_pBW_BS->m_bq[i].m_b4 = l_pc[8];
+    }
+}
+
+/*
+ * Load the coefficients for p_pkey from the shared design cache, or
+ * design them here and offer the result to the cache.
+ */
+static void BW_BS_design(BW_BS_Data *p_pBW_BS, const BW_Cache_Key *p_pkey,
+                         LADSPA_Data p_frequency,
+                         LADSPA_Data p_Q)
+{
+    double l_coeff[BW_CACHE_NCOEFF];
+    int l_parallel = p_pkey->m_type == BW_CACHE_BS_PARALLEL;
+    int l_ncoeff = l_parallel ? BW_PARALLEL_NCOEFF(p_pkey->m_N)
+                              : BW_BS_ncoeff(p_pkey->m_N);
+    if(BW_Cache_lookup(p_pkey, l_coeff, l_ncoeff)){
+        if(l_parallel)
+            BW_Parallel_unpack(&p_pBW_BS->m_pf, p_pkey->m_N, l_coeff);
+        else
+            BW_BS_unpack(p_pBW_BS, p_pkey->m_N, l_coeff);
+        return;
+    }
+    if(l_parallel){
+        double l_omega = 2.0*M_PI*p_frequency/p_pBW_BS->m_sample_rate;
+        double l_K = 1.0/tan(l_omega/2.0);
+        BW_Parallel_design(&p_pBW_BS->m_pf, p_pkey->m_N, l_K, p_Q, 1);
+        BW_Parallel_pack(&p_pBW_BS->m_pf, l_coeff);
+    } else {
+        LADSPA_Data l_omega = 2.0f*M_PIf*p_frequency;
+        l_omega /= p_pBW_BS->m_sample_rate;
+        LADSPA_Data l_K = 1.0f/tanf(l_omega/2.0f);
+        BW_BS_set(p_pBW_BS, p_pkey->m_N, l_K, p_Q);
+        BW_BS_pack(p_pBW_BS, l_coeff);
+    }
+    BW_Cache_store(p_pkey, l_coeff, l_ncoeff);
+}
+
+/*
+ * Linear phase mode, magnitude of the Butterworth prototype
+ *
+ *   |H| = 1/sqrt(1 + W^(2*N))
+ *
+ * at the prototype frequency W of the digital frequency omega, with
+ * the same prewarping as the bilinear transform above.
+ */
+typedef struct {
+    int    m_N;
+    double m_K;
+    double m_Q;
+} BW_BS_Linphase_Params;
+
+static double BW_BS_magnitude( const void *p_pparams, double p_omega )
+{
+    const BW_BS_Linphase_Params *l_pp = p_pparams;
+    double l_O = tan(p_omega/2.0)*l_pp->m_K;
+    double l_W = 1.0/(l_pp->m_Q*(l_O - 1.0/l_O));
+    return 1.0/sqrt(1.0 + pow(fabs(l_W), 2.0*l_pp->m_N));
+}
+
 static LADSPA_Handle BW_BS_instantiate(
     const struct _LADSPA_Descriptor *p_pDescriptor,
     unsigned long p_sample_rate)
 {
     BW_BS_Data *l_pBW_BS = malloc( sizeof(BW_BS_Data) );
     if(l_pBW_BS){
+        l_pBW_BS->m_plinphase = Linphase_new(BW_BS_magnitude);
+        if(!l_pBW_BS->m_plinphase){
+            free(l_pBW_BS);
+            return NULL;
+        }
+        l_pBW_BS->m_linear = 0;
         l_pBW_BS->m_sample_rate = (float)p_sample_rate;
+        l_pBW_BS->m_key.m_type = 0;
         SP_Filter_init(&l_pBW_BS->m_sp);
+        BW_Parallel_init(&l_pBW_BS->m_pf);
         for(int i=0;i<N_BQ;i++){
             BQ_Filter_init(&l_pBW_BS->m_bq[i]);
         }
@@ -271,13 +395,60 @@ static void BW_BS_run(
     LADSPA_Data *l_pdst = l_pBW_BS->m_pport[PORT_OUT];
     LADSPA_Data *l_psrc_end = l_psrc + p_sample_count;
 
-    int N = (int)*l_pBW_BS->m_pport[PORT_N];
-    LADSPA_Data l_omega = 2.0f*M_PIf* *l_pBW_BS->m_pport[PORT_FREQUENCY];
-    l_omega /= l_pBW_BS->m_sample_rate;
-    LADSPA_Data l_K = 1.0f/tanf(l_omega/2.0f);
-    LADSPA_Data l_Q = *l_pBW_BS->m_pport[PORT_Q];
-    BW_BS_set(l_pBW_BS, N, l_K, l_Q);
+    if(*l_pBW_BS->m_pport[PORT_LINEAR] > 0.5f){
+        BW_BS_Linphase_Params l_params;
+        memset(&l_params, 0, sizeof(l_params));
+        l_params.m_N = (int)*l_pBW_BS->m_pport[PORT_N];
+        l_params.m_K = 1.0/tan(M_PI* *l_pBW_BS->m_pport[PORT_FREQUENCY]/
+                               l_pBW_BS->m_sample_rate);
+        l_params.m_Q = *l_pBW_BS->m_pport[PORT_Q];
+        if(!l_pBW_BS->m_linear){
+            Linphase_reset(l_pBW_BS->m_plinphase);
+            l_pBW_BS->m_linear = 1;
+        }
+        Linphase_request(l_pBW_BS->m_plinphase, &l_params, sizeof(l_params));
+        *l_pBW_BS->m_pport[PORT_LATENCY] = (LADSPA_Data)LINPHASE_LATENCY;
+        Linphase_run(l_pBW_BS->m_plinphase, l_psrc, l_pdst, p_sample_count);
+        return;
+    }
+    if(l_pBW_BS->m_linear){
+        // back from linear phase mode, restart the recursive filter
+        SP_Filter_init(&l_pBW_BS->m_sp);
+        for(int i=0;i<N_BQ;i++){
+            BQ_Filter_init(&l_pBW_BS->m_bq[i]);
+        }
+        BW_Parallel_init(&l_pBW_BS->m_pf);
+        l_pBW_BS->m_linear = 0;
+    }
+    *l_pBW_BS->m_pport[PORT_LATENCY] = 0.0f;
+
+    BW_Cache_Key l_key;
+    LADSPA_Data l_frequency = *l_pBW_BS->m_pport[PORT_FREQUENCY];
+    int l_parallel = *l_pBW_BS->m_pport[PORT_PARALLEL] > 0.5f;
+    l_key.m_type = l_parallel ? BW_CACHE_BS_PARALLEL : BW_CACHE_BS;
+    l_key.m_N = (int)*l_pBW_BS->m_pport[PORT_N];
+    l_key.m_fn = l_frequency/l_pBW_BS->m_sample_rate;
+    l_key.m_Q = *l_pBW_BS->m_pport[PORT_Q];
+    if(!BW_Cache_key_equal(&l_key, &l_pBW_BS->m_key)){
+        if(l_key.m_type != l_pBW_BS->m_key.m_type){
+            // structure switched, start the incoming one from rest
+            if(l_parallel){
+                BW_Parallel_init(&l_pBW_BS->m_pf);
+            } else {
+                SP_Filter_init(&l_pBW_BS->m_sp);
+                for(int i=0;i<N_BQ;i++){
+                    BQ_Filter_init(&l_pBW_BS->m_bq[i]);
+                }
+            }
+        }
+        BW_BS_design(l_pBW_BS, &l_key, l_frequency, l_key.m_Q);
+        l_pBW_BS->m_key = l_key;
+    }
 
+    if(l_parallel){
+        BW_Parallel_run(&l_pBW_BS->m_pf, l_psrc, l_pdst, p_sample_count);
+        return;
+    }
     for(;l_psrc!=l_psrc_end;l_psrc++,l_pdst++){
         *l_pdst = BW_BS_eval(l_pBW_BS, *l_psrc);
     }
@@ -285,6 +456,8 @@ static void BW_BS_run(
 
 static void BW_BS_cleanup( LADSPA_Handle p_pInstance )
 {
+    BW_BS_Data *l_pBW_BS = (BW_BS_Data*)p_pInstance;
+    Linphase_free(l_pBW_BS->m_plinphase);
     free( p_pInstance );
 }
 
@@ -294,7 +467,10 @@ static LADSPA_PortDescriptor BW_BS_PortDescriptors[]=
     LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
     LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
-    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL
 };
 
 static const char *BW_BS_PortNames[]=
@@ -303,7 +479,10 @@ static const char *BW_BS_PortNames[]=
     "Output",
     "N(Filter order)",
     "Frequency(Hertz)",
-    "Q(wc/(w1-w0))"
+    "Q(wc/(w1-w0))",
+    "Parallel form",
+    "Linear phase",
+    "latency"
 };
 
 static LADSPA_PortRangeHint BW_BS_PortRangeHints[]=
@@ -318,7 +497,12 @@ static LADSPA_PortRangeHint BW_BS_PortRangeHints[]=
      10.0f,20.0e3f},
     {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
      LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
-     0.1f,10.0f}
+     0.1f,10.0f},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f,0.0f},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f,0.0f},
+    {0,0.0f,0.0f}
 };
 
 LADSPA_Descriptor BW_BS_Descriptor=
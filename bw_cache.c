@@ -0,0 +1,119 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "bw_cache.h"
+#include <stdatomic.h>
+#include <string.h>
+
+/*
+ * Open addressed hash table probed over BW_CACHE_PROBE slots. A slot's
+ * m_seq is odd while a writer fills it in. A reader copies the key and
+ * the coefficients and only accepts them when m_seq was even and did
+ * not change over the copy. Writers claim a slot with a compare and
+ * swap and simply give up if another thread got there first; the
+ * caller then keeps the design it computed itself.
+ */
+
+#define BW_CACHE_SIZE 64
+#define BW_CACHE_PROBE 4
+
+typedef struct {
+    atomic_uint  m_seq;
+    BW_Cache_Key m_key;
+    int          m_ncoeff;
+    double       m_coeff[BW_CACHE_NCOEFF];
+} BW_Cache_Entry;
+
+static BW_Cache_Entry g_bw_cache[BW_CACHE_SIZE];
+
+static unsigned int BW_Cache_hash( const BW_Cache_Key *p_pkey )
+{
+    unsigned int l_fn;
+    unsigned int l_Q;
+    memcpy( &l_fn, &p_pkey->m_fn, sizeof(l_fn) );
+    memcpy( &l_Q, &p_pkey->m_Q, sizeof(l_Q) );
+    unsigned int l_h = (unsigned int)p_pkey->m_type*0x9E3779B1u;
+    l_h ^= (unsigned int)p_pkey->m_N*0x85EBCA77u;
+    l_h ^= l_fn*0xC2B2AE3Du;
+    l_h ^= l_Q*0x27D4EB2Fu;
+    l_h ^= l_h >> 15;
+    return l_h;
+}
+
+int BW_Cache_key_equal( const BW_Cache_Key *p_pa, const BW_Cache_Key *p_pb )
+{
+    return p_pa->m_type == p_pb->m_type &&
+           p_pa->m_N == p_pb->m_N &&
+           p_pa->m_fn == p_pb->m_fn &&
+           p_pa->m_Q == p_pb->m_Q;
+}
+
+int BW_Cache_lookup( const BW_Cache_Key *p_pkey, double *p_pcoeff, int p_ncoeff )
+{
+    if( p_ncoeff > BW_CACHE_NCOEFF )
+        return 0;
+    unsigned int l_h = BW_Cache_hash( p_pkey );
+    for(int p=0;p<BW_CACHE_PROBE;p++){
+        BW_Cache_Entry *l_pe = &g_bw_cache[(l_h+p)&(BW_CACHE_SIZE-1)];
+        unsigned int l_seq = atomic_load_explicit( &l_pe->m_seq, memory_order_acquire );
+        if( l_seq & 1 )
+            continue;
+        if( !BW_Cache_key_equal( &l_pe->m_key, p_pkey ) ||
+            l_pe->m_ncoeff != p_ncoeff )
+            continue;
+        memcpy( p_pcoeff, l_pe->m_coeff, sizeof(double)*p_ncoeff );
+        atomic_thread_fence( memory_order_acquire );
+        if( atomic_load_explicit( &l_pe->m_seq, memory_order_relaxed ) == l_seq )
+            return 1;
+    }
+    return 0;
+}
+
+void BW_Cache_store( const BW_Cache_Key *p_pkey, const double *p_pcoeff, int p_ncoeff )
+{
+    if( p_ncoeff > BW_CACHE_NCOEFF )
+        return;
+    unsigned int l_h = BW_Cache_hash( p_pkey );
+    // prefer an empty slot, otherwise evict the last probed one
+    BW_Cache_Entry *l_pe = &g_bw_cache[(l_h+BW_CACHE_PROBE-1)&(BW_CACHE_SIZE-1)];
+    for(int p=0;p<BW_CACHE_PROBE;p++){
+        BW_Cache_Entry *l_pp = &g_bw_cache[(l_h+p)&(BW_CACHE_SIZE-1)];
+        if( atomic_load_explicit( &l_pp->m_seq, memory_order_relaxed ) == 0 ){
+            l_pe = l_pp;
+            break;
+        }
+    }
+    unsigned int l_seq = atomic_load_explicit( &l_pe->m_seq, memory_order_relaxed );
+    if( l_seq & 1 )
+        return;
+    if( !atomic_compare_exchange_strong_explicit( &l_pe->m_seq, &l_seq, l_seq+1,
+            memory_order_acquire, memory_order_relaxed ) )
+        return;
+    atomic_thread_fence( memory_order_release );
+    l_pe->m_key = *p_pkey;
+    l_pe->m_ncoeff = p_ncoeff;
+    memcpy( l_pe->m_coeff, p_pcoeff, sizeof(double)*p_ncoeff );
+    atomic_store_explicit( &l_pe->m_seq, l_seq+2, memory_order_release );
+}
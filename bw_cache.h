@@ -0,0 +1,58 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+
+/*
+ * Process wide cache of designed Butterworth coefficient sets.
+ *
+ * Instances running with the same filter type, order, normalized
+ * frequency and Q share one design. The table is a fixed size static
+ * array and every slot is guarded by a sequence counter, so lookups and
+ * stores never block or allocate and are safe to call from run().
+ */
+
+#define BW_CACHE_NCOEFF 50
+
+enum {
+    BW_CACHE_LP = 1,
+    BW_CACHE_HP,
+    BW_CACHE_BP,
+    BW_CACHE_BS,
+    BW_CACHE_BP_PARALLEL,
+    BW_CACHE_BS_PARALLEL,
+    BW_CACHE_ELLIP          // elliptic prototype, m_N stages,
+                            // m_fn ripple, m_Q attenuation
+};
+
+typedef struct {
+    int   m_type;
+    int   m_N;
+    float m_fn;     // frequency/sample rate
+    float m_Q;
+} BW_Cache_Key;
+
+int  BW_Cache_key_equal( const BW_Cache_Key *p_pa, const BW_Cache_Key *p_pb );
+int  BW_Cache_lookup( const BW_Cache_Key *p_pkey, double *p_pcoeff, int p_ncoeff );
+void BW_Cache_store( const BW_Cache_Key *p_pkey, const double *p_pcoeff, int p_ncoeff );
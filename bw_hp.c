@@ -27,6 +27,10 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include "bw_cache.h"
+#include "multirate.h"
+#include "linphase.h"
 
 /*
  *                    s^2
@@ -67,6 +71,8 @@ enum {
     PORT_OUT,
     PORT_N,
     PORT_FREQUENCY,
+    PORT_LINEAR,
+    PORT_LATENCY,
     PORT_NPORTS
 };
 
@@ -144,6 +150,10 @@ typedef struct {
     BQ_Filter    m_bq[N_BQ];
     int          m_N_bq;
     int          m_sp_on;
+    BW_Cache_Key m_key;
+    MR_Data      m_mr;
+    Linphase    *m_plinphase;
+    int          m_linear;
 } BW_HP_Data;
 
 void BW_HP_set(BW_HP_Data *p_pBW_HP, int p_N, LADSPA_Data p_K)
@@ -180,13 +190,98 @@ LADSPA_Data BW_HP_eval( BW_HP_Data *p_pBW_HP, LADSPA_Data x)
     return x;
 }
 
+static int BW_HP_ncoeff(int p_N)
+{
+    return 2 + 3*(p_N/2);
+}
+
+static void BW_HP_pack(BW_HP_Data *p_pBW_HP, double *p_pcoeff)
+{
+    p_pcoeff[0] = p_pBW_HP->m_sp.m_a1;
+    p_pcoeff[1] = p_pBW_HP->m_sp.m_g;
+    for(int i=0;i<p_pBW_HP->m_N_bq;i++){
+        double *l_pc = &p_pcoeff[2+3*i];
+        l_pc[0] = p_pBW_HP->m_bq[i].m_a1;
+        l_pc[1] = p_pBW_HP->m_bq[i].m_a2;
+        l_pc[2] = p_pBW_HP->m_bq[i].m_g;
+    }
+}
+
+static void BW_HP_unpack(BW_HP_Data *p_pBW_HP, int p_N, const double *p_pcoeff)
+{
+    p_pBW_HP->m_sp.m_a1 = p_pcoeff[0];
+    p_pBW_HP->m_sp.m_g = p_pcoeff[1];
+    p_pBW_HP->m_sp_on = p_N&1;
+    p_pBW_HP->m_N_bq = p_N/2;
+    for(int i=0;i<p_pBW_HP->m_N_bq;i++){
+        const double *l_pc = &p_pcoeff[2+3*i];
+        p_pBW_HP->m_bq[i].m_a1 = l_pc[0];
+        p_pBW_HP->m_bq[i].m_a2 = l_pc[1];
+        p_pBW_HP->m_bq[i].m_g = l_pc[2];
+    }
+}
+
+/*
+ * Load the coefficients for p_pkey from the shared design cache, or
+ * design them here and offer the result to the cache.
+ */
+static void BW_HP_design(BW_HP_Data *p_pBW_HP, const BW_Cache_Key *p_pkey,
+                         LADSPA_Data p_frequency)
+{
+    double l_coeff[BW_CACHE_NCOEFF];
+    int l_ncoeff = BW_HP_ncoeff(p_pkey->m_N);
+    if(BW_Cache_lookup(p_pkey, l_coeff, l_ncoeff)){
+        BW_HP_unpack(p_pBW_HP, p_pkey->m_N, l_coeff);
+        return;
+    }
+    LADSPA_Data l_omega = 2.0f*M_PIf*p_frequency;
+    l_omega /= p_pBW_HP->m_sample_rate;
+    LADSPA_Data l_K = 1.0f/tanf(l_omega/2.0f);
+    BW_HP_set(p_pBW_HP, p_pkey->m_N, l_K);
+    BW_HP_pack(p_pBW_HP, l_coeff);
+    BW_Cache_store(p_pkey, l_coeff, l_ncoeff);
+}
+
+/*
+ * Linear phase mode, magnitude of the Butterworth prototype
+ *
+ *   |H| = 1/sqrt(1 + W^(2*N))
+ *
+ * at the prototype frequency W of the digital frequency omega, with
+ * the same prewarping as the bilinear transform above.
+ */
+typedef struct {
+    int    m_N;
+    double m_K;
+} BW_HP_Linphase_Params;
+
+static double BW_HP_magnitude( const void *p_pparams, double p_omega )
+{
+    const BW_HP_Linphase_Params *l_pp = p_pparams;
+    double l_W = 1.0/(tan(p_omega/2.0)*l_pp->m_K);
+    return 1.0/sqrt(1.0 + pow(fabs(l_W), 2.0*l_pp->m_N));
+}
+
+static LADSPA_Data BW_HP_filter( void *p_pcontext, LADSPA_Data x )
+{
+    return BW_HP_eval((BW_HP_Data*)p_pcontext, x);
+}
+
 static LADSPA_Handle BW_HP_instantiate(
     const struct _LADSPA_Descriptor *p_pDescriptor,
     unsigned long p_sample_rate)
 {
     BW_HP_Data *l_pBW_HP = malloc( sizeof(BW_HP_Data) );
     if(l_pBW_HP){
+        l_pBW_HP->m_plinphase = Linphase_new(BW_HP_magnitude);
+        if(!l_pBW_HP->m_plinphase){
+            free(l_pBW_HP);
+            return NULL;
+        }
+        l_pBW_HP->m_linear = 0;
         l_pBW_HP->m_sample_rate = (float)p_sample_rate;
+        MR_init(&l_pBW_HP->m_mr, 0);
+        l_pBW_HP->m_key.m_type = 0;
         SP_Filter_init(&l_pBW_HP->m_sp);
         for(int i=0;i<N_BQ;i++){
             BQ_Filter_init(&l_pBW_HP->m_bq[i]);
@@ -213,12 +308,59 @@ static void BW_HP_run(
     LADSPA_Data *l_pdst = l_pBW_HP->m_pport[PORT_OUT];
     LADSPA_Data *l_psrc_end = l_psrc + p_sample_count;
 
-    int N = (int)*l_pBW_HP->m_pport[PORT_N];
-    LADSPA_Data l_omega = 2.0f*M_PIf* *l_pBW_HP->m_pport[PORT_FREQUENCY];
-    l_omega /= l_pBW_HP->m_sample_rate;
-    LADSPA_Data l_K = 1.0f/tanf(l_omega/2.0f);
-    BW_HP_set(l_pBW_HP, N, l_K);
+    if(*l_pBW_HP->m_pport[PORT_LINEAR] > 0.5f){
+        BW_HP_Linphase_Params l_params;
+        memset(&l_params, 0, sizeof(l_params));
+        l_params.m_N = (int)*l_pBW_HP->m_pport[PORT_N];
+        l_params.m_K = 1.0/tan(M_PI* *l_pBW_HP->m_pport[PORT_FREQUENCY]/
+                               l_pBW_HP->m_sample_rate);
+        if(!l_pBW_HP->m_linear){
+            Linphase_reset(l_pBW_HP->m_plinphase);
+            l_pBW_HP->m_linear = 1;
+        }
+        Linphase_request(l_pBW_HP->m_plinphase, &l_params, sizeof(l_params));
+        *l_pBW_HP->m_pport[PORT_LATENCY] = (LADSPA_Data)LINPHASE_LATENCY;
+        Linphase_run(l_pBW_HP->m_plinphase, l_psrc, l_pdst, p_sample_count);
+        return;
+    }
+    if(l_pBW_HP->m_linear){
+        // back from linear phase mode, restart the recursive filter
+        SP_Filter_init(&l_pBW_HP->m_sp);
+        for(int i=0;i<N_BQ;i++){
+            BQ_Filter_init(&l_pBW_HP->m_bq[i]);
+        }
+        MR_init(&l_pBW_HP->m_mr, l_pBW_HP->m_mr.m_D);
+        l_pBW_HP->m_linear = 0;
+    }
 
+    BW_Cache_Key l_key;
+    LADSPA_Data l_frequency = *l_pBW_HP->m_pport[PORT_FREQUENCY];
+    int l_D = MR_stages(l_frequency/l_pBW_HP->m_sample_rate,
+                        l_pBW_HP->m_mr.m_D);
+    if(l_D != l_pBW_HP->m_mr.m_D){
+        // the filter moves to another rate, restart it from rest
+        MR_init(&l_pBW_HP->m_mr, l_D);
+        SP_Filter_init(&l_pBW_HP->m_sp);
+        for(int i=0;i<N_BQ;i++){
+            BQ_Filter_init(&l_pBW_HP->m_bq[i]);
+        }
+    }
+    l_frequency *= (float)(1 << l_D);
+    *l_pBW_HP->m_pport[PORT_LATENCY] = (LADSPA_Data)l_pBW_HP->m_mr.m_latency;
+    l_key.m_type = BW_CACHE_HP;
+    l_key.m_N = (int)*l_pBW_HP->m_pport[PORT_N];
+    l_key.m_fn = l_frequency/l_pBW_HP->m_sample_rate;
+    l_key.m_Q = 0.0f;
+    if(!BW_Cache_key_equal(&l_key, &l_pBW_HP->m_key)){
+        BW_HP_design(l_pBW_HP, &l_key, l_frequency);
+        l_pBW_HP->m_key = l_key;
+    }
+
+    if(l_D){
+        MR_run(&l_pBW_HP->m_mr, l_psrc, l_pdst, p_sample_count,
+               BW_HP_filter, l_pBW_HP, 1);
+        return;
+    }
     for(;l_psrc!=l_psrc_end;l_psrc++,l_pdst++){
         *l_pdst = BW_HP_eval(l_pBW_HP, *l_psrc);
     }
@@ -226,6 +368,8 @@ static void BW_HP_run(
 
 static void BW_HP_cleanup( LADSPA_Handle p_pInstance )
 {
+    BW_HP_Data *l_pBW_HP = (BW_HP_Data*)p_pInstance;
+    Linphase_free(l_pBW_HP->m_plinphase);
     free( p_pInstance );
 }
 
@@ -234,7 +378,9 @@ static LADSPA_PortDescriptor BW_HP_PortDescriptors[]=
     LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
-    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL
 };
 
 static const char *BW_HP_PortNames[]=
@@ -242,7 +388,9 @@ static const char *BW_HP_PortNames[]=
     "Input",
     "Output",
     "N(Filter order)",
-    "Frequency(Hertz)"
+    "Frequency(Hertz)",
+    "Linear phase",
+    "latency"
 };
 
 static LADSPA_PortRangeHint BW_HP_PortRangeHints[]=
@@ -254,7 +402,10 @@ static LADSPA_PortRangeHint BW_HP_PortRangeHints[]=
      1.0f, 11.0f},
     {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
      LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
-     10.0f,20.0e3f}
+     10.0f,20.0e3f},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f,0.0f},
+    {0,0.0f,0.0f}
 };
 
 LADSPA_Descriptor BW_HP_Descriptor=
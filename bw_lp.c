@@ -27,6 +27,10 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include "bw_cache.h"
+#include "multirate.h"
+#include "linphase.h"
 
 /*
  *                    1
@@ -65,6 +69,8 @@ enum {
     PORT_OUT,
     PORT_N,
     PORT_FREQUENCY,
+    PORT_LINEAR,
+    PORT_LATENCY,
     PORT_NPORTS
 };
 
@@ -142,6 +148,10 @@ typedef struct {
     BQ_Filter    m_bq[N_BQ];
     int          m_N_bq;
     int          m_sp_on;
+    BW_Cache_Key m_key;
+    MR_Data      m_mr;
+    Linphase    *m_plinphase;
+    int          m_linear;
 } BW_LP_Data;
 
 void BW_LP_set(BW_LP_Data *p_pBW_LP, int p_N, LADSPA_Data p_K)
@@ -178,13 +188,98 @@ LADSPA_Data BW_LP_eval( BW_LP_Data *p_pBW_LP, LADSPA_Data x)
     return x;
 }
 
+static int BW_LP_ncoeff(int p_N)
+{
+    return 2 + 3*(p_N/2);
+}
+
+static void BW_LP_pack(BW_LP_Data *p_pBW_LP, double *p_pcoeff)
+{
+    p_pcoeff[0] = p_pBW_LP->m_sp.m_a1;
+    p_pcoeff[1] = p_pBW_LP->m_sp.m_g;
+    for(int i=0;i<p_pBW_LP->m_N_bq;i++){
+        double *l_pc = &p_pcoeff[2+3*i];
+        l_pc[0] = p_pBW_LP->m_bq[i].m_a1;
+        l_pc[1] = p_pBW_LP->m_bq[i].m_a2;
+        l_pc[2] = p_pBW_LP->m_bq[i].m_g;
+    }
+}
+
+static void BW_LP_unpack(BW_LP_Data *p_pBW_LP, int p_N, const double *p_pcoeff)
+{
+    p_pBW_LP->m_sp.m_a1 = p_pcoeff[0];
+    p_pBW_LP->m_sp.m_g = p_pcoeff[1];
+    p_pBW_LP->m_sp_on = p_N&1;
+    p_pBW_LP->m_N_bq = p_N/2;
+    for(int i=0;i<p_pBW_LP->m_N_bq;i++){
+        const double *l_pc = &p_pcoeff[2+3*i];
+        p_pBW_LP->m_bq[i].m_a1 = l_pc[0];
+        p_pBW_LP->m_bq[i].m_a2 = l_pc[1];
+        p_pBW_LP->m_bq[i].m_g = l_pc[2];
+    }
+}
+
+/*
+ * Load the coefficients for p_pkey from the shared design cache, or
+ * design them here and offer the result to the cache.
+ */
+static void BW_LP_design(BW_LP_Data *p_pBW_LP, const BW_Cache_Key *p_pkey,
+                         LADSPA_Data p_frequency)
+{
+    double l_coeff[BW_CACHE_NCOEFF];
+    int l_ncoeff = BW_LP_ncoeff(p_pkey->m_N);
+    if(BW_Cache_lookup(p_pkey, l_coeff, l_ncoeff)){
+        BW_LP_unpack(p_pBW_LP, p_pkey->m_N, l_coeff);
+        return;
+    }
+    LADSPA_Data l_omega = 2.0f*M_PIf*p_frequency;
+    l_omega /= p_pBW_LP->m_sample_rate;
+    LADSPA_Data l_K = 1.0f/tanf(l_omega/2.0f);
+    BW_LP_set(p_pBW_LP, p_pkey->m_N, l_K);
+    BW_LP_pack(p_pBW_LP, l_coeff);
+    BW_Cache_store(p_pkey, l_coeff, l_ncoeff);
+}
+
+/*
+ * Linear phase mode, magnitude of the Butterworth prototype
+ *
+ *   |H| = 1/sqrt(1 + W^(2*N))
+ *
+ * at the prototype frequency W of the digital frequency omega, with
+ * the same prewarping as the bilinear transform above.
+ */
+typedef struct {
+    int    m_N;
+    double m_K;
+} BW_LP_Linphase_Params;
+
+static double BW_LP_magnitude( const void *p_pparams, double p_omega )
+{
+    const BW_LP_Linphase_Params *l_pp = p_pparams;
+    double l_W = tan(p_omega/2.0)*l_pp->m_K;
+    return 1.0/sqrt(1.0 + pow(fabs(l_W), 2.0*l_pp->m_N));
+}
+
+static LADSPA_Data BW_LP_filter( void *p_pcontext, LADSPA_Data x )
+{
+    return BW_LP_eval((BW_LP_Data*)p_pcontext, x);
+}
+
 static LADSPA_Handle BW_LP_instantiate(
     const struct _LADSPA_Descriptor *p_pDescriptor,
     unsigned long p_sample_rate)
 {
     BW_LP_Data *l_pBW_LP = malloc( sizeof(BW_LP_Data) );
     if(l_pBW_LP){
+        l_pBW_LP->m_plinphase = Linphase_new(BW_LP_magnitude);
+        if(!l_pBW_LP->m_plinphase){
+            free(l_pBW_LP);
+            return NULL;
+        }
+        l_pBW_LP->m_linear = 0;
         l_pBW_LP->m_sample_rate = (float)p_sample_rate;
+        MR_init(&l_pBW_LP->m_mr, 0);
+        l_pBW_LP->m_key.m_type = 0;
         SP_Filter_init(&l_pBW_LP->m_sp);
         for(int i=0;i<N_BQ;i++){
             BQ_Filter_init(&l_pBW_LP->m_bq[i]);
@@ -211,12 +306,59 @@ static void BW_LP_run(
     LADSPA_Data *l_pdst = l_pBW_LP->m_pport[PORT_OUT];
     LADSPA_Data *l_psrc_end = l_psrc + p_sample_count;
 
-    int N = (int)*l_pBW_LP->m_pport[PORT_N];
-    LADSPA_Data l_omega = 2.0f*M_PIf* *l_pBW_LP->m_pport[PORT_FREQUENCY];
-    l_omega /= l_pBW_LP->m_sample_rate;
-    LADSPA_Data l_K = 1.0f/tanf(l_omega/2.0f);
-    BW_LP_set(l_pBW_LP, N, l_K);
+    if(*l_pBW_LP->m_pport[PORT_LINEAR] > 0.5f){
+        BW_LP_Linphase_Params l_params;
+        memset(&l_params, 0, sizeof(l_params));
+        l_params.m_N = (int)*l_pBW_LP->m_pport[PORT_N];
+        l_params.m_K = 1.0/tan(M_PI* *l_pBW_LP->m_pport[PORT_FREQUENCY]/
+                               l_pBW_LP->m_sample_rate);
+        if(!l_pBW_LP->m_linear){
+            Linphase_reset(l_pBW_LP->m_plinphase);
+            l_pBW_LP->m_linear = 1;
+        }
+        Linphase_request(l_pBW_LP->m_plinphase, &l_params, sizeof(l_params));
+        *l_pBW_LP->m_pport[PORT_LATENCY] = (LADSPA_Data)LINPHASE_LATENCY;
+        Linphase_run(l_pBW_LP->m_plinphase, l_psrc, l_pdst, p_sample_count);
+        return;
+    }
+    if(l_pBW_LP->m_linear){
+        // back from linear phase mode, restart the recursive filter
+        SP_Filter_init(&l_pBW_LP->m_sp);
+        for(int i=0;i<N_BQ;i++){
+            BQ_Filter_init(&l_pBW_LP->m_bq[i]);
+        }
+        MR_init(&l_pBW_LP->m_mr, l_pBW_LP->m_mr.m_D);
+        l_pBW_LP->m_linear = 0;
+    }
 
+    BW_Cache_Key l_key;
+    LADSPA_Data l_frequency = *l_pBW_LP->m_pport[PORT_FREQUENCY];
+    int l_D = MR_stages(l_frequency/l_pBW_LP->m_sample_rate,
+                        l_pBW_LP->m_mr.m_D);
+    if(l_D != l_pBW_LP->m_mr.m_D){
+        // the filter moves to another rate, restart it from rest
+        MR_init(&l_pBW_LP->m_mr, l_D);
+        SP_Filter_init(&l_pBW_LP->m_sp);
+        for(int i=0;i<N_BQ;i++){
+            BQ_Filter_init(&l_pBW_LP->m_bq[i]);
+        }
+    }
+    l_frequency *= (float)(1 << l_D);
+    *l_pBW_LP->m_pport[PORT_LATENCY] = (LADSPA_Data)l_pBW_LP->m_mr.m_latency;
+    l_key.m_type = BW_CACHE_LP;
+    l_key.m_N = (int)*l_pBW_LP->m_pport[PORT_N];
+    l_key.m_fn = l_frequency/l_pBW_LP->m_sample_rate;
+    l_key.m_Q = 0.0f;
+    if(!BW_Cache_key_equal(&l_key, &l_pBW_LP->m_key)){
+        BW_LP_design(l_pBW_LP, &l_key, l_frequency);
+        l_pBW_LP->m_key = l_key;
+    }
+
+    if(l_D){
+        MR_run(&l_pBW_LP->m_mr, l_psrc, l_pdst, p_sample_count,
+               BW_LP_filter, l_pBW_LP, 0);
+        return;
+    }
     for(;l_psrc!=l_psrc_end;l_psrc++,l_pdst++){
         *l_pdst = BW_LP_eval(l_pBW_LP, *l_psrc);
     }
@@ -224,6 +366,8 @@ static void BW_LP_run(
 
 static void BW_LP_cleanup( LADSPA_Handle p_pInstance )
 {
+    BW_LP_Data *l_pBW_LP = (BW_LP_Data*)p_pInstance;
+    Linphase_free(l_pBW_LP->m_plinphase);
     free( p_pInstance );
 }
 
@@ -232,7 +376,9 @@ static LADSPA_PortDescriptor BW_LP_PortDescriptors[]=
     LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
-    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL
 };
 
 static const char *BW_LP_PortNames[]=
@@ -240,7 +386,9 @@ static const char *BW_LP_PortNames[]=
     "Input",
     "Output",
     "N(Filter order)",
-    "Frequency(Hertz)"
+    "Frequency(Hertz)",
+    "Linear phase",
+    "latency"
 };
 
 static LADSPA_PortRangeHint BW_LP_PortRangeHints[]=
@@ -252,7 +400,10 @@ static LADSPA_PortRangeHint BW_LP_PortRangeHints[]=
      1.0f, 11.0f},
     {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
      LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
-     10.0f,20.0e3f}
+     10.0f,20.0e3f},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f,0.0f},
+    {0,0.0f,0.0f}
 };
 
 LADSPA_Descriptor BW_LP_Descriptor=
@@ -0,0 +1,226 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "bw_parallel.h"
+#define _GNU_SOURCE
+#include <math.h>
+#include <complex.h>
+
+/*
+ * Poles
+ *
+ * Butterworth low pass prototype poles P, one per conjugate pair
+ *   N even: P = -cos(m*pi/2/N) + j*sin(m*pi/2/N), m = 1,3,...,N-1
+ *   N odd:  P = -1 and P = -cos(k*pi/N) + j*sin(k*pi/N), k = 1..(N-1)/2
+ *
+ * Band pass and band stop transformations (S = Q*(s+1/s) and its
+ * inverse) give the same s plane poles
+ *   s = (P/Q +/- sqrt(P^2/Q^2 - 4))/2
+ *
+ * and the bilinear transform with K = 1/tan(omega/2)
+ *   z = (K + s)/(K - s)
+ *
+ * Zeros
+ *   band pass: (1 - z^-2)^N
+ *   band stop: (1 - 2*cos(omega)*z^-1 + z^-2)^N
+ *
+ * The gain g normalizes the band pass to 1 at the center frequency and
+ * the band stop to 1 at DC. With w = z^-1, A(w) = prod(1 - p[i]*w) and
+ * B(w) the zero polynomial the residues are
+ *
+ *   r[i] = g*B(1/p[i]) / prod(1 - p[j]/p[i]), j != i
+ *   k0 = g - sum(r[i])
+ *
+ * and two poles p1, p2 with residues r1, r2 combine into
+ *   b0 = r1 + r2, b1 = -(r1*p2 + r2*p1), a1 = -(p1 + p2), a2 = p1*p2
+ *
+ * Closely spaced poles (high order with high Q) give large residues
+ * that cancel in the sum, so the cascade remains the more accurate
+ * structure there.
+ */
+
+#define N_POLES_MAX (2*BW_PARALLEL_N_MAX)
+
+static double complex zero_poly( double complex w, int N, double c, int bandstop )
+{
+    double complex l_f;
+    if( bandstop )
+        l_f = 1.0 - 2.0*c*w + w*w;
+    else
+        l_f = 1.0 - w*w;
+    return cpow( l_f, N );
+}
+
+static double complex pole_poly( double complex w, double complex *p, int n )
+{
+    double complex l_a = 1.0;
+    for(int i=0;i<n;i++){
+        l_a *= 1.0 - p[i]*w;
+    }
+    return l_a;
+}
+
+void BW_Parallel_init( BW_Parallel *p_pf )
+{
+    for(int k=0;k<BW_PARALLEL_N_MAX;k++){
+        p_pf->m_s1[k] = 0.0;
+        p_pf->m_s2[k] = 0.0;
+    }
+}
+
+static void BW_Parallel_pad( BW_Parallel *p_pf, int p_N )
+{
+    p_pf->m_N = p_N;
+    p_pf->m_Npad = (p_N + BW_PARALLEL_NPAD - 1) & ~(BW_PARALLEL_NPAD - 1);
+    for(int k=p_N;k<p_pf->m_Npad;k++){
+        p_pf->m_b0[k] = 0.0;
+        p_pf->m_b1[k] = 0.0;
+        p_pf->m_a1[k] = 0.0;
+        p_pf->m_a2[k] = 0.0;
+        p_pf->m_s1[k] = 0.0;
+        p_pf->m_s2[k] = 0.0;
+    }
+}
+
+void BW_Parallel_design( BW_Parallel *p_pf, int p_N, double p_K, double p_Q,
+                         int p_bandstop )
+{
+    double complex l_p[N_POLES_MAX];
+    int l_np = 0;
+
+    if( p_N < 1 ) p_N = 1;
+    if( p_N > BW_PARALLEL_N_MAX ) p_N = BW_PARALLEL_N_MAX;
+
+    for(int k=0;k<(p_N+1)/2;k++){
+        double complex l_P;
+        double complex l_s1, l_s2, l_d;
+        if( p_N&1 ){
+            l_P = k==0 ? -1.0 : -cos(k*M_PI/p_N) + I*sin(k*M_PI/p_N);
+        }else{
+            double l_phi = (2*k+1)*M_PI/2.0/p_N;
+            l_P = -cos(l_phi) + I*sin(l_phi);
+        }
+        l_d = csqrt( l_P*l_P/(p_Q*p_Q) - 4.0 );
+        l_s1 = (l_P/p_Q + l_d)/2.0;
+        l_s2 = (l_P/p_Q - l_d)/2.0;
+        double complex l_z1 = (p_K + l_s1)/(p_K - l_s1);
+        double complex l_z2 = (p_K + l_s2)/(p_K - l_s2);
+        if( cimag(l_P) == 0.0 ){
+            // real prototype pole: one section from both roots
+            l_p[l_np++] = l_z1;
+            l_p[l_np++] = l_z2;
+        }else{
+            l_p[l_np++] = l_z1;
+            l_p[l_np++] = conj(l_z1);
+            l_p[l_np++] = l_z2;
+            l_p[l_np++] = conj(l_z2);
+        }
+    }
+
+    double l_c = (p_K*p_K - 1.0)/(p_K*p_K + 1.0);  // cos(omega)
+    double complex l_wn;
+    if( p_bandstop )
+        l_wn = 1.0;
+    else
+        l_wn = (p_K - I)/(p_K + I);                 // 1/z at the center
+    double l_g = creal( pole_poly( l_wn, l_p, l_np ) /
+                        zero_poly( l_wn, p_N, l_c, p_bandstop ) );
+
+    double complex l_r[N_POLES_MAX];
+    double l_rsum = 0.0;
+    for(int i=0;i<l_np;i++){
+        double complex l_den = 1.0;
+        for(int j=0;j<l_np;j++){
+            if( j != i )
+                l_den *= 1.0 - l_p[j]/l_p[i];
+        }
+        l_r[i] = l_g*zero_poly( 1.0/l_p[i], p_N, l_c, p_bandstop )/l_den;
+        l_rsum += creal( l_r[i] );
+    }
+    p_pf->m_k0 = l_g - l_rsum;
+
+    for(int k=0;k<p_N;k++){
+        double complex l_p1 = l_p[2*k];
+        double complex l_p2 = l_p[2*k+1];
+        double complex l_r1 = l_r[2*k];
+        double complex l_r2 = l_r[2*k+1];
+        p_pf->m_b0[k] = creal( l_r1 + l_r2 );
+        p_pf->m_b1[k] = -creal( l_r1*l_p2 + l_r2*l_p1 );
+        p_pf->m_a1[k] = -creal( l_p1 + l_p2 );
+        p_pf->m_a2[k] = creal( l_p1*l_p2 );
+    }
+    BW_Parallel_pad( p_pf, p_N );
+}
+
+void BW_Parallel_pack( const BW_Parallel *p_pf, double *p_pcoeff )
+{
+    *p_pcoeff++ = p_pf->m_k0;
+    for(int k=0;k<p_pf->m_N;k++){
+        *p_pcoeff++ = p_pf->m_b0[k];
+        *p_pcoeff++ = p_pf->m_b1[k];
+        *p_pcoeff++ = p_pf->m_a1[k];
+        *p_pcoeff++ = p_pf->m_a2[k];
+    }
+}
+
+void BW_Parallel_unpack( BW_Parallel *p_pf, int p_N, const double *p_pcoeff )
+{
+    if( p_N < 1 ) p_N = 1;
+    if( p_N > BW_PARALLEL_N_MAX ) p_N = BW_PARALLEL_N_MAX;
+    p_pf->m_k0 = *p_pcoeff++;
+    for(int k=0;k<p_N;k++){
+        p_pf->m_b0[k] = *p_pcoeff++;
+        p_pf->m_b1[k] = *p_pcoeff++;
+        p_pf->m_a1[k] = *p_pcoeff++;
+        p_pf->m_a2[k] = *p_pcoeff++;
+    }
+    BW_Parallel_pad( p_pf, p_N );
+}
+
+void BW_Parallel_run( BW_Parallel *p_pf, LADSPA_Data *p_psrc,
+                      LADSPA_Data *p_pdst, unsigned long p_nsamples )
+{
+    double * restrict l_b0 = p_pf->m_b0;
+    double * restrict l_b1 = p_pf->m_b1;
+    double * restrict l_a1 = p_pf->m_a1;
+    double * restrict l_a2 = p_pf->m_a2;
+    double * restrict l_s1 = p_pf->m_s1;
+    double * restrict l_s2 = p_pf->m_s2;
+    int l_Npad = p_pf->m_Npad;
+    double l_k0 = p_pf->m_k0;
+    LADSPA_Data *l_psrc_end = p_psrc + p_nsamples;
+    for(;p_psrc!=l_psrc_end;p_psrc++,p_pdst++){
+        double l_x = *p_psrc;
+        double l_y = l_k0*l_x;
+        // transposed direct form II, all sections in parallel
+        for(int k=0;k<l_Npad;k++){
+            double l_yk = l_b0[k]*l_x + l_s1[k];
+            l_s1[k] = l_b1[k]*l_x - l_a1[k]*l_yk + l_s2[k];
+            l_s2[k] = -l_a2[k]*l_yk;
+            l_y += l_yk;
+        }
+        *p_pdst = (LADSPA_Data)l_y;
+    }
+}
@@ -0,0 +1,65 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+
+/*
+ * Parallel form of the Butterworth band pass and band stop filters.
+ *
+ * The cascade of 4th order sections used by BW_BP and BW_BS is
+ * expanded into partial fractions
+ *
+ *                      b0[k] + b1[k]*z^-1
+ *   H(z) = k0 + sum -----------------------------
+ *                k   1 + a1[k]*z^-1 + a2[k]*z^-2
+ *
+ * with one second order section per pole pair. The sections are
+ * independent of each other so a sample is evaluated for all of them
+ * at once, BW_PARALLEL_NPAD sections at a time.
+ */
+
+#define BW_PARALLEL_N_MAX 12
+#define BW_PARALLEL_NPAD 4
+#define BW_PARALLEL_NCOEFF(N) (1 + 4*(N))
+
+typedef struct {
+    int    m_N;
+    int    m_Npad;
+    double m_k0;
+    double m_b0[BW_PARALLEL_N_MAX];
+    double m_b1[BW_PARALLEL_N_MAX];
+    double m_a1[BW_PARALLEL_N_MAX];
+    double m_a2[BW_PARALLEL_N_MAX];
+    double m_s1[BW_PARALLEL_N_MAX];
+    double m_s2[BW_PARALLEL_N_MAX];
+} BW_Parallel;
+
+void BW_Parallel_init( BW_Parallel *p_pf );
+void BW_Parallel_design( BW_Parallel *p_pf, int p_N, double p_K, double p_Q,
+                         int p_bandstop );
+void BW_Parallel_pack( const BW_Parallel *p_pf, double *p_pcoeff );
+void BW_Parallel_unpack( BW_Parallel *p_pf, int p_N, const double *p_pcoeff );
+void BW_Parallel_run( BW_Parallel *p_pf, LADSPA_Data *p_psrc,
+                      LADSPA_Data *p_pdst, unsigned long p_nsamples );
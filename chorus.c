@@ -0,0 +1,319 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <fad.h>
+#include <ladspa.h>
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include "delay_ring.h"
+#include "lfo.h"
+
+/*
+ * Chorus and flanger, up to CHORUS_VOICES_MAX voices reading one ring.
+ *
+ * The inputs are summed into one mono ring and every voice reads it at
+ * Delay(ms) moved by Depth(ms) times the shared LFO, the voices spread
+ * evenly over its cycle with LFO_generate's phase offset. Spread pans
+ * the voices across the outputs, the first to the left and the last
+ * to the right at 1. The wet mix is scaled by 1/sqrt(voices), about
+ * the level of one voice, and the feedback by 1/voices so the loop gain
+ * stays below Feedback. One voice with a short delay and feedback is a
+ * flanger.
+ *
+ * The reads of all the voices for a sample are one FadSamples call, so
+ * a voice costs a vector dot product rather than a separate delay with
+ * its own buffer, write pass and LFO. The reads stop short of the
+ * sample being written, which is the input plus the feedback, and the
+ * shortest delay is the FadNwindow()/2 + 1 samples they reach back to
+ * at least. The dry signal is not delayed.
+ */
+
+#define CHORUS_VOICES_MAX 8
+#define CHORUS_DELAY_MAX_MS 50.0f
+#define CHORUS_DEPTH_MAX_MS 10.0f
+
+enum {
+    PORT_IN_L,
+    PORT_IN_R,
+    PORT_OUT_L,
+    PORT_OUT_R,
+    PORT_VOICES,
+    PORT_DELAY,
+    PORT_DEPTH,
+    PORT_LFO_FREQUENCY,
+    PORT_LFO_SHAPE,
+    PORT_SPREAD,
+    PORT_FEEDBACK,
+    PORT_WET,
+    PORT_DRY,
+    PORT_NPORTS
+};
+
+typedef struct {
+    LADSPA_Data  m_sample_rate;
+    LADSPA_Data *m_pport[PORT_NPORTS];
+    Delay_Ring   m_ring;
+    long         m_write_index;
+    LFO          m_lfo;
+} Chorus_Data;
+
+static LADSPA_Handle Chorus_instantiate(
+    const struct _LADSPA_Descriptor *p_pDescriptor,
+    unsigned long p_sample_rate)
+{
+    Chorus_Data *l_pData = malloc( sizeof(Chorus_Data) );
+    if(!l_pData)
+        return NULL;
+    l_pData->m_sample_rate = (LADSPA_Data)p_sample_rate;
+    for(int i=0;i<PORT_NPORTS;i++)
+        l_pData->m_pport[i] = NULL;
+    // the ring is small, allocated for the longest delay at once
+    long l_N = (long)ceilf( (CHORUS_DELAY_MAX_MS + CHORUS_DEPTH_MAX_MS)/1000.0f*p_sample_rate )
+               + FadNwindow() + 2;
+    if( !Delay_Ring_init( &l_pData->m_ring, l_N, l_N ) ){
+        free( l_pData );
+        return NULL;
+    }
+    return (LADSPA_Handle)l_pData;
+}
+
+static void Chorus_connect_port(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_port,
+    LADSPA_Data *p_pdata)
+{
+    Chorus_Data *l_pData = (Chorus_Data*)p_pInstance;
+    l_pData->m_pport[p_port] = p_pdata;
+}
+
+static void Chorus_activate( LADSPA_Handle p_pInstance )
+{
+    Chorus_Data *l_pData = (Chorus_Data*)p_pInstance;
+    l_pData->m_write_index = 0;
+    LFO_reset( &l_pData->m_lfo );
+    Delay_Ring_reset( &l_pData->m_ring, 0, 0 );
+}
+
+static void Chorus_run(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_sample_count)
+{
+    Chorus_Data *l_pData = (Chorus_Data*)p_pInstance;
+    LADSPA_Data **l_pport = l_pData->m_pport;
+    Delay_Ring *l_pring = &l_pData->m_ring;
+    LADSPA_Data l_fs = l_pData->m_sample_rate;
+
+    int l_nvoices = (int)(*l_pport[PORT_VOICES] + 0.5f);
+    if( l_nvoices < 1 ) l_nvoices = 1;
+    if( l_nvoices > CHORUS_VOICES_MAX ) l_nvoices = CHORUS_VOICES_MAX;
+    // in samples past the FadNwindow()/2 + 1 every read has
+    float l_delay = *l_pport[PORT_DELAY]/1000.0f*l_fs - (FadNwindow()/2 + 1);
+    float l_depth = *l_pport[PORT_DEPTH]/1000.0f*l_fs;
+    float l_delay_max = (float)(l_pring->m_Nbuf - FadNwindow() - 2);
+    float l_dphase = *l_pport[PORT_LFO_FREQUENCY]/l_fs;
+    int l_shape = LFO_shape( *l_pport[PORT_LFO_SHAPE] );
+    LADSPA_Data l_spread = *l_pport[PORT_SPREAD];
+    LADSPA_Data l_feedback = *l_pport[PORT_FEEDBACK]/l_nvoices;
+    LADSPA_Data l_wet = *l_pport[PORT_WET]/sqrtf( (float)l_nvoices );
+    LADSPA_Data l_dry = *l_pport[PORT_DRY];
+
+    // output gains of the voices, balance panned
+    LADSPA_Data l_gain_l[CHORUS_VOICES_MAX];
+    LADSPA_Data l_gain_r[CHORUS_VOICES_MAX];
+    for(int v=0;v<l_nvoices;v++){
+        LADSPA_Data l_pan = l_nvoices > 1 ? l_spread*(2.0f*v/(l_nvoices - 1) - 1.0f) : 0.0f;
+        l_gain_l[v] = l_wet*(l_pan > 0.0f ? 1.0f - l_pan : 1.0f);
+        l_gain_r[v] = l_wet*(l_pan < 0.0f ? 1.0f + l_pan : 1.0f);
+    }
+
+    const LADSPA_Data *l_pin_l = l_pport[PORT_IN_L];
+    const LADSPA_Data *l_pin_r = l_pport[PORT_IN_R];
+    LADSPA_Data *l_pout_l = l_pport[PORT_OUT_L];
+    LADSPA_Data *l_pout_r = l_pport[PORT_OUT_R];
+    LADSPA_Data l_alpha_v[CHORUS_VOICES_MAX][LFO_BLOCK];
+    int l_offset_v[CHORUS_VOICES_MAX][LFO_BLOCK];
+    while( p_sample_count ){
+        unsigned long l_n = p_sample_count < LFO_BLOCK ? p_sample_count : LFO_BLOCK;
+        // the read offsets and fractions of the block, a voice at a time
+        for(int v=0;v<l_nvoices;v++){
+            LADSPA_Data *l_palpha = l_alpha_v[v];
+            int *l_poffset = l_offset_v[v];
+            LFO_generate( &l_pData->m_lfo, l_shape, l_dphase, (float)v/l_nvoices, l_palpha, l_n );
+            for(int i=0;i<(int)l_n;i++){
+                float l_d = l_delay + l_depth*l_palpha[i];
+                l_d = l_d < 0.0f ? 0.0f : l_d;
+                l_d = l_d > l_delay_max ? l_delay_max : l_d;
+                // floorf(-l_d) from the truncation, l_d >= 0
+                int l_d_int = -(int)l_d;
+                float l_a = -l_d - (float)l_d_int;
+                l_poffset[i] = i - (int)FadNwindow() + l_d_int - (l_a < 0.0f);
+                l_palpha[i] = l_a < 0.0f ? l_a + 1.0f : l_a;
+            }
+        }
+        LFO_advance( &l_pData->m_lfo, l_dphase, l_n );
+
+        long l_index0 = l_pData->m_write_index;
+        for(unsigned long i=0;i<l_n;i++){
+            long l_start[CHORUS_VOICES_MAX];
+            float l_alpha[CHORUS_VOICES_MAX];
+            LADSPA_Data l_tap[CHORUS_VOICES_MAX];
+            for(int v=0;v<l_nvoices;v++){
+                l_alpha[v] = l_alpha_v[v][i];
+                l_start[v] = l_index0 + l_offset_v[v][i];
+                if( l_start[v] >= l_pring->m_Nbuf )
+                    l_start[v] -= l_pring->m_Nbuf;
+                if( l_start[v] < 0 ){
+                    l_start[v] += l_pring->m_Nbuf;
+                    Delay_Ring_clear( l_pring, l_start[v] );
+                }
+            }
+            FadSamples( l_pring->m_pdata, l_pring->m_Nbuf, l_start, l_alpha, l_tap, l_nvoices );
+
+            LADSPA_Data l_out_l = l_pin_l[i]*l_dry;
+            LADSPA_Data l_out_r = l_pin_r[i]*l_dry;
+            LADSPA_Data l_sum = 0.0f;
+            for(int v=0;v<l_nvoices;v++){
+                l_out_l += l_gain_l[v]*l_tap[v];
+                l_out_r += l_gain_r[v]*l_tap[v];
+                l_sum += l_tap[v];
+            }
+            LADSPA_Data l_x = 0.5f*(l_pin_l[i] + l_pin_r[i]) + l_sum*l_feedback;
+            if( l_x > 1.0f ) l_x = 1.0f;
+            if( l_x <-1.0f ) l_x =-1.0f;
+            l_pout_l[i] = l_out_l;
+            l_pout_r[i] = l_out_r;
+
+            l_pring->m_pdata[l_pData->m_write_index] = l_x;
+            Delay_Ring_wrote( l_pring, 1 );
+            if( ++l_pData->m_write_index == l_pring->m_Nbuf )
+                l_pData->m_write_index = 0;
+        }
+        l_pin_l += l_n;
+        l_pin_r += l_n;
+        l_pout_l += l_n;
+        l_pout_r += l_n;
+        p_sample_count -= l_n;
+    }
+}
+
+static void Chorus_cleanup( LADSPA_Handle p_pInstance )
+{
+    Chorus_Data *l_pData = (Chorus_Data*)p_pInstance;
+    Delay_Ring_free( &l_pData->m_ring );
+    free( l_pData );
+}
+
+static LADSPA_PortDescriptor Chorus_PortDescriptors[]=
+{
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+};
+
+static const char *Chorus_PortNames[]=
+{
+    "InputL",
+    "InputR",
+    "OutputL",
+    "OutputR",
+    "Voices",
+    "Delay(ms)",
+    "Depth(ms)",
+    "LFO Frequency(Hz)",
+    "LFO Shape",
+    "Spread",
+    "Feedback",
+    "Wet",
+    "Dry"
+};
+
+static LADSPA_PortRangeHint Chorus_PortRangeHints[]=
+{
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_INTEGER | LADSPA_HINT_DEFAULT_MIDDLE,
+     1.0f, CHORUS_VOICES_MAX},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_LOW,
+     1.0f, CHORUS_DELAY_MAX_MS},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_LOW,
+     0.0f, CHORUS_DEPTH_MAX_MS},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE,
+     0.01f, 10.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_INTEGER | LADSPA_HINT_DEFAULT_MINIMUM,
+     0.0f, LFO_NSHAPES - 1},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_1,
+     0.0f, 1.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_0,
+     -0.95f, 0.95f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MIDDLE,
+     0.0f, 1.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_1,
+     0.0f, 1.0f}
+};
+
+LADSPA_Descriptor Chorus_Descriptor=
+{
+    5840,
+    "chorus",
+    LADSPA_PROPERTY_HARD_RT_CAPABLE,
+    "Chorus/flanger with up to 8 voices and stereo spread",
+    "Timothy William Krause",
+    "None",
+    PORT_NPORTS,
+    Chorus_PortDescriptors,
+    Chorus_PortNames,
+    Chorus_PortRangeHints,
+    NULL,
+    Chorus_instantiate,
+    Chorus_connect_port,
+    Chorus_activate,
+    Chorus_run,
+    NULL,
+    NULL,
+    NULL,
+    Chorus_cleanup
+};
@@ -27,6 +27,7 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "dynamics.h"
 
 enum {
 	PORT_RX1,
@@ -38,35 +39,17 @@ enum {
 	PORT_RATIO_LO,
 	PORT_THRESHOLD,
 	PORT_DECAY,
+	PORT_ATTACK,
 	PORT_NPORTS
 };
 
-#define N_WINDOW 2
-#define ABS_MIN 1.19209290e-7
-#define PEEK2_K 0.5f
-
-typedef struct
-{
-    LADSPA_Data m_env;
-    LADSPA_Data m_window[N_WINDOW];
-    int         m_i_window;
-} Compressor_State;
-
 typedef struct
 {
-    LADSPA_Data      m_sample_rate;
-    LADSPA_Data*     m_pdata[PORT_NPORTS];
-    Compressor_State m_cs[2];
+    LADSPA_Data  m_sample_rate;
+    LADSPA_Data* m_pdata[PORT_NPORTS];
+    Dyn_State    m_ds[2];
 } Compressor_Data;
 
-void Compressor_State_Init( Compressor_State *cs ){
-    cs->m_env = 0.0f;
-    cs->m_i_window = 0;
-    for(int s=0;s<N_WINDOW;s++){
-        cs->m_window[s] = 0.0f;
-    }
-}
-
 static LADSPA_Handle Compressor_instantiate(
 	const struct _LADSPA_Descriptor* p_pDescriptor,
 	unsigned long SampleRate)
@@ -75,7 +58,7 @@ static LADSPA_Handle Compressor_instantiate(
 	if(l_pData){
         l_pData->m_sample_rate = SampleRate;
         for(int i=0;i<2;i++){
-            Compressor_State_Init( &l_pData->m_cs[i] );
+            Dyn_State_init( &l_pData->m_ds[i] );
         }
 	}
 	return (LADSPA_Handle)l_pData;
@@ -94,91 +77,41 @@ static void Compressor_activate(LADSPA_Handle p_instance)
 {
 	Compressor_Data* l_pData = (Compressor_Data*)p_instance;
     for(int i=0;i<2;i++){
-        Compressor_State_Init( &l_pData->m_cs[i] );
-    }
-}
-
-static void buffer_compress(
-    LADSPA_Data*      p_psrc,
-    LADSPA_Data*      p_pdst,
-    Compressor_State* p_pcs,
-    LADSPA_Data       p_unity,
-    LADSPA_Data       p_ratio_hi,
-    LADSPA_Data       p_ratio_lo,
-    LADSPA_Data       p_threshold,
-    LADSPA_Data       p_alpha_decay,
-    unsigned long     p_nsamples )
-{
-	LADSPA_Data *l_psrc = p_psrc;
-	LADSPA_Data *l_pdst = p_pdst;
-    LADSPA_Data *l_psrc_end = l_psrc + p_nsamples;
-    LADSPA_Data  l_root2 = sqrtf(2.0f);
-    for(;l_psrc!=l_psrc_end;l_psrc++,l_pdst++){
-        p_pcs->m_window[p_pcs->m_i_window] = *l_psrc;
-        LADSPA_Data l_peek = fabsf(*l_psrc);
-        LADSPA_Data l_peek2 = fabsf(
-            p_pcs->m_window[0]*PEEK2_K +
-            p_pcs->m_window[1]*PEEK2_K);
-        if(l_peek2 > l_peek )
-            l_peek = l_peek2;
-        if(l_peek > p_pcs->m_env){
-            p_pcs->m_env = l_peek;
-        }else{
-            LADSPA_Data l_delta = l_peek - p_pcs->m_env;
-            p_pcs->m_env += l_delta*p_alpha_decay;
-        }
-        if(p_pcs->m_env<ABS_MIN){
-			*l_pdst=0.0f;
-		}else{
-            LADSPA_Data l_env_db_in = log10f(p_pcs->m_env)*20.0f;
-            LADSPA_Data l_env_db_out;
-            if(l_env_db_in<=p_threshold){
-				LADSPA_Data l_comp_env_db = p_threshold - p_unity;
-				l_comp_env_db /= p_ratio_hi;
-                LADSPA_Data l_exp_env_db = l_env_db_in - p_threshold;
-				l_exp_env_db /= p_ratio_lo;
-                l_env_db_out = p_unity + l_comp_env_db + l_exp_env_db - l_env_db_in;
-			}else{
-                LADSPA_Data l_comp_env_db = l_env_db_in - p_unity;
-				l_comp_env_db /= p_ratio_hi;
-                l_env_db_out = p_unity + l_comp_env_db - l_env_db_in;
-			}
-            LADSPA_Data l_gain_factor = exp10f(l_env_db_out/20.0f);
-            *l_pdst = *l_psrc * l_gain_factor;
-		}
-        p_pcs->m_i_window++;
-        p_pcs->m_i_window%=N_WINDOW;
+        Dyn_State_init( &l_pData->m_ds[i] );
     }
 }
 
 static void Compressor_run(LADSPA_Handle p_instance, unsigned long SampleCount)
 {
 	Compressor_Data* l_pData = (Compressor_Data*)p_instance;
-	unsigned long n;
-	LADSPA_Data l_alpha_decay = 1.0 - powf(0.05,1.0 / *l_pData->m_pdata[PORT_DECAY] / l_pData->m_sample_rate);
-
-	buffer_compress(
-		l_pData->m_pdata[PORT_RX1],
-		l_pData->m_pdata[PORT_TX1],
-        &l_pData->m_cs[0],
-		*l_pData->m_pdata[PORT_UNITY],
-		*l_pData->m_pdata[PORT_RATIO_HI],
-		*l_pData->m_pdata[PORT_RATIO_LO],
-		*l_pData->m_pdata[PORT_THRESHOLD],
-		l_alpha_decay,
-		SampleCount );
-	
-	buffer_compress(
-		l_pData->m_pdata[PORT_RX2],
-		l_pData->m_pdata[PORT_TX2],
-        &l_pData->m_cs[1],
+	LADSPA_Data l_alpha_attack = Dyn_attack_alpha(*l_pData->m_pdata[PORT_ATTACK], l_pData->m_sample_rate);
+	LADSPA_Data l_alpha_decay = Dyn_decay_alpha(*l_pData->m_pdata[PORT_DECAY], l_pData->m_sample_rate);
+	Dyn_Curve l_curve;
+	Dyn_Curve_init(
+		&l_curve,
 		*l_pData->m_pdata[PORT_UNITY],
 		*l_pData->m_pdata[PORT_RATIO_HI],
 		*l_pData->m_pdata[PORT_RATIO_LO],
-		*l_pData->m_pdata[PORT_THRESHOLD],
-		l_alpha_decay,
-		SampleCount );
-	
+		*l_pData->m_pdata[PORT_THRESHOLD] );
+
+	// the channels are compressed independently, see compressor_linked.c,
+	// as the lanes of Dyn_gain_lanes
+	LADSPA_Data *l_ppsrc[2] = { l_pData->m_pdata[PORT_RX1], l_pData->m_pdata[PORT_RX2] };
+	LADSPA_Data l_gain[2][DYN_GAIN_INTERVAL];
+	LADSPA_Data *l_ppgain[2] = { l_gain[0], l_gain[1] };
+	for(unsigned long l_n0=0;l_n0<SampleCount;l_n0+=DYN_GAIN_INTERVAL){
+		unsigned long l_n = SampleCount - l_n0;
+		if(l_n>DYN_GAIN_INTERVAL)
+			l_n = DYN_GAIN_INTERVAL;
+		Dyn_gain_lanes(l_pData->m_ds, &l_curve, l_alpha_attack, l_alpha_decay,
+		               l_ppsrc, 2, l_n0, l_ppgain, l_n);
+		for(int c=0;c<2;c++){
+			LADSPA_Data *l_psrc = l_ppsrc[c] + l_n0;
+			LADSPA_Data *l_pdst = l_pData->m_pdata[PORT_TX1+c] + l_n0;
+			for(unsigned long i=0;i<l_n;i++)
+				l_pdst[i] = l_psrc[i]*l_gain[c][i];
+		}
+	}
 }
 
 static void Compressor_deactivate(LADSPA_Handle p_instance)
@@ -202,6 +135,7 @@ static LADSPA_PortDescriptor Compressor_PortDescriptors[]=
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL
 };
 
@@ -215,7 +149,8 @@ static const char* Compressor_PortNames[]=
     "RatioHi(in/out)",
     "RatioLo(in/out)",
     "Threshold(dBFS)",
-    "Decay(seconds)"
+    "Decay(seconds)",
+    "Attack(seconds)"
 };
 
 static LADSPA_PortRangeHint Compressor_PortRangeHints[]=
@@ -251,7 +186,12 @@ static LADSPA_PortRangeHint Compressor_PortRangeHints[]=
 		LADSPA_HINT_BOUNDED_ABOVE|
 		LADSPA_HINT_DEFAULT_MIDDLE|
 		LADSPA_HINT_LOGARITHMIC,
-		0.001,5.0}
+		0.001,5.0},
+	{
+		LADSPA_HINT_BOUNDED_BELOW|
+		LADSPA_HINT_DEFAULT_MINIMUM|
+		LADSPA_HINT_BOUNDED_ABOVE,
+		0.0,0.5}
 };
 
 LADSPA_Descriptor Compressor_Descriptor=
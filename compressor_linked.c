@@ -0,0 +1,341 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+#include <stdlib.h>
+#include "dynamics.h"
+
+/*
+ * Compressor/expander for up to DYN_CHANNELS_MAX linked channels, e.g.
+ * a stereo pair or a surround bus. One envelope is taken from all the
+ * active channels, or from the sidechain inputs, and one gain is
+ * applied to every channel, so the image holds still and the gain
+ * computer runs once per sample instead of once per channel.
+ *
+ * Channels above Channels are passed through.
+ *
+ * Lookahead above 0 delays every channel, passed through or not, by
+ * that much, see dynamics.h, and reports the delay in samples on the
+ * latency port. True peak detects on the 4x oversampled signal. Attack
+ * 0 follows a rising peak at once.
+ */
+
+enum {
+    PORT_IN,
+    PORT_OUT = PORT_IN + DYN_CHANNELS_MAX,
+    PORT_SIDECHAIN = PORT_OUT + DYN_CHANNELS_MAX,
+    PORT_CHANNELS = PORT_SIDECHAIN + DYN_CHANNELS_MAX,
+    PORT_SIDECHAIN_ON,
+    PORT_UNITY,
+    PORT_RATIO_HI,
+    PORT_RATIO_LO,
+    PORT_THRESHOLD,
+    PORT_DECAY,
+    PORT_LOOKAHEAD,
+    PORT_LATENCY,
+    PORT_TRUE_PEAK,
+    PORT_ATTACK,
+    PORT_NPORTS
+};
+
+typedef struct
+{
+    LADSPA_Data  m_sample_rate;
+    LADSPA_Data *m_pport[PORT_NPORTS];
+    Dyn_State     m_ds;
+    Dyn_Lookahead m_la;
+} CompressorLinked_Data;
+
+static LADSPA_Handle CompressorLinked_instantiate(
+    const struct _LADSPA_Descriptor *p_pDescriptor,
+    unsigned long p_sample_rate)
+{
+    CompressorLinked_Data *l_pData = malloc( sizeof(CompressorLinked_Data) );
+    if(l_pData){
+        l_pData->m_sample_rate = (LADSPA_Data)p_sample_rate;
+        Dyn_State_init(&l_pData->m_ds);
+        if(!Dyn_Lookahead_init(&l_pData->m_la, l_pData->m_sample_rate)){
+            free(l_pData);
+            return NULL;
+        }
+    }
+    return (LADSPA_Handle)l_pData;
+}
+
+static void CompressorLinked_connect_port(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_port,
+    LADSPA_Data *p_pdata)
+{
+    CompressorLinked_Data *l_pData = (CompressorLinked_Data*)p_pInstance;
+    l_pData->m_pport[p_port] = p_pdata;
+}
+
+static void CompressorLinked_activate( LADSPA_Handle p_pInstance )
+{
+    CompressorLinked_Data *l_pData = (CompressorLinked_Data*)p_pInstance;
+    Dyn_State_init(&l_pData->m_ds);
+    Dyn_Lookahead_reset(&l_pData->m_la, l_pData->m_la.m_length);
+}
+
+static void CompressorLinked_run(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_sample_count)
+{
+    CompressorLinked_Data *l_pData = (CompressorLinked_Data*)p_pInstance;
+    LADSPA_Data **l_pport = l_pData->m_pport;
+
+    int l_nchannels = (int)*l_pport[PORT_CHANNELS];
+    if(l_nchannels < 1)
+        l_nchannels = 1;
+    if(l_nchannels > DYN_CHANNELS_MAX)
+        l_nchannels = DYN_CHANNELS_MAX;
+    LADSPA_Data **l_ppdetect = *l_pport[PORT_SIDECHAIN_ON] > 0.5f ?
+        &l_pport[PORT_SIDECHAIN] : &l_pport[PORT_IN];
+
+    LADSPA_Data l_alpha_attack = Dyn_attack_alpha(*l_pport[PORT_ATTACK],
+                                                  l_pData->m_sample_rate);
+    LADSPA_Data l_alpha_decay = Dyn_decay_alpha(*l_pport[PORT_DECAY],
+                                                l_pData->m_sample_rate);
+    unsigned long l_lookahead = Dyn_Lookahead_length(&l_pData->m_la,
+                                                     *l_pport[PORT_LOOKAHEAD],
+                                                     l_pData->m_sample_rate);
+    if(l_lookahead != l_pData->m_la.m_length)
+        Dyn_Lookahead_reset(&l_pData->m_la, l_lookahead);
+    Dyn_Lookahead *l_pla = l_lookahead ? &l_pData->m_la : NULL;
+    *l_pport[PORT_LATENCY] = (LADSPA_Data)l_lookahead;
+    l_pData->m_ds.m_true_peak = *l_pport[PORT_TRUE_PEAK] > 0.5f;
+
+    Dyn_Curve l_curve;
+    Dyn_Curve_init(&l_curve,
+                   *l_pport[PORT_UNITY],
+                   *l_pport[PORT_RATIO_HI],
+                   *l_pport[PORT_RATIO_LO],
+                   *l_pport[PORT_THRESHOLD]);
+
+    LADSPA_Data l_gain[DYN_GAIN_INTERVAL];
+    LADSPA_Data l_unity[DYN_GAIN_INTERVAL];
+    for(unsigned long i=0;i<DYN_GAIN_INTERVAL;i++)
+        l_unity[i] = 1.0f;
+    for(unsigned long l_n0=0;l_n0<p_sample_count;l_n0+=DYN_GAIN_INTERVAL){
+        unsigned long l_n = p_sample_count - l_n0;
+        if(l_n > DYN_GAIN_INTERVAL)
+            l_n = DYN_GAIN_INTERVAL;
+        Dyn_gain(&l_pData->m_ds, &l_curve, l_alpha_attack, l_alpha_decay,
+                 l_pla, l_ppdetect, l_nchannels, l_n0, l_gain, l_n);
+        if(l_pla){
+            // the passed through channels keep the same latency
+            Dyn_Lookahead_delay(l_pla, &l_pport[PORT_IN], &l_pport[PORT_OUT],
+                                l_gain, 0, l_nchannels, l_n0, l_n);
+            Dyn_Lookahead_delay(l_pla, &l_pport[PORT_IN], &l_pport[PORT_OUT],
+                                l_unity, l_nchannels,
+                                DYN_CHANNELS_MAX - l_nchannels, l_n0, l_n);
+        }else{
+            for(int c=0;c<l_nchannels;c++){
+                LADSPA_Data *l_psrc = l_pport[PORT_IN+c] + l_n0;
+                LADSPA_Data *l_pdst = l_pport[PORT_OUT+c] + l_n0;
+                for(unsigned long i=0;i<l_n;i++)
+                    l_pdst[i] = l_psrc[i]*l_gain[i];
+            }
+        }
+    }
+
+    for(int c=l_nchannels;c<DYN_CHANNELS_MAX && !l_pla;c++){
+        LADSPA_Data *l_psrc = l_pport[PORT_IN+c];
+        LADSPA_Data *l_pdst = l_pport[PORT_OUT+c];
+        if(l_pdst != l_psrc){
+            for(unsigned long i=0;i<p_sample_count;i++)
+                l_pdst[i] = l_psrc[i];
+        }
+    }
+}
+
+static void CompressorLinked_cleanup( LADSPA_Handle p_pInstance )
+{
+    CompressorLinked_Data *l_pData = (CompressorLinked_Data*)p_pInstance;
+    Dyn_Lookahead_free(&l_pData->m_la);
+    free( p_pInstance );
+}
+
+static LADSPA_PortDescriptor CompressorLinked_PortDescriptors[]=
+{
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+};
+
+static const char *CompressorLinked_PortNames[]=
+{
+    "Input1",
+    "Input2",
+    "Input3",
+    "Input4",
+    "Input5",
+    "Input6",
+    "Input7",
+    "Input8",
+    "Output1",
+    "Output2",
+    "Output3",
+    "Output4",
+    "Output5",
+    "Output6",
+    "Output7",
+    "Output8",
+    "Sidechain1",
+    "Sidechain2",
+    "Sidechain3",
+    "Sidechain4",
+    "Sidechain5",
+    "Sidechain6",
+    "Sidechain7",
+    "Sidechain8",
+    "Channels",
+    "Sidechain(0=off,1=on)",
+    "Unity(dBFS)",
+    "RatioHi(in/out)",
+    "RatioLo(in/out)",
+    "Threshold(dBFS)",
+    "Decay(seconds)",
+    "Lookahead(ms)",
+    "latency",
+    "True peak(0=off,1=on)",
+    "Attack(seconds)"
+};
+
+static LADSPA_PortRangeHint CompressorLinked_PortRangeHints[]=
+{
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_INTEGER | LADSPA_HINT_DEFAULT_MINIMUM,
+     1.0f, DYN_CHANNELS_MAX},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f, 1.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MAXIMUM,
+     -96.0f, 0.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE,
+     0.01f, 100.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE,
+     0.01f, 100.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MINIMUM,
+     -140.0f, 0.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE,
+     0.001f, 5.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MINIMUM,
+     0.0f, DYN_LOOKAHEAD_MAX_MS},
+    {0,0.0f,0.0f},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f, 1.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MINIMUM,
+     0.0f, 0.5f}
+};
+
+LADSPA_Descriptor CompressorLinked_Descriptor=
+{
+    5837,
+    "compressor_linked",
+    LADSPA_PROPERTY_HARD_RT_CAPABLE,
+    "Linked Compressor, up to 8 channels with sidechain",
+    "Timothy William Krause",
+    "None",
+    PORT_NPORTS,
+    CompressorLinked_PortDescriptors,
+    CompressorLinked_PortNames,
+    CompressorLinked_PortRangeHints,
+    NULL,
+    CompressorLinked_instantiate,
+    CompressorLinked_connect_port,
+    CompressorLinked_activate,
+    CompressorLinked_run,
+    NULL,
+    NULL,
+    NULL,
+    CompressorLinked_cleanup
+};
@@ -0,0 +1,441 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include "dynamics.h"
+
+/*
+ * Three band compressor/expander on a stereo pair. Each band has its
+ * own gain curve and decay, the two channels of a band are linked.
+ *
+ * The crossovers are Linkwitz-Riley, order 4, the Butterworth order 2
+ * stage of BW_LP/BW_HP applied twice
+ *
+ *                      1                          s^4
+ *  Hlp(s) = ----------------------  Hhp(s) = ----------------------
+ *            (s^2 + sqrt(2)*s + 1)^2          (s^2 + sqrt(2)*s + 1)^2
+ *
+ * Hlp + Hhp is the allpass
+ *
+ *             s^2 - sqrt(2)*s + 1
+ *  Hap(s) = ---------------------
+ *             s^2 + sqrt(2)*s + 1
+ *
+ * The input splits at Low crossover, the upper part splits again at
+ * High crossover and the low band goes through the allpass of High
+ * crossover, so the three bands sum to a flat allpass.
+ *
+ * All the sections of a split, for both channels or all three bands,
+ * sit in the MBC_LANES lanes of one MBC_Lanes and step together. The
+ * audio is filtered, detected and summed DYN_GAIN_INTERVAL samples at
+ * a time, the sub blocks stay in cache.
+ */
+
+#define MBC_CHANNELS 2
+#define MBC_BANDS 3
+#define MBC_LANES 4
+
+enum {
+    BAND_UNITY,
+    BAND_RATIO_HI,
+    BAND_RATIO_LO,
+    BAND_THRESHOLD,
+    BAND_DECAY,
+    BAND_NPORTS
+};
+
+enum {
+    PORT_IN,
+    PORT_OUT = PORT_IN + MBC_CHANNELS,
+    PORT_CROSSOVER_LO = PORT_OUT + MBC_CHANNELS,
+    PORT_CROSSOVER_HI,
+    PORT_BAND,
+    PORT_NPORTS = PORT_BAND + MBC_BANDS*BAND_NPORTS
+};
+
+/*
+ * Two cascaded sections per lane
+ *
+ *   m = x - a1*z1 - a2*z2
+ *   y = b0*m + b1*z1 + b2*z2
+ */
+typedef struct {
+    LADSPA_Data m_b0[2][MBC_LANES];
+    LADSPA_Data m_b1[2][MBC_LANES];
+    LADSPA_Data m_b2[2][MBC_LANES];
+    LADSPA_Data m_a1[2][MBC_LANES];
+    LADSPA_Data m_a2[2][MBC_LANES];
+    LADSPA_Data m_z1[2][MBC_LANES];
+    LADSPA_Data m_z2[2][MBC_LANES];
+} MBC_Lanes;
+
+enum {
+    SECTION_LP,
+    SECTION_HP,
+    SECTION_AP,
+    SECTION_THRU
+};
+
+typedef struct {
+    LADSPA_Data  m_sample_rate;
+    LADSPA_Data *m_pport[PORT_NPORTS];
+    LADSPA_Data  m_crossover_lo;
+    LADSPA_Data  m_crossover_hi;
+    // lanes LP lo, HP lo for channel 0, then channel 1
+    MBC_Lanes    m_split;
+    // lanes AP hi, LP hi, HP hi and an unused lane, one per channel
+    MBC_Lanes    m_bands[MBC_CHANNELS];
+    Dyn_State    m_ds[MBC_BANDS];
+} CompressorMultiband_Data;
+
+static void MBC_Lanes_init( MBC_Lanes *p_pml )
+{
+    for(int s=0;s<2;s++){
+        for(int l=0;l<MBC_LANES;l++){
+            p_pml->m_z1[s][l] = 0.0f;
+            p_pml->m_z2[s][l] = 0.0f;
+        }
+    }
+}
+
+/*
+ * Bilinear transform with K = 1/tan(omega/2), as BW_LP/BW_HP, of the
+ * order 2 Butterworth stage, or of the Linkwitz-Riley allpass.
+ */
+static void MBC_Lanes_set( MBC_Lanes *p_pml, int p_section, int p_lane,
+                           int p_type, LADSPA_Data K )
+{
+    LADSPA_Data c = M_SQRT2f;
+    LADSPA_Data l_a0 = K*K + K*c + 1.0f;
+    LADSPA_Data l_a1 = 2.0f - 2.0f*K*K;
+    LADSPA_Data l_a2 = K*K - K*c + 1.0f;
+    LADSPA_Data l_b0, l_b1, l_b2;
+    switch(p_type){
+    case SECTION_LP:
+        l_b0 = 1.0f;
+        l_b1 = 2.0f;
+        l_b2 = 1.0f;
+        break;
+    case SECTION_HP:
+        l_b0 = K*K;
+        l_b1 = -2.0f*K*K;
+        l_b2 = K*K;
+        break;
+    case SECTION_AP:
+        l_b0 = l_a2;
+        l_b1 = l_a1;
+        l_b2 = l_a0;
+        break;
+    default:
+        l_a0 = 1.0f;
+        l_a1 = 0.0f;
+        l_a2 = 0.0f;
+        l_b0 = 1.0f;
+        l_b1 = 0.0f;
+        l_b2 = 0.0f;
+        break;
+    }
+    p_pml->m_b0[p_section][p_lane] = l_b0/l_a0;
+    p_pml->m_b1[p_section][p_lane] = l_b1/l_a0;
+    p_pml->m_b2[p_section][p_lane] = l_b2/l_a0;
+    p_pml->m_a1[p_section][p_lane] = l_a1/l_a0;
+    p_pml->m_a2[p_section][p_lane] = l_a2/l_a0;
+}
+
+/*
+ * One sample through both sections of every lane, in place. The lane
+ * loops have a fixed count and no dependency between the lanes, they
+ * run as one vector.
+ */
+static void MBC_Lanes_eval( MBC_Lanes *p_pml, LADSPA_Data *p_px )
+{
+    for(int s=0;s<2;s++){
+        for(int l=0;l<MBC_LANES;l++){
+            LADSPA_Data l_z1 = p_pml->m_z1[s][l];
+            LADSPA_Data l_z2 = p_pml->m_z2[s][l];
+            LADSPA_Data l_m = p_px[l] - p_pml->m_a1[s][l]*l_z1
+                                      - p_pml->m_a2[s][l]*l_z2;
+            p_px[l] = p_pml->m_b0[s][l]*l_m + p_pml->m_b1[s][l]*l_z1
+                    + p_pml->m_b2[s][l]*l_z2;
+            p_pml->m_z2[s][l] = l_z1;
+            p_pml->m_z1[s][l] = l_m;
+        }
+    }
+}
+
+static void CompressorMultiband_design( CompressorMultiband_Data *p_pData,
+                                        LADSPA_Data p_lo, LADSPA_Data p_hi )
+{
+    LADSPA_Data l_K_lo = 1.0f/tanf(M_PIf*p_lo/p_pData->m_sample_rate);
+    LADSPA_Data l_K_hi = 1.0f/tanf(M_PIf*p_hi/p_pData->m_sample_rate);
+    for(int s=0;s<2;s++){
+        for(int c=0;c<MBC_CHANNELS;c++){
+            MBC_Lanes_set(&p_pData->m_split, s, 2*c, SECTION_LP, l_K_lo);
+            MBC_Lanes_set(&p_pData->m_split, s, 2*c+1, SECTION_HP, l_K_lo);
+            MBC_Lanes *l_pbands = &p_pData->m_bands[c];
+            // the allpass is a single section
+            MBC_Lanes_set(l_pbands, s, 0, s ? SECTION_THRU : SECTION_AP, l_K_hi);
+            MBC_Lanes_set(l_pbands, s, 1, SECTION_LP, l_K_hi);
+            MBC_Lanes_set(l_pbands, s, 2, SECTION_HP, l_K_hi);
+            MBC_Lanes_set(l_pbands, s, 3, SECTION_THRU, l_K_hi);
+        }
+    }
+    p_pData->m_crossover_lo = p_lo;
+    p_pData->m_crossover_hi = p_hi;
+}
+
+static LADSPA_Handle CompressorMultiband_instantiate(
+    const struct _LADSPA_Descriptor *p_pDescriptor,
+    unsigned long p_sample_rate)
+{
+    CompressorMultiband_Data *l_pData = malloc( sizeof(CompressorMultiband_Data) );
+    if(l_pData){
+        l_pData->m_sample_rate = (LADSPA_Data)p_sample_rate;
+        // designed on the first run
+        l_pData->m_crossover_lo = 0.0f;
+        l_pData->m_crossover_hi = 0.0f;
+        MBC_Lanes_init(&l_pData->m_split);
+        for(int c=0;c<MBC_CHANNELS;c++)
+            MBC_Lanes_init(&l_pData->m_bands[c]);
+        for(int b=0;b<MBC_BANDS;b++)
+            Dyn_State_init(&l_pData->m_ds[b]);
+    }
+    return (LADSPA_Handle)l_pData;
+}
+
+static void CompressorMultiband_connect_port(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_port,
+    LADSPA_Data *p_pdata)
+{
+    CompressorMultiband_Data *l_pData = (CompressorMultiband_Data*)p_pInstance;
+    l_pData->m_pport[p_port] = p_pdata;
+}
+
+static void CompressorMultiband_activate( LADSPA_Handle p_pInstance )
+{
+    CompressorMultiband_Data *l_pData = (CompressorMultiband_Data*)p_pInstance;
+    MBC_Lanes_init(&l_pData->m_split);
+    for(int c=0;c<MBC_CHANNELS;c++)
+        MBC_Lanes_init(&l_pData->m_bands[c]);
+    for(int b=0;b<MBC_BANDS;b++)
+        Dyn_State_init(&l_pData->m_ds[b]);
+}
+
+static void CompressorMultiband_run(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_sample_count)
+{
+    CompressorMultiband_Data *l_pData = (CompressorMultiband_Data*)p_pInstance;
+    LADSPA_Data **l_pport = l_pData->m_pport;
+
+    LADSPA_Data l_nyquist = 0.49f*l_pData->m_sample_rate;
+    LADSPA_Data l_lo = *l_pport[PORT_CROSSOVER_LO];
+    LADSPA_Data l_hi = *l_pport[PORT_CROSSOVER_HI];
+    if(l_lo > l_nyquist)
+        l_lo = l_nyquist;
+    if(l_hi > l_nyquist)
+        l_hi = l_nyquist;
+    if(l_hi < l_lo)
+        l_hi = l_lo;
+    if(l_lo != l_pData->m_crossover_lo || l_hi != l_pData->m_crossover_hi)
+        CompressorMultiband_design(l_pData, l_lo, l_hi);
+
+    Dyn_Curve l_curve[MBC_BANDS];
+    LADSPA_Data l_alpha_decay[MBC_BANDS];
+    for(int b=0;b<MBC_BANDS;b++){
+        LADSPA_Data **l_pband = &l_pport[PORT_BAND + b*BAND_NPORTS];
+        Dyn_Curve_init(&l_curve[b],
+                       *l_pband[BAND_UNITY],
+                       *l_pband[BAND_RATIO_HI],
+                       *l_pband[BAND_RATIO_LO],
+                       *l_pband[BAND_THRESHOLD]);
+        l_alpha_decay[b] = Dyn_decay_alpha(*l_pband[BAND_DECAY],
+                                           l_pData->m_sample_rate);
+    }
+
+    LADSPA_Data l_band[MBC_BANDS][MBC_CHANNELS][DYN_GAIN_INTERVAL];
+    LADSPA_Data l_gain[MBC_BANDS][DYN_GAIN_INTERVAL];
+    for(unsigned long l_n0=0;l_n0<p_sample_count;l_n0+=DYN_GAIN_INTERVAL){
+        unsigned long l_n = p_sample_count - l_n0;
+        if(l_n > DYN_GAIN_INTERVAL)
+            l_n = DYN_GAIN_INTERVAL;
+
+        for(unsigned long i=0;i<l_n;i++){
+            LADSPA_Data l_x[MBC_LANES];
+            for(int c=0;c<MBC_CHANNELS;c++){
+                LADSPA_Data l_in = l_pport[PORT_IN+c][l_n0+i];
+                l_x[2*c] = l_in;
+                l_x[2*c+1] = l_in;
+            }
+            MBC_Lanes_eval(&l_pData->m_split, l_x);
+            for(int c=0;c<MBC_CHANNELS;c++){
+                LADSPA_Data l_y[MBC_LANES];
+                l_y[0] = l_x[2*c];
+                l_y[1] = l_x[2*c+1];
+                l_y[2] = l_x[2*c+1];
+                l_y[3] = 0.0f;
+                MBC_Lanes_eval(&l_pData->m_bands[c], l_y);
+                for(int b=0;b<MBC_BANDS;b++)
+                    l_band[b][c][i] = l_y[b];
+            }
+        }
+
+        for(int b=0;b<MBC_BANDS;b++){
+            LADSPA_Data *l_ppsrc[MBC_CHANNELS];
+            for(int c=0;c<MBC_CHANNELS;c++)
+                l_ppsrc[c] = l_band[b][c];
+            Dyn_gain(&l_pData->m_ds[b], &l_curve[b], 1.0f, l_alpha_decay[b],
+                     NULL, l_ppsrc, MBC_CHANNELS, 0, l_gain[b], l_n);
+        }
+
+        for(int c=0;c<MBC_CHANNELS;c++){
+            LADSPA_Data *l_pdst = l_pport[PORT_OUT+c] + l_n0;
+            for(unsigned long i=0;i<l_n;i++){
+                l_pdst[i] = l_band[0][c][i]*l_gain[0][i]
+                          + l_band[1][c][i]*l_gain[1][i]
+                          + l_band[2][c][i]*l_gain[2][i];
+            }
+        }
+    }
+}
+
+static void CompressorMultiband_cleanup( LADSPA_Handle p_pInstance )
+{
+    free( p_pInstance );
+}
+
+static LADSPA_PortDescriptor CompressorMultiband_PortDescriptors[]=
+{
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+};
+
+static const char *CompressorMultiband_PortNames[]=
+{
+    "InputL",
+    "InputR",
+    "OutputL",
+    "OutputR",
+    "Low crossover(Hertz)",
+    "High crossover(Hertz)",
+    "Low Unity(dBFS)",
+    "Low RatioHi(in/out)",
+    "Low RatioLo(in/out)",
+    "Low Threshold(dBFS)",
+    "Low Decay(seconds)",
+    "Mid Unity(dBFS)",
+    "Mid RatioHi(in/out)",
+    "Mid RatioLo(in/out)",
+    "Mid Threshold(dBFS)",
+    "Mid Decay(seconds)",
+    "High Unity(dBFS)",
+    "High RatioHi(in/out)",
+    "High RatioLo(in/out)",
+    "High Threshold(dBFS)",
+    "High Decay(seconds)"
+};
+
+#define MBC_BAND_HINTS \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_DEFAULT_MAXIMUM, \
+     -96.0f, 0.0f}, \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE, \
+     0.01f, 100.0f}, \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE, \
+     0.01f, 100.0f}, \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_DEFAULT_MINIMUM, \
+     -140.0f, 0.0f}, \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE, \
+     0.001f, 5.0f}
+
+static LADSPA_PortRangeHint CompressorMultiband_PortRangeHints[]=
+{
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE,
+     20.0f, 2000.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC | LADSPA_HINT_DEFAULT_MIDDLE,
+     200.0f, 20.0e3f},
+    MBC_BAND_HINTS,
+    MBC_BAND_HINTS,
+    MBC_BAND_HINTS
+};
+
+LADSPA_Descriptor CompressorMultiband_Descriptor=
+{
+    5838,
+    "compressor_multiband",
+    LADSPA_PROPERTY_HARD_RT_CAPABLE,
+    "Multiband Compressor, 3 bands with Linkwitz-Riley crossovers",
+    "Timothy William Krause",
+    "None",
+    PORT_NPORTS,
+    CompressorMultiband_PortDescriptors,
+    CompressorMultiband_PortNames,
+    CompressorMultiband_PortRangeHints,
+    NULL,
+    CompressorMultiband_instantiate,
+    CompressorMultiband_connect_port,
+    CompressorMultiband_activate,
+    CompressorMultiband_run,
+    NULL,
+    NULL,
+    NULL,
+    CompressorMultiband_cleanup
+};
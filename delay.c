@@ -24,12 +24,15 @@ Contact: tim.krause@twkrause.ca
 
 */
 #include <fad.h>
+#include "delay_ring.h"
 #include <ladspa.h>
 #include <math.h>
 #include <stdlib.h>
 
 
 #define DELAY_MAX 3.0
+#define DELAY_BLOCK 256
+#define DELAY_XFADE 0.01
 
 
 enum {
@@ -39,6 +42,7 @@ enum {
 	PORT_WET,
 	PORT_DRY,
 	PORT_FEEDBACK,
+	PORT_COMPACT,
 	PORT_NPORTS
 };
 
@@ -46,11 +50,25 @@ typedef struct
 {
 	unsigned long m_sample_rate;
 	LADSPA_Data *m_pport[PORT_NPORTS];
-	float      *m_pdata;
-	long  m_Nbuf;
+	Delay_Ring m_ring;
 	long  m_write_index;
+	float m_delay;
+	float m_delay_old;
+	long  m_Nxfade;
+	long  m_xfade;
+	int   m_started;
 } Delay;
 
+/*
+ * Ring samples for a delay of p_delay (<= 0) samples, the reads reach
+ * FadNwindow() back from there and Delay_Ring_Nblock wants DELAY_BLOCK
+ * spare.
+ */
+static long Delay_Nring( float p_delay )
+{
+	return (long)ceilf(-p_delay) + FadNwindow() + DELAY_BLOCK + 1;
+}
+
 static LADSPA_Handle Delay_instantiate(
 	const struct _LADSPA_Descriptor *p_pDescriptor,
 	unsigned long p_sample_rate )
@@ -60,12 +78,15 @@ static LADSPA_Handle Delay_instantiate(
 		return NULL;
 	
 	l_pDelay->m_sample_rate = p_sample_rate;
-	l_pDelay->m_Nbuf = (long)(p_sample_rate*DELAY_MAX) + FadNwindow();
 	l_pDelay->m_write_index = 0;
+	l_pDelay->m_Nxfade = (long)(p_sample_rate*DELAY_XFADE);
+	int i;
+	for(i=0;i<PORT_NPORTS;i++)
+		l_pDelay->m_pport[i] = NULL;
 	
-	l_pDelay->m_pdata = malloc( sizeof(float) * l_pDelay->m_Nbuf );
-	
-	if( l_pDelay->m_pdata == NULL ) {
+	if( !Delay_Ring_init( &l_pDelay->m_ring,
+			Delay_Nring( -(float)(Delay_Ring_hint()*p_sample_rate) ),
+			Delay_Nring( -(float)(DELAY_MAX*p_sample_rate) ) ) ) {
 		free( l_pDelay );
 		return NULL;
 	}
@@ -86,48 +107,106 @@ static void Delay_activate( LADSPA_Handle p_instance )
 {
 	Delay* l_pDelay = (Delay*)p_instance;
 	l_pDelay->m_write_index = 0;
-	long i;
-	for(i=0;i<l_pDelay->m_Nbuf;i++){
-		l_pDelay->m_pdata[i]=0.0;
-	}
+	l_pDelay->m_xfade = 0;
+	l_pDelay->m_started = 0;
+	// size the ring for the delay set now, when the host has connected it
+	long l_N = 0;
+	if( l_pDelay->m_pport[PORT_DELAY] )
+		l_N = Delay_Nring( -*l_pDelay->m_pport[PORT_DELAY]/1000.0f * l_pDelay->m_sample_rate );
+	// the storage follows the port at activate only
+	int l_compact = l_pDelay->m_pport[PORT_COMPACT] && *l_pDelay->m_pport[PORT_COMPACT] > 0.0f;
+	Delay_Ring_reset( &l_pDelay->m_ring, l_N, l_compact );
 }
 
+/*
+ * Runs in blocks of up to Delay_Ring_Nblock samples, the input block is
+ * written to the ring, all its wet samples are read, and then they are
+ * mixed and fed back. A block of one sample is the plain per sample
+ * order. A new delay fades in over DELAY_XFADE seconds from the old
+ * one, both read as above, changes during the fade wait for its end.
+ */
 static void Delay_run( LADSPA_Handle p_instance, unsigned long p_sample_count )
 {
 	Delay* l_pDelay = (Delay*)p_instance;
 	LADSPA_Data *l_psrc = l_pDelay->m_pport[PORT_IN];
 	LADSPA_Data *l_pdst = l_pDelay->m_pport[PORT_OUT];
-	long l_sample;
-
-	for( l_sample=0;l_sample<p_sample_count;l_sample++){
-		// write the incoming data to the cyclic buffer
-		l_pDelay->m_pdata[l_pDelay->m_write_index] = *l_psrc;
-		// calculate the start indicis and sample fractions
-		// for the dry and wet channels
-        long l_dry_index = l_pDelay->m_write_index - (FadNwindow()/2) - 1;
-		if( l_dry_index < 0 )
-			l_dry_index += l_pDelay->m_Nbuf;
-		float l_dry = l_pDelay->m_pdata[l_dry_index];
-        float  l_delay = -*l_pDelay->m_pport[PORT_DELAY]/1000.0f * l_pDelay->m_sample_rate;
-        long l_delay_int = (long)floorf(l_delay);
-        float l_delay_frac = l_delay - l_delay_int;
-        long l_wet_index = l_pDelay->m_write_index - FadNwindow() + l_delay_int;
-		if( l_wet_index < 0 )
-			l_wet_index += l_pDelay->m_Nbuf;
-		float l_wet = FadSample( l_pDelay->m_pdata, l_wet_index, l_pDelay->m_Nbuf, l_delay_frac );
-		// mix the wet and dry and write results to the output buffer
-		*l_pdst = l_wet * *l_pDelay->m_pport[PORT_WET] + l_dry * *l_pDelay->m_pport[PORT_DRY];
-		// perform the feedback
-		l_dry += l_wet * *l_pDelay->m_pport[PORT_FEEDBACK];
-		if( l_dry > 1.0 ) l_dry = 1.0;
-		if( l_dry <-1.0 ) l_dry =-1.0;
-		l_pDelay->m_pdata[l_dry_index] = l_dry;
-		// update the pointers and write index
-		l_psrc++;
-		l_pdst++;
-		l_pDelay->m_write_index++;
-		if( l_pDelay->m_write_index == l_pDelay->m_Nbuf )
-			l_pDelay->m_write_index = 0;
+	LADSPA_Data l_wet_gain = *l_pDelay->m_pport[PORT_WET];
+	LADSPA_Data l_dry_gain = *l_pDelay->m_pport[PORT_DRY];
+	LADSPA_Data l_feedback = *l_pDelay->m_pport[PORT_FEEDBACK];
+	float  l_delay = -*l_pDelay->m_pport[PORT_DELAY]/1000.0f * l_pDelay->m_sample_rate;
+	LADSPA_Data l_wet[DELAY_BLOCK];
+	LADSPA_Data l_wet_old[DELAY_BLOCK];
+
+	// past the ring the delay waits at its end for the worker to grow it
+	Delay_Ring_grow( &l_pDelay->m_ring, Delay_Nring( l_delay ), l_pDelay->m_write_index );
+	float l_delay_min = -(float)(l_pDelay->m_ring.m_Nbuf - FadNwindow() - DELAY_BLOCK - 1);
+	if( l_delay < l_delay_min )
+		l_delay = l_delay_min;
+
+	if( !l_pDelay->m_started ){
+		l_pDelay->m_delay = l_delay;
+		l_pDelay->m_started = 1;
+	}else if( l_pDelay->m_xfade == 0 && l_delay != l_pDelay->m_delay ){
+		l_pDelay->m_delay_old = l_pDelay->m_delay;
+		l_pDelay->m_delay = l_delay;
+		l_pDelay->m_xfade = l_pDelay->m_Nxfade;
+	}
+
+	while( p_sample_count > 0 ){
+		long l_n = Delay_Ring_Nblock( &l_pDelay->m_ring, l_pDelay->m_delay );
+		if( l_pDelay->m_xfade ){
+			long l_Nold = Delay_Ring_Nblock( &l_pDelay->m_ring, l_pDelay->m_delay_old );
+			if( l_n > l_Nold )
+				l_n = l_Nold;
+			if( l_n > l_pDelay->m_xfade )
+				l_n = l_pDelay->m_xfade;
+		}
+		if( l_n > DELAY_BLOCK )
+			l_n = DELAY_BLOCK;
+		if( l_n > (long)p_sample_count )
+			l_n = p_sample_count;
+		if( l_n < 1 )
+			l_n = 1;
+		long i;
+		// write the incoming block to the cyclic buffer
+		long l_index = l_pDelay->m_write_index;
+		for( i=0;i<l_n;i++ ){
+			Delay_Ring_put( &l_pDelay->m_ring, l_index, l_psrc[i] );
+			if( ++l_index == l_pDelay->m_ring.m_Nbuf )
+				l_index = 0;
+		}
+		Delay_Ring_wrote( &l_pDelay->m_ring, l_n );
+		// all the wet reads at once
+		Delay_Ring_read( &l_pDelay->m_ring, l_pDelay->m_write_index, l_pDelay->m_delay, l_wet, l_n );
+		if( l_pDelay->m_xfade ){
+			Delay_Ring_read( &l_pDelay->m_ring, l_pDelay->m_write_index, l_pDelay->m_delay_old, l_wet_old, l_n );
+			float l_step = 1.0f/l_pDelay->m_Nxfade;
+			for( i=0;i<l_n;i++ ){
+				float l_g = (l_pDelay->m_xfade - i)*l_step;
+				l_wet[i] += l_g*(l_wet_old[i] - l_wet[i]);
+			}
+			l_pDelay->m_xfade -= l_n;
+		}
+		// mix and feed back
+		long l_dry_index = l_pDelay->m_write_index - (FadNwindow()/2) - 1;
+		if( l_dry_index < 0 ){
+			l_dry_index += l_pDelay->m_ring.m_Nbuf;
+			Delay_Ring_clear( &l_pDelay->m_ring, l_dry_index );
+		}
+		for( i=0;i<l_n;i++ ){
+			float l_dry = Delay_Ring_dry( &l_pDelay->m_ring, l_psrc[i] );
+			l_pdst[i] = l_wet[i] * l_wet_gain + l_dry * l_dry_gain;
+			l_dry += l_wet[i] * l_feedback;
+			if( l_dry > 1.0 ) l_dry = 1.0;
+			if( l_dry <-1.0 ) l_dry =-1.0;
+			Delay_Ring_put( &l_pDelay->m_ring, l_dry_index, l_dry );
+			if( ++l_dry_index == l_pDelay->m_ring.m_Nbuf )
+				l_dry_index = 0;
+		}
+		l_pDelay->m_write_index = l_index;
+		l_psrc += l_n;
+		l_pdst += l_n;
+		p_sample_count -= l_n;
 	}
 }
 
@@ -135,7 +214,7 @@ static void Delay_cleanup( LADSPA_Handle p_instance )
 {
 	Delay* l_pDelay = (Delay*)p_instance;
 	
-	free( l_pDelay->m_pdata );
+	Delay_Ring_free( &l_pDelay->m_ring );
 	free( l_pDelay );
 }
 
@@ -146,6 +225,7 @@ static LADSPA_PortDescriptor Delay_PortDescriptors[]=
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
 };
 
@@ -156,7 +236,8 @@ static const char* Delay_PortNames[]=
 	"Delay(ms)",
 	"Wet",
 	"Dry",
-	"Feedback"
+	"Feedback",
+	"Compact storage(on activate)"
 };
 
 static LADSPA_PortRangeHint Delay_PortRangeHints[]=
@@ -182,6 +263,10 @@ static LADSPA_PortRangeHint Delay_PortRangeHints[]=
 		LADSPA_HINT_BOUNDED_ABOVE |
 		LADSPA_HINT_DEFAULT_MIDDLE,
 		-1.0, 1.0
+	},
+	{ LADSPA_HINT_TOGGLED |
+		LADSPA_HINT_DEFAULT_0,
+		0.0, 0.0
 	}
 };
 
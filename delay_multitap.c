@@ -0,0 +1,432 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <fad.h>
+#include <ladspa.h>
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include "delay_ring.h"
+
+/*
+ * Stereo delay with MT_TAPS taps on one ring per channel.
+ *
+ * Each tap reads both rings at its own delay, weighs the two reads by
+ * its gain and balance into the output and by its feedback and balance
+ * back into the rings. With Ping-pong set the feedback of the left read
+ * goes into the right ring and the other way round, so the echoes of
+ * each tap cross sides on every repeat.
+ *
+ * As in delay.c the dry signal and the feedback are taken
+ * FadNwindow()/2 + 1 samples behind the write index, the centre of the
+ * interpolating reads, and the input is written a block at a time. All
+ * taps are read for the block, with Delay_Ring_read, before any of it
+ * is mixed or fed back, so a tap costs the dot products of its reads.
+ * Blocks are as long as the shortest tap allows, see
+ * Delay_Ring_Nblock. A read whose gain and feedback are both zero is
+ * skipped and does not count. A new tap delay fades in from the old
+ * one over MT_XFADE seconds.
+ */
+
+#define MT_TAPS 4
+#define MT_CHANNELS 2
+#define MT_DELAY_MAX 3.0
+#define MT_BLOCK 256
+#define MT_XFADE 0.01
+
+enum {
+    TAP_DELAY,
+    TAP_GAIN,
+    TAP_BALANCE,
+    TAP_FEEDBACK,
+    TAP_NPORTS
+};
+
+enum {
+    PORT_IN,
+    PORT_OUT = PORT_IN + MT_CHANNELS,
+    PORT_DRY = PORT_OUT + MT_CHANNELS,
+    PORT_PING_PONG,
+    PORT_TAP,
+    PORT_COMPACT = PORT_TAP + MT_TAPS*TAP_NPORTS,
+    PORT_NPORTS
+};
+
+typedef struct {
+    float m_delay;
+    float m_delay_old;
+    long  m_xfade;
+} MT_Tap;
+
+typedef struct {
+    LADSPA_Data  m_sample_rate;
+    LADSPA_Data *m_pport[PORT_NPORTS];
+    Delay_Ring   m_ring[MT_CHANNELS];
+    long         m_write_index[MT_CHANNELS];
+    MT_Tap       m_tap[MT_TAPS];
+    long         m_Nxfade;
+    int          m_started;
+} DelayMultitap_Data;
+
+/*
+ * Ring samples for taps up to p_delay (<= 0) samples back, the reads
+ * reach FadNwindow() further and Delay_Ring_Nblock wants MT_BLOCK
+ * spare.
+ */
+static long DelayMultitap_Nring( float p_delay )
+{
+    return (long)ceilf(-p_delay) + FadNwindow() + MT_BLOCK + 1;
+}
+
+/*
+ * The longest tap delay the controls ask for, in samples, <= 0.
+ */
+static float DelayMultitap_delay_min( DelayMultitap_Data *p_pData )
+{
+    float l_delay_min = 0.0f;
+    for(int t=0;t<MT_TAPS;t++){
+        float l_delay = -*p_pData->m_pport[PORT_TAP + t*TAP_NPORTS + TAP_DELAY]
+                        /1000.0f*p_pData->m_sample_rate;
+        if(l_delay < l_delay_min)
+            l_delay_min = l_delay;
+    }
+    return l_delay_min;
+}
+
+static LADSPA_Handle DelayMultitap_instantiate(
+    const struct _LADSPA_Descriptor *p_pDescriptor,
+    unsigned long p_sample_rate)
+{
+    DelayMultitap_Data *l_pData = malloc( sizeof(DelayMultitap_Data) );
+    if(!l_pData)
+        return NULL;
+    l_pData->m_sample_rate = (LADSPA_Data)p_sample_rate;
+    l_pData->m_Nxfade = (long)(p_sample_rate*MT_XFADE);
+    for(int i=0;i<PORT_NPORTS;i++)
+        l_pData->m_pport[i] = NULL;
+    long l_N = DelayMultitap_Nring( -(float)(Delay_Ring_hint()*p_sample_rate) );
+    long l_Nmax = DelayMultitap_Nring( -(float)(MT_DELAY_MAX*p_sample_rate) );
+    for(int c=0;c<MT_CHANNELS;c++){
+        if( !Delay_Ring_init( &l_pData->m_ring[c], l_N, l_Nmax ) ){
+            while(c--)
+                Delay_Ring_free( &l_pData->m_ring[c] );
+            free( l_pData );
+            return NULL;
+        }
+    }
+    return (LADSPA_Handle)l_pData;
+}
+
+static void DelayMultitap_connect_port(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_port,
+    LADSPA_Data *p_pdata)
+{
+    DelayMultitap_Data *l_pData = (DelayMultitap_Data*)p_pInstance;
+    l_pData->m_pport[p_port] = p_pdata;
+}
+
+static void DelayMultitap_activate( LADSPA_Handle p_pInstance )
+{
+    DelayMultitap_Data *l_pData = (DelayMultitap_Data*)p_pInstance;
+    l_pData->m_started = 0;
+    // size the rings for the taps set now, when the host has connected them
+    int l_connected = 1;
+    for(int t=0;t<MT_TAPS;t++)
+        l_connected &= l_pData->m_pport[PORT_TAP + t*TAP_NPORTS + TAP_DELAY] != NULL;
+    long l_N = l_connected ? DelayMultitap_Nring( DelayMultitap_delay_min( l_pData ) ) : 0;
+    // the storage follows the port at activate only
+    int l_compact = l_pData->m_pport[PORT_COMPACT] && *l_pData->m_pport[PORT_COMPACT] > 0.0f;
+    for(int c=0;c<MT_CHANNELS;c++){
+        l_pData->m_write_index[c] = 0;
+        Delay_Ring_reset( &l_pData->m_ring[c], l_N, l_compact );
+    }
+}
+
+static void DelayMultitap_run(
+    LADSPA_Handle p_pInstance,
+    unsigned long p_sample_count)
+{
+    DelayMultitap_Data *l_pData = (DelayMultitap_Data*)p_pInstance;
+    LADSPA_Data **l_pport = l_pData->m_pport;
+    LADSPA_Data l_dry_gain = *l_pport[PORT_DRY];
+    int l_ping_pong = *l_pport[PORT_PING_PONG] > 0.0f;
+
+    // past the rings the taps wait at their end for the worker to grow them
+    long l_Nring = DelayMultitap_Nring( DelayMultitap_delay_min( l_pData ) );
+    float l_delay_min = 0.0f;
+    for(int c=0;c<MT_CHANNELS;c++){
+        Delay_Ring *l_pring = &l_pData->m_ring[c];
+        Delay_Ring_grow( l_pring, l_Nring, l_pData->m_write_index[c] );
+        float l_min = -(float)(l_pring->m_Nbuf - FadNwindow() - MT_BLOCK - 1);
+        if( c == 0 || l_min > l_delay_min )
+            l_delay_min = l_min;
+    }
+
+    // gains into the output and the feedback, for each tap and read,
+    // a read with both at zero is skipped and does not limit the blocks
+    LADSPA_Data l_wet_gain[MT_TAPS][MT_CHANNELS];
+    LADSPA_Data l_fb_gain[MT_TAPS][MT_CHANNELS];
+    int l_active[MT_TAPS][MT_CHANNELS];
+    for(int t=0;t<MT_TAPS;t++){
+        LADSPA_Data **l_ptap = &l_pport[PORT_TAP + t*TAP_NPORTS];
+        LADSPA_Data l_balance = *l_ptap[TAP_BALANCE];
+        LADSPA_Data l_w[MT_CHANNELS];
+        l_w[0] = l_balance > 0.0f ? 1.0f - l_balance : 1.0f;
+        l_w[1] = l_balance < 0.0f ? 1.0f + l_balance : 1.0f;
+        for(int c=0;c<MT_CHANNELS;c++){
+            l_wet_gain[t][c] = *l_ptap[TAP_GAIN]*l_w[c];
+            l_fb_gain[t][c] = *l_ptap[TAP_FEEDBACK]*l_w[c];
+            l_active[t][c] = l_wet_gain[t][c] != 0.0f || l_fb_gain[t][c] != 0.0f;
+        }
+        MT_Tap *l_pt = &l_pData->m_tap[t];
+        float l_delay = -*l_ptap[TAP_DELAY]/1000.0f*l_pData->m_sample_rate;
+        if( l_delay < l_delay_min )
+            l_delay = l_delay_min;
+        if( !l_pData->m_started ){
+            l_pt->m_delay = l_delay;
+            l_pt->m_xfade = 0;
+        }else if( l_pt->m_xfade == 0 && l_delay != l_pt->m_delay ){
+            l_pt->m_delay_old = l_pt->m_delay;
+            l_pt->m_delay = l_delay;
+            l_pt->m_xfade = l_pData->m_Nxfade;
+        }
+    }
+    l_pData->m_started = 1;
+
+    LADSPA_Data l_read[MT_BLOCK];
+    LADSPA_Data l_read_old[MT_BLOCK];
+    LADSPA_Data l_wet[MT_CHANNELS][MT_BLOCK];
+    LADSPA_Data l_fb[MT_CHANNELS][MT_BLOCK];
+    LADSPA_Data l_dry[MT_CHANNELS][MT_BLOCK];
+    unsigned long l_n0 = 0;
+    while( l_n0 < p_sample_count ){
+        long l_n = MT_BLOCK;
+        if( l_n > (long)(p_sample_count - l_n0) )
+            l_n = p_sample_count - l_n0;
+        for(int t=0;t<MT_TAPS;t++){
+            MT_Tap *l_pt = &l_pData->m_tap[t];
+            int l_any = 0;
+            for(int c=0;c<MT_CHANNELS;c++){
+                if( !l_active[t][c] )
+                    continue;
+                l_any = 1;
+                long l_N = Delay_Ring_Nblock( &l_pData->m_ring[c], l_pt->m_delay );
+                if( l_n > l_N )
+                    l_n = l_N;
+                if( l_pt->m_xfade ){
+                    l_N = Delay_Ring_Nblock( &l_pData->m_ring[c], l_pt->m_delay_old );
+                    if( l_n > l_N )
+                        l_n = l_N;
+                }
+            }
+            if( l_any && l_pt->m_xfade && l_n > l_pt->m_xfade )
+                l_n = l_pt->m_xfade;
+        }
+        if( l_n < 1 )
+            l_n = 1;
+
+        // write the incoming block to the rings, the dry block comes
+        // out of the input before any output is written
+        for(int c=0;c<MT_CHANNELS;c++){
+            Delay_Ring *l_pring = &l_pData->m_ring[c];
+            const LADSPA_Data *l_psrc = l_pport[PORT_IN+c] + l_n0;
+            long l_index = l_pData->m_write_index[c];
+            for(long i=0;i<l_n;i++){
+                Delay_Ring_put( l_pring, l_index, l_psrc[i] );
+                l_dry[c][i] = Delay_Ring_dry( l_pring, l_psrc[i] );
+                if( ++l_index == l_pring->m_Nbuf )
+                    l_index = 0;
+            }
+            Delay_Ring_wrote( l_pring, l_n );
+            for(long i=0;i<l_n;i++){
+                l_wet[c][i] = 0.0f;
+                l_fb[c][i] = 0.0f;
+            }
+        }
+
+        // all the tap reads, summed into the output and the feedback
+        for(int t=0;t<MT_TAPS;t++){
+            MT_Tap *l_pt = &l_pData->m_tap[t];
+            for(int c=0;c<MT_CHANNELS;c++){
+                if( !l_active[t][c] )
+                    continue;
+                Delay_Ring_read( &l_pData->m_ring[c], l_pData->m_write_index[c],
+                                 l_pt->m_delay, l_read, l_n );
+                if( l_pt->m_xfade ){
+                    Delay_Ring_read( &l_pData->m_ring[c], l_pData->m_write_index[c],
+                                     l_pt->m_delay_old, l_read_old, l_n );
+                    float l_step = 1.0f/l_pData->m_Nxfade;
+                    for(long i=0;i<l_n;i++){
+                        float l_g = (l_pt->m_xfade - i)*l_step;
+                        l_read[i] += l_g*(l_read_old[i] - l_read[i]);
+                    }
+                }
+                LADSPA_Data l_wg = l_wet_gain[t][c];
+                LADSPA_Data l_fg = l_fb_gain[t][c];
+                LADSPA_Data *l_pfb = l_fb[l_ping_pong ? 1 - c : c];
+                for(long i=0;i<l_n;i++){
+                    l_wet[c][i] += l_wg*l_read[i];
+                    l_pfb[i] += l_fg*l_read[i];
+                }
+            }
+            // a silent tap's fade may end inside the block
+            if( l_pt->m_xfade )
+                l_pt->m_xfade = l_pt->m_xfade > l_n ? l_pt->m_xfade - l_n : 0;
+        }
+
+        // mix and feed back
+        for(int c=0;c<MT_CHANNELS;c++){
+            Delay_Ring *l_pring = &l_pData->m_ring[c];
+            LADSPA_Data *l_pdst = l_pport[PORT_OUT+c] + l_n0;
+            long l_dry_index = l_pData->m_write_index[c] - (FadNwindow()/2) - 1;
+            if( l_dry_index < 0 ){
+                l_dry_index += l_pring->m_Nbuf;
+                Delay_Ring_clear( l_pring, l_dry_index );
+            }
+            for(long i=0;i<l_n;i++){
+                LADSPA_Data l_x = l_dry[c][i];
+                l_pdst[i] = l_wet[c][i] + l_x*l_dry_gain;
+                l_x += l_fb[c][i];
+                if( l_x > 1.0f ) l_x = 1.0f;
+                if( l_x <-1.0f ) l_x =-1.0f;
+                Delay_Ring_put( l_pring, l_dry_index, l_x );
+                if( ++l_dry_index == l_pring->m_Nbuf )
+                    l_dry_index = 0;
+            }
+            l_pData->m_write_index[c] += l_n;
+            if( l_pData->m_write_index[c] >= l_pring->m_Nbuf )
+                l_pData->m_write_index[c] -= l_pring->m_Nbuf;
+        }
+        l_n0 += l_n;
+    }
+}
+
+static void DelayMultitap_cleanup( LADSPA_Handle p_pInstance )
+{
+    DelayMultitap_Data *l_pData = (DelayMultitap_Data*)p_pInstance;
+    for(int c=0;c<MT_CHANNELS;c++)
+        Delay_Ring_free( &l_pData->m_ring[c] );
+    free( l_pData );
+}
+
+#define MT_TAP_DESCRIPTORS \
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL, \
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL, \
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL, \
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+
+static LADSPA_PortDescriptor DelayMultitap_PortDescriptors[]=
+{
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    MT_TAP_DESCRIPTORS,
+    MT_TAP_DESCRIPTORS,
+    MT_TAP_DESCRIPTORS,
+    MT_TAP_DESCRIPTORS,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+};
+
+#define MT_TAP_NAMES(n) \
+    "Tap " #n " Delay(ms)", \
+    "Tap " #n " Gain", \
+    "Tap " #n " Balance", \
+    "Tap " #n " Feedback"
+
+static const char *DelayMultitap_PortNames[]=
+{
+    "InputL",
+    "InputR",
+    "OutputL",
+    "OutputR",
+    "Dry",
+    "Ping-pong",
+    MT_TAP_NAMES(1),
+    MT_TAP_NAMES(2),
+    MT_TAP_NAMES(3),
+    MT_TAP_NAMES(4),
+    "Compact storage(on activate)"
+};
+
+// the first tap sounds by default, the others are silent until set
+#define MT_TAP_HINTS(gain_default) \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_DEFAULT_LOW, \
+     0.0f, MT_DELAY_MAX*1000.0f}, \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     gain_default, \
+     -1.0f, 1.0f}, \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_DEFAULT_0, \
+     -1.0f, 1.0f}, \
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE | \
+     LADSPA_HINT_DEFAULT_0, \
+     -1.0f, 1.0f}
+
+static LADSPA_PortRangeHint DelayMultitap_PortRangeHints[]=
+{
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_1,
+     0.0f, 1.0f},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f, 0.0f},
+    MT_TAP_HINTS(LADSPA_HINT_DEFAULT_HIGH),
+    MT_TAP_HINTS(LADSPA_HINT_DEFAULT_0),
+    MT_TAP_HINTS(LADSPA_HINT_DEFAULT_0),
+    MT_TAP_HINTS(LADSPA_HINT_DEFAULT_0),
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f, 0.0f}
+};
+
+LADSPA_Descriptor DelayMultitap_Descriptor=
+{
+    5839,
+    "delay_multitap",
+    LADSPA_PROPERTY_HARD_RT_CAPABLE,
+    "Multi-tap stereo delay with ping-pong feedback",
+    "Timothy William Krause",
+    "None",
+    PORT_NPORTS,
+    DelayMultitap_PortDescriptors,
+    DelayMultitap_PortNames,
+    DelayMultitap_PortRangeHints,
+    NULL,
+    DelayMultitap_instantiate,
+    DelayMultitap_connect_port,
+    DelayMultitap_activate,
+    DelayMultitap_run,
+    NULL,
+    NULL,
+    NULL,
+    DelayMultitap_cleanup
+};
@@ -0,0 +1,434 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "delay_ring.h"
+#include <fad.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum {
+    RING_IDLE,
+    RING_WANT,      // queued for a buffer of m_Nwant
+    RING_READY,     // m_pnew holds it
+    RING_RETIRE,    // queued to free m_pold
+    RING_FAILED     // no memory, m_Nbuf stays until the next reset
+};
+
+// g_life_lock starts and stops the worker, g_lock guards the queue
+// and is only tried from the audio thread
+static pthread_mutex_t g_life_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static sem_t           g_wake;
+static pthread_t       g_thread;
+static int             g_nrings;
+static int             g_quit;
+static Delay_Ring     *g_pqueue;
+static int             g_mlock;
+
+/*
+ * A zeroed buffer of p_N samples of p_size bytes with every page
+ * touched, and locked when asked for.
+ */
+static void *Delay_Ring_alloc( long p_N, int p_size )
+{
+    char *l_pdata = calloc( p_N, p_size );
+    if( !l_pdata )
+        return NULL;
+    // calloc may hand out untouched zero pages
+    volatile char *l_ptouch = l_pdata;
+    long l_step = sysconf( _SC_PAGESIZE );
+    for(long i=0;i<p_N*p_size;i+=l_step)
+        l_ptouch[i] = 0;
+    if( g_mlock )
+        mlock( l_pdata, (size_t)p_size*p_N );
+    return l_pdata;
+}
+
+static void Delay_Ring_release( void *p_pdata, long p_N, int p_size )
+{
+    if( p_pdata && g_mlock )
+        munlock( p_pdata, (size_t)p_size*p_N );
+    free( p_pdata );
+}
+
+static void *Delay_Ring_data( const Delay_Ring *p_pring )
+{
+    if( p_pring->m_pdata16 )
+        return p_pring->m_pdata16;
+    return p_pring->m_pdata;
+}
+
+static void Delay_Ring_set_data( Delay_Ring *p_pring, void *p_pdata )
+{
+    p_pring->m_pdata = p_pring->m_size == sizeof(float) ? p_pdata : NULL;
+    p_pring->m_pdata16 = p_pring->m_size == sizeof(float) ? NULL : p_pdata;
+}
+
+/*
+ * p_n samples of a compact ring from p_index on, as floats, wrapping
+ * at the end.
+ */
+static void Delay_Ring_unpack( const Delay_Ring *p_pring, long p_index,
+                               float *p_pdst, long p_n )
+{
+    while( p_n > 0 ){
+        long l_n = p_pring->m_Nbuf - p_index;
+        if( l_n > p_n )
+            l_n = p_n;
+        const short *l_psrc = p_pring->m_pdata16 + p_index;
+        for(long i=0;i<l_n;i++)
+            p_pdst[i] = l_psrc[i]*(1.0f/DELAY_RING_SCALE);
+        p_pdst += l_n;
+        p_n -= l_n;
+        p_index = 0;
+    }
+}
+
+static void *Delay_Ring_worker( void *p_parg )
+{
+    for(;;){
+        sem_wait( &g_wake );
+        pthread_mutex_lock( &g_lock );
+        if( g_quit ){
+            pthread_mutex_unlock( &g_lock );
+            break;
+        }
+        while( g_pqueue ){
+            Delay_Ring *l_pring = g_pqueue;
+            g_pqueue = l_pring->m_pnext;
+            l_pring->m_queued = 0;
+            int l_state = atomic_load_explicit( &l_pring->m_state, memory_order_relaxed );
+            if( l_state == RING_WANT ){
+                l_pring->m_pnew = Delay_Ring_alloc( l_pring->m_Nwant, l_pring->m_size );
+                atomic_store_explicit( &l_pring->m_state,
+                                       l_pring->m_pnew ? RING_READY : RING_FAILED,
+                                       memory_order_release );
+            }else if( l_state == RING_RETIRE ){
+                Delay_Ring_release( l_pring->m_pold, l_pring->m_Nold, l_pring->m_size );
+                l_pring->m_pold = NULL;
+                atomic_store_explicit( &l_pring->m_state, RING_IDLE, memory_order_release );
+            }
+        }
+        pthread_mutex_unlock( &g_lock );
+    }
+    return NULL;
+}
+
+// with g_lock held
+static void Delay_Ring_unqueue( Delay_Ring *p_pring )
+{
+    if( !p_pring->m_queued )
+        return;
+    Delay_Ring **l_ppring = &g_pqueue;
+    while( *l_ppring != p_pring )
+        l_ppring = &(*l_ppring)->m_pnext;
+    *l_ppring = p_pring->m_pnext;
+    p_pring->m_queued = 0;
+}
+
+// never blocks, when the worker holds the lock the next grow call
+// tries again
+static void Delay_Ring_post( Delay_Ring *p_pring )
+{
+    if( pthread_mutex_trylock( &g_lock ) ){
+        p_pring->m_post = 1;
+        return;
+    }
+    p_pring->m_pnext = g_pqueue;
+    g_pqueue = p_pring;
+    p_pring->m_queued = 1;
+    pthread_mutex_unlock( &g_lock );
+    sem_post( &g_wake );
+    p_pring->m_post = 0;
+}
+
+/*
+ * TWK_DELAY_MAX from the environment, the longest delay in seconds
+ * the rings are allocated for at instantiate, 0 when unset.
+ */
+double Delay_Ring_hint( void )
+{
+    const char *l_pvalue = getenv( "TWK_DELAY_MAX" );
+    if( !l_pvalue )
+        return 0.0;
+    double l_hint = strtod( l_pvalue, NULL );
+    return l_hint > 0.0 ? l_hint : 0.0;
+}
+
+/*
+ * A zeroed float ring of p_N samples that may grow to p_Nmax. Returns 0 when
+ * out of memory or the worker can not be started.
+ */
+int Delay_Ring_init( Delay_Ring *p_pring, long p_N, long p_Nmax )
+{
+    memset( p_pring, 0, sizeof(Delay_Ring) );
+    if( p_N > p_Nmax )
+        p_N = p_Nmax;
+    if( p_N < 1 )
+        p_N = 1;
+    atomic_init( &p_pring->m_state, RING_IDLE );
+    p_pring->m_size = sizeof(float);
+
+    pthread_mutex_lock( &g_life_lock );
+    if( g_nrings == 0 ){
+        g_mlock = getenv( "TWK_DELAY_MLOCK" ) != NULL;
+        g_quit = 0;
+        sem_init( &g_wake, 0, 0 );
+        if( pthread_create( &g_thread, NULL, Delay_Ring_worker, NULL ) ){
+            sem_destroy( &g_wake );
+            pthread_mutex_unlock( &g_life_lock );
+            return 0;
+        }
+    }
+    g_nrings++;
+    p_pring->m_pdata = Delay_Ring_alloc( p_N, p_pring->m_size );
+    pthread_mutex_unlock( &g_life_lock );
+    p_pring->m_Ndry = FadNwindow()/2 + 1;
+    p_pring->m_pdry = calloc( p_pring->m_Ndry, sizeof(float) );
+    if( !p_pring->m_pdata || !p_pring->m_pdry ){
+        Delay_Ring_free( p_pring );
+        return 0;
+    }
+    p_pring->m_Nbuf = p_N;
+    p_pring->m_Nmax = p_Nmax;
+    p_pring->m_Nvalid = p_N;
+    p_pring->m_Nclean = p_N;
+    return 1;
+}
+
+void Delay_Ring_free( Delay_Ring *p_pring )
+{
+    pthread_mutex_lock( &g_life_lock );
+    pthread_mutex_lock( &g_lock );
+    Delay_Ring_unqueue( p_pring );
+    Delay_Ring_release( p_pring->m_pnew, p_pring->m_Nwant, p_pring->m_size );
+    Delay_Ring_release( p_pring->m_pold, p_pring->m_Nold, p_pring->m_size );
+    Delay_Ring_release( Delay_Ring_data( p_pring ), p_pring->m_Nbuf, p_pring->m_size );
+    free( p_pring->m_pdry );
+    int l_stop = --g_nrings == 0;
+    if( l_stop )
+        g_quit = 1;
+    pthread_mutex_unlock( &g_lock );
+    if( l_stop ){
+        sem_post( &g_wake );
+        pthread_join( g_thread, NULL );
+        sem_destroy( &g_wake );
+    }
+    pthread_mutex_unlock( &g_life_lock );
+}
+
+/*
+ * Empties the ring for activate, the contents go stale and are zeroed
+ * as the reads reach them. A ring smaller than p_N samples, or not
+ * compact as p_compact asks, is replaced by a zeroed one first, one
+ * that can not be allocated keeps the old ring. Blocks on the worker,
+ * not for the audio thread.
+ */
+void Delay_Ring_reset( Delay_Ring *p_pring, long p_N, int p_compact )
+{
+    pthread_mutex_lock( &g_lock );
+    Delay_Ring_unqueue( p_pring );
+    Delay_Ring_release( p_pring->m_pnew, p_pring->m_Nwant, p_pring->m_size );
+    Delay_Ring_release( p_pring->m_pold, p_pring->m_Nold, p_pring->m_size );
+    p_pring->m_pnew = NULL;
+    p_pring->m_pold = NULL;
+    p_pring->m_post = 0;
+    atomic_store_explicit( &p_pring->m_state, RING_IDLE, memory_order_relaxed );
+    pthread_mutex_unlock( &g_lock );
+    memset( p_pring->m_pdry, 0, sizeof(float)*p_pring->m_Ndry );
+    p_pring->m_dry_index = 0;
+
+    if( p_N > p_pring->m_Nmax )
+        p_N = p_pring->m_Nmax;
+    int l_size = p_compact ? sizeof(short) : sizeof(float);
+    if( p_N > p_pring->m_Nbuf || l_size != p_pring->m_size ){
+        if( p_N < p_pring->m_Nbuf )
+            p_N = p_pring->m_Nbuf;
+        void *l_pdata = Delay_Ring_alloc( p_N, l_size );
+        if( l_pdata ){
+            Delay_Ring_release( Delay_Ring_data( p_pring ), p_pring->m_Nbuf, p_pring->m_size );
+            p_pring->m_size = l_size;
+            Delay_Ring_set_data( p_pring, l_pdata );
+            p_pring->m_Nbuf = p_N;
+            p_pring->m_Nvalid = p_N;
+            p_pring->m_Nclean = p_N;
+            return;
+        }
+    }
+    p_pring->m_Nvalid = 0;
+    p_pring->m_Nclean = p_pring->m_Nbuf;
+}
+
+/*
+ * Called from run() with the p_N samples the controls reach now and
+ * the caller's write index. Takes a buffer the worker has ready, or
+ * asks for one when p_N is more than m_Nbuf, never blocks.
+ */
+void Delay_Ring_grow( Delay_Ring *p_pring, long p_N, long p_write_index )
+{
+    int l_state = atomic_load_explicit( &p_pring->m_state, memory_order_acquire );
+    if( l_state == RING_READY ){
+        // the samples before the write index keep their place, the
+        // ones after it move to the end, in the first lap only those
+        // zeroed since the reset, the new buffer is zero up to them
+        char *l_pnew = p_pring->m_pnew;
+        char *l_pdata = Delay_Ring_data( p_pring );
+        long l_size = p_pring->m_size;
+        long l_Nnew = p_pring->m_Nwant;
+        int l_first = p_pring->m_Nvalid < p_pring->m_Nbuf;
+        long l_tail = l_first ? p_pring->m_Nclean : p_write_index;
+        long l_Ntail = p_pring->m_Nbuf - l_tail;
+        memcpy( l_pnew, l_pdata, l_size*p_write_index );
+        memcpy( l_pnew + l_size*(l_Nnew - l_Ntail), l_pdata + l_size*l_tail,
+                l_size*l_Ntail );
+        p_pring->m_pold = l_pdata;
+        p_pring->m_Nold = p_pring->m_Nbuf;
+        Delay_Ring_set_data( p_pring, l_pnew );
+        p_pring->m_Nbuf = l_Nnew;
+        p_pring->m_Nvalid = l_first ? p_write_index : l_Nnew;
+        p_pring->m_Nclean = l_first ? p_write_index : l_Nnew;
+        p_pring->m_pnew = NULL;
+        atomic_store_explicit( &p_pring->m_state, RING_RETIRE, memory_order_relaxed );
+        Delay_Ring_post( p_pring );
+        return;
+    }
+    if( p_pring->m_post ){
+        Delay_Ring_post( p_pring );
+        return;
+    }
+    if( l_state == RING_IDLE && p_N > p_pring->m_Nbuf &&
+        p_pring->m_Nbuf < p_pring->m_Nmax ){
+        long l_N = p_N + p_N/2;
+        p_pring->m_Nwant = l_N < p_pring->m_Nmax ? l_N : p_pring->m_Nmax;
+        atomic_store_explicit( &p_pring->m_state, RING_WANT, memory_order_relaxed );
+        Delay_Ring_post( p_pring );
+    }
+}
+
+/*
+ * Zeroes the stale samples from p_index up to m_Nclean, for
+ * Delay_Ring_clear.
+ */
+void Delay_Ring_zero( Delay_Ring *p_pring, long p_index )
+{
+    if( p_index < p_pring->m_Nvalid )
+        p_index = p_pring->m_Nvalid;
+    if( p_index >= p_pring->m_Nclean )
+        return;
+    memset( (char *)Delay_Ring_data( p_pring ) + p_pring->m_size*p_index, 0,
+            p_pring->m_size*(p_pring->m_Nclean - p_index) );
+    p_pring->m_Nclean = p_index;
+}
+
+/*
+ * For a writer that puts block n at p_write_index + n and feeds back at
+ * FadNwindow()/2 + 1 samples behind it, as the delays do. The read for
+ * sample n ends at p_write_index + n - 1 + l_delay_int, so with
+ * l_delay_int <= -FadNwindow()/2 - N no read in a block of N samples
+ * sees feedback from the same block, and with l_delay_int >= N +
+ * FadNwindow() - m_Nbuf none reaches round the ring to the block's own
+ * input. Returns the longest such N, at most 0 for delays that have to
+ * run sample by sample.
+ */
+long Delay_Ring_Nblock( const Delay_Ring *p_pring, float p_delay )
+{
+    long l_delay_int = (long)floorf( p_delay );
+    long l_Nblock = -(long)(FadNwindow()/2) - l_delay_int;
+    long l_Nring = p_pring->m_Nbuf - (long)FadNwindow() + l_delay_int;
+    return l_Nblock < l_Nring ? l_Nblock : l_Nring;
+}
+
+/*
+ * Reads p_n samples p_delay (<= 0) samples back from p_write_index,
+ * centred FadNwindow()/2 + 1 samples behind it as FadSample is. A
+ * whole number of samples is a single tap of the sinc, so it is copied
+ * out of the ring, fractions are interpolated, by FadBlock from
+ * DELAY_RING_FADBLOCK_MIN samples on. A compact ring is converted to
+ * float DELAY_RING_CHUNK samples at a time, and the window they read.
+ */
+void Delay_Ring_read( Delay_Ring *p_pring, long p_write_index, float p_delay,
+                      float *p_pdst, long p_n )
+{
+    long l_delay_int = (long)floorf( p_delay );
+    float l_delay_frac = p_delay - l_delay_int;
+    long l_index = p_write_index - FadNwindow() + l_delay_int;
+    if( l_index < 0 ){
+        l_index += p_pring->m_Nbuf;
+        Delay_Ring_clear( p_pring, l_index );
+    }
+
+    if( l_delay_frac == 0.0f ){
+        l_index += FadNwindow()/2 - 1;
+        if( l_index >= p_pring->m_Nbuf )
+            l_index -= p_pring->m_Nbuf;
+        for(long i=0;i<p_n;i++){
+            p_pdst[i] = Delay_Ring_get( p_pring, l_index );
+            if( ++l_index == p_pring->m_Nbuf )
+                l_index = 0;
+        }
+    }else if( p_pring->m_pdata16 ){
+        float l_x[2*DELAY_RING_CHUNK];
+        while( p_n > 0 ){
+            long l_n = p_n < DELAY_RING_CHUNK ? p_n : DELAY_RING_CHUNK;
+            Delay_Ring_unpack( p_pring, l_index, l_x, l_n + FadNwindow() - 1 );
+            if( l_n < DELAY_RING_FADBLOCK_MIN ){
+                for(long i=0;i<l_n;i++)
+                    p_pdst[i] = FadSample( l_x, i, 2*DELAY_RING_CHUNK, l_delay_frac );
+            }else{
+                FadBlock( l_x, 0, 2*DELAY_RING_CHUNK, l_delay_frac, p_pdst, l_n );
+            }
+            l_index += l_n;
+            if( l_index >= p_pring->m_Nbuf )
+                l_index -= p_pring->m_Nbuf;
+            p_pdst += l_n;
+            p_n -= l_n;
+        }
+    }else if( p_n < DELAY_RING_FADBLOCK_MIN ){
+        for(long i=0;i<p_n;i++){
+            p_pdst[i] = FadSample( p_pring->m_pdata, l_index, p_pring->m_Nbuf, l_delay_frac );
+            if( ++l_index == p_pring->m_Nbuf )
+                l_index = 0;
+        }
+    }else{
+        FadBlock( p_pring->m_pdata, l_index, p_pring->m_Nbuf, l_delay_frac, p_pdst, p_n );
+    }
+}
+
+/*
+ * FadSample at p_start in the ring.
+ */
+float Delay_Ring_sample( Delay_Ring *p_pring, long p_start, float p_alpha )
+{
+    if( !p_pring->m_pdata16 )
+        return FadSample( p_pring->m_pdata, p_start, p_pring->m_Nbuf, p_alpha );
+    float l_x[DELAY_RING_CHUNK];
+    Delay_Ring_unpack( p_pring, p_start, l_x, FadNwindow() );
+    return FadSample( l_x, 0, FadNwindow(), p_alpha );
+}
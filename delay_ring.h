@@ -0,0 +1,176 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <stdatomic.h>
+
+/*
+ * Ring buffers for the delay lines, sized to the delay the controls
+ * can reach instead of the port maximum.
+ *
+ * A ring starts at the size asked for at instantiate, TWK_DELAY_MAX
+ * seconds from the environment when set, and grows at activate to
+ * what the controls reach then. When run() needs more, Delay_Ring_grow
+ * asks a worker thread shared by all rings for a larger zeroed buffer
+ * and never blocks: the caller keeps its delay within m_Nbuf until a
+ * later call copies the ring into the new buffer, and the worker frees
+ * the old one. Each step takes half again what was asked for, so a
+ * rising control grows the ring a few times, not on every block.
+ *
+ * The ring holds the last m_Nbuf samples, index m_write_index - k is k
+ * samples back. Growing keeps that, the new samples are zero.
+ *
+ * Activate does not zero the ring. The write index starts at 0 and
+ * indices below m_Nvalid have been written since, the rest is stale
+ * until the first lap ends. A read that wraps into the stale end calls
+ * Delay_Ring_clear first, which zeroes down to it from m_Nclean, so
+ * each stale sample is zeroed once and only when a read gets to it.
+ * Buffers are pre-faulted when allocated, and locked when
+ * TWK_DELAY_MLOCK is set, so run() does not page fault.
+ *
+ * Delay_Ring_read reads a block at one delay with FadBlock, or copies
+ * it for a whole number of samples, and Delay_Ring_Nblock gives how
+ * long that block may be.
+ *
+ * A compact ring, chosen at reset, stores 16 bit samples in m_pdata16
+ * instead of floats in m_pdata, half the memory and cache for the long
+ * delays. Writes are dithered, with triangular noise of one step each
+ * way, and clipped to +-1. Reads convert the FadNwindow() samples they
+ * need to float and interpolate those, so the noise floor is about
+ * -90 dB below full scale, and a delay fed back adds it again on each
+ * pass. The users go through Delay_Ring_get, Delay_Ring_put and
+ * Delay_Ring_sample, which take either. The dry signal comes from
+ * Delay_Ring_dry, a float copy of the input, so it is never quantized.
+ */
+
+#define DELAY_RING_FADBLOCK_MIN 16
+#define DELAY_RING_CHUNK 256
+#define DELAY_RING_SCALE 32767.0f
+
+typedef struct Delay_Ring Delay_Ring;
+
+struct Delay_Ring {
+    // audio thread
+    float      *m_pdata;        // NULL when compact
+    short      *m_pdata16;      // NULL when not
+    long        m_Nbuf;
+    long        m_Nmax;
+    long        m_Nvalid;       // written since reset, m_Nbuf after a lap
+    long        m_Nclean;       // m_Nclean..m_Nbuf-1 zeroed since reset
+    int         m_post;         // a post to the worker is pending
+    unsigned    m_dither;       // noise for the compact writes
+    int         m_size;         // bytes a sample, set at init and reset
+    float      *m_pdry;         // the last m_Ndry inputs, for Delay_Ring_dry
+    long        m_Ndry;
+    long        m_dry_index;
+
+    // shared, under the worker's lock
+    atomic_int  m_state;
+    long        m_Nwant;
+    void       *m_pnew;
+    void       *m_pold;
+    long        m_Nold;
+    int         m_queued;
+    Delay_Ring *m_pnext;
+};
+
+double Delay_Ring_hint( void );
+int Delay_Ring_init( Delay_Ring *p_pring, long p_N, long p_Nmax );
+void Delay_Ring_free( Delay_Ring *p_pring );
+void Delay_Ring_reset( Delay_Ring *p_pring, long p_N, int p_compact );
+void Delay_Ring_grow( Delay_Ring *p_pring, long p_N, long p_write_index );
+void Delay_Ring_zero( Delay_Ring *p_pring, long p_index );
+long Delay_Ring_Nblock( const Delay_Ring *p_pring, float p_delay );
+void Delay_Ring_read( Delay_Ring *p_pring, long p_write_index, float p_delay,
+                      float *p_pdst, long p_n );
+float Delay_Ring_sample( Delay_Ring *p_pring, long p_start, float p_alpha );
+
+/*
+ * The sample at p_index.
+ */
+static inline float Delay_Ring_get( const Delay_Ring *p_pring, long p_index )
+{
+    if( p_pring->m_pdata16 )
+        return p_pring->m_pdata16[p_index]*(1.0f/DELAY_RING_SCALE);
+    return p_pring->m_pdata[p_index];
+}
+
+/*
+ * Stores p_x at p_index, dithered to 16 bits in a compact ring. The
+ * noise is the difference of two draws of a linear congruential
+ * generator, their top 16 bits, one step wide each way.
+ */
+static inline void Delay_Ring_put( Delay_Ring *p_pring, long p_index, float p_x )
+{
+    if( !p_pring->m_pdata16 ){
+        p_pring->m_pdata[p_index] = p_x;
+        return;
+    }
+    unsigned l_a = p_pring->m_dither*1664525u + 1013904223u;
+    unsigned l_b = l_a*1664525u + 1013904223u;
+    p_pring->m_dither = l_b;
+    float l_q = p_x*DELAY_RING_SCALE +
+                ((int)(l_a >> 16) - (int)(l_b >> 16))*(1.0f/65536.0f);
+    if( l_q > DELAY_RING_SCALE ) l_q = DELAY_RING_SCALE;
+    if( l_q <-DELAY_RING_SCALE ) l_q =-DELAY_RING_SCALE;
+    // truncating a positive value rounds down
+    p_pring->m_pdata16[p_index] = (short)((int)(l_q + 32768.5f) - 32768);
+}
+
+/*
+ * Takes the input sample p_x and returns the one FadNwindow()/2 + 1
+ * samples before it, the dry sample at the index the delays feed back
+ * to. It is what the ring held there before the feedback in a float
+ * ring, and the unquantized input in a compact one.
+ */
+static inline float Delay_Ring_dry( Delay_Ring *p_pring, float p_x )
+{
+    float l_dry = p_pring->m_pdry[p_pring->m_dry_index];
+    p_pring->m_pdry[p_pring->m_dry_index] = p_x;
+    if( ++p_pring->m_dry_index == p_pring->m_Ndry )
+        p_pring->m_dry_index = 0;
+    return l_dry;
+}
+
+/*
+ * p_n samples were written at the write index.
+ */
+static inline void Delay_Ring_wrote( Delay_Ring *p_pring, long p_n )
+{
+    if( p_pring->m_Nvalid < p_pring->m_Nbuf ){
+        p_pring->m_Nvalid += p_n;
+        if( p_pring->m_Nvalid > p_pring->m_Nbuf )
+            p_pring->m_Nvalid = p_pring->m_Nbuf;
+    }
+}
+
+/*
+ * A read is about to wrap to p_index and use the samples from there to
+ * the end of the ring.
+ */
+static inline void Delay_Ring_clear( Delay_Ring *p_pring, long p_index )
+{
+    if( p_index < p_pring->m_Nclean && p_pring->m_Nvalid < p_pring->m_Nbuf )
+        Delay_Ring_zero( p_pring, p_index );
+}
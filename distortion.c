@@ -27,6 +27,7 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "fast_math.h"
 
 enum {
 	PORT_IN,
@@ -124,7 +125,7 @@ static void Distortion_run(
 			l_data_in = *l_psrc++;
 		}
 
-		*l_pdst++ = powf(l_pre_gain*l_data_in,1.0f/l_waveshape)*l_post_gain*l_sign;
+		*l_pdst++ = FM_powf(l_pre_gain*l_data_in,1.0f/l_waveshape)*l_post_gain*l_sign;
 	}
 }
 
@@ -0,0 +1,504 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <fad.h>
+#include "dynamics.h"
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include "fast_math.h"
+
+// log2(10)/20, dB to log2 units
+#define DB_TO_LOG2 0.166096405f
+#define PEEK2_K 0.5f
+
+void Dyn_Curve_init(
+    Dyn_Curve   *p_pcurve,
+    LADSPA_Data  p_unity,
+    LADSPA_Data  p_ratio_hi,
+    LADSPA_Data  p_ratio_lo,
+    LADSPA_Data  p_threshold )
+{
+    LADSPA_Data l_unity = p_unity*DB_TO_LOG2;
+    LADSPA_Data l_threshold = p_threshold*DB_TO_LOG2;
+    p_pcurve->m_threshold = l_threshold;
+    p_pcurve->m_a_lo = l_unity + (l_threshold - l_unity)/p_ratio_hi - l_threshold/p_ratio_lo;
+    p_pcurve->m_b_lo = 1.0f/p_ratio_lo - 1.0f;
+    p_pcurve->m_a_hi = l_unity - l_unity/p_ratio_hi;
+    p_pcurve->m_b_hi = 1.0f/p_ratio_hi - 1.0f;
+}
+
+/*
+ * Linear gain for envelope p_env. The envelope is held at DYN_ABS_MIN
+ * so the gain stays continuous for the ramps, Dyn_gain mutes the
+ * samples below it. Selects only, Dyn_Curve_gain_v vectorizes.
+ */
+static inline LADSPA_Data Dyn_curve( const Dyn_Curve *p_pcurve, LADSPA_Data p_env )
+{
+    LADSPA_Data l_env = FM_log2f(p_env<DYN_ABS_MIN ? DYN_ABS_MIN : p_env);
+    LADSPA_Data l_gain_lo = p_pcurve->m_a_lo + p_pcurve->m_b_lo*l_env;
+    LADSPA_Data l_gain_hi = p_pcurve->m_a_hi + p_pcurve->m_b_hi*l_env;
+    return FM_exp2f(l_env<=p_pcurve->m_threshold ? l_gain_lo : l_gain_hi);
+}
+
+LADSPA_Data Dyn_Curve_gain( const Dyn_Curve *p_pcurve, LADSPA_Data p_env )
+{
+    return Dyn_curve(p_pcurve, p_env);
+}
+
+/*
+ * Dyn_Curve_gain for the p_n envelopes at p_penv.
+ */
+static void Dyn_Curve_gain_v( const Dyn_Curve *p_pcurve, const LADSPA_Data *p_penv,
+                              LADSPA_Data *p_pgain, unsigned long p_n )
+{
+    for(unsigned long i=0;i<p_n;i++)
+        p_pgain[i] = Dyn_curve(p_pcurve, p_penv[i]);
+}
+
+/*
+ * Per sample decay for an envelope falling to 5% in p_decay seconds.
+ */
+LADSPA_Data Dyn_decay_alpha( LADSPA_Data p_decay, LADSPA_Data p_sample_rate )
+{
+    return 1.0 - powf(0.05,1.0 / p_decay / p_sample_rate);
+}
+
+/*
+ * Per sample attack for an envelope rising 95% of the way to a peak in
+ * p_attack seconds, 1 follows the peak at once.
+ */
+LADSPA_Data Dyn_attack_alpha( LADSPA_Data p_attack, LADSPA_Data p_sample_rate )
+{
+    if(p_attack*p_sample_rate <= 1.0f)
+        return 1.0f;
+    return Dyn_decay_alpha(p_attack, p_sample_rate);
+}
+
+void Dyn_State_init( Dyn_State *p_pds )
+{
+    p_pds->m_env = 0.0f;
+    p_pds->m_gain = 0.0f;
+    for(int c=0;c<DYN_CHANNELS_MAX;c++)
+        p_pds->m_x1[c] = 0.0f;
+
+    p_pds->m_true_peak = 0;
+    for(int c=0;c<DYN_CHANNELS_MAX;c++){
+        for(int k=0;k<DYN_TP_TAPS-1+DYN_GAIN_INTERVAL;k++)
+            p_pds->m_tp_hist[c][k] = 0.0f;
+    }
+    int l_k0 = (int)FadNwindow()/2 - DYN_TP_TAPS/2;
+    for(int p=0;p<DYN_TP_PHASES;p++){
+        const float *l_psinc = FadSinc((float)p/DYN_TP_PHASES);
+        for(int k=0;k<DYN_TP_TAPS;k++)
+            p_pds->m_tp_coeffs[p][k] = l_psinc[l_k0 + k];
+    }
+}
+
+/*
+ * Raises p_ppeak[i] to the largest of |x| and the 4x oversampled points
+ * DYN_TP_TAPS/2 samples back, for the p_nsamples of channel p_c. The
+ * whole block is filtered at once, one vector of outputs per tap.
+ */
+static void Dyn_true_peak(
+    Dyn_State         *p_pds,
+    int                p_c,
+    const LADSPA_Data *p_psrc,
+    LADSPA_Data       *p_ppeak,
+    unsigned long      p_nsamples )
+{
+    LADSPA_Data *l_phist = p_pds->m_tp_hist[p_c];
+    LADSPA_Data *l_pnew = l_phist + DYN_TP_TAPS - 1;
+    for(unsigned long i=0;i<p_nsamples;i++)
+        l_pnew[i] = p_psrc[i];
+
+    // a full DYN_GAIN_INTERVAL every time, the fixed count vectorizes
+    // across the samples without a tail, points past p_nsamples are
+    // ignored
+    for(int p=0;p<DYN_TP_PHASES;p++){
+        const LADSPA_Data *l_pcoeffs = p_pds->m_tp_coeffs[p];
+        for(int i=0;i<DYN_GAIN_INTERVAL;i++){
+            // two sums, one chain of DYN_TP_TAPS adds is latency bound
+            LADSPA_Data l_acc0 = 0.0f;
+            LADSPA_Data l_acc1 = 0.0f;
+            for(int k=0;k<DYN_TP_TAPS;k+=2){
+                l_acc0 += l_phist[i+k]*l_pcoeffs[k];
+                l_acc1 += l_phist[i+k+1]*l_pcoeffs[k+1];
+            }
+            LADSPA_Data l_a = fabsf(l_acc0 + l_acc1);
+            p_ppeak[i] = l_a > p_ppeak[i] ? l_a : p_ppeak[i];
+        }
+    }
+    for(unsigned long i=0;i<p_nsamples;i++){
+        LADSPA_Data l_a = fabsf(p_psrc[i]);
+        p_ppeak[i] = l_a > p_ppeak[i] ? l_a : p_ppeak[i];
+    }
+    // keep the last DYN_TP_TAPS - 1 samples for the next block
+    for(int k=0;k<DYN_TP_TAPS-1;k++)
+        l_phist[k] = l_phist[k + p_nsamples];
+}
+
+/*
+ * Allocates the ring for DYN_LOOKAHEAD_MAX_MS at p_sample_rate, the
+ * delay for all DYN_CHANNELS_MAX channels and the deque share its
+ * size. Returns 0 if out of memory.
+ */
+int Dyn_Lookahead_init( Dyn_Lookahead *p_pla, LADSPA_Data p_sample_rate )
+{
+    unsigned long l_length_max = (unsigned long)(DYN_LOOKAHEAD_MAX_MS*0.001f*p_sample_rate);
+    unsigned long l_size = 1;
+    while(l_size < l_length_max + 1)
+        l_size <<= 1;
+    p_pla->m_mask = l_size - 1;
+    p_pla->m_pindex = malloc(l_size*sizeof(unsigned long));
+    p_pla->m_pvalue = malloc(l_size*sizeof(LADSPA_Data));
+    p_pla->m_pdelay = malloc(l_size*DYN_CHANNELS_MAX*sizeof(LADSPA_Data));
+    if(!p_pla->m_pindex || !p_pla->m_pvalue || !p_pla->m_pdelay){
+        Dyn_Lookahead_free(p_pla);
+        return 0;
+    }
+    Dyn_Lookahead_reset(p_pla, 0);
+    return 1;
+}
+
+void Dyn_Lookahead_free( Dyn_Lookahead *p_pla )
+{
+    free(p_pla->m_pindex);
+    free(p_pla->m_pvalue);
+    free(p_pla->m_pdelay);
+    p_pla->m_pindex = NULL;
+    p_pla->m_pvalue = NULL;
+    p_pla->m_pdelay = NULL;
+}
+
+/*
+ * Empties the deque and the delay and sets the lookahead to p_length
+ * samples.
+ */
+void Dyn_Lookahead_reset( Dyn_Lookahead *p_pla, unsigned long p_length )
+{
+    p_pla->m_length = p_length;
+    p_pla->m_n = 0;
+    p_pla->m_head = 0;
+    p_pla->m_tail = 0;
+    unsigned long l_size = p_pla->m_mask + 1;
+    for(unsigned long i=0;i<l_size*DYN_CHANNELS_MAX;i++)
+        p_pla->m_pdelay[i] = 0.0f;
+}
+
+/*
+ * Lookahead in samples for p_ms milliseconds, limited to the ring.
+ */
+unsigned long Dyn_Lookahead_length(
+    const Dyn_Lookahead *p_pla,
+    LADSPA_Data          p_ms,
+    LADSPA_Data          p_sample_rate )
+{
+    LADSPA_Data l_length = p_ms*0.001f*p_sample_rate + 0.5f;
+    if(!(l_length > 0.0f))
+        return 0;
+    if(l_length > p_pla->m_mask)
+        return p_pla->m_mask;
+    return (unsigned long)l_length;
+}
+
+/*
+ * Pushes p_peek and returns the maximum over the last m_length + 1
+ * pushes. The deque holds a decreasing run of values, anything at or
+ * below a newer value can never be the maximum again.
+ */
+static LADSPA_Data Dyn_Lookahead_max( Dyn_Lookahead *p_pla, LADSPA_Data p_peek )
+{
+    unsigned long l_mask = p_pla->m_mask;
+    unsigned long l_n = p_pla->m_n++;
+    // expire first, so the deque never holds more than m_length + 1
+    if(p_pla->m_tail != p_pla->m_head &&
+       p_pla->m_pindex[p_pla->m_head&l_mask] + p_pla->m_length < l_n)
+        p_pla->m_head++;
+    while(p_pla->m_tail != p_pla->m_head &&
+          p_pla->m_pvalue[(p_pla->m_tail-1)&l_mask] <= p_peek)
+        p_pla->m_tail--;
+    p_pla->m_pvalue[p_pla->m_tail&l_mask] = p_peek;
+    p_pla->m_pindex[p_pla->m_tail&l_mask] = l_n;
+    p_pla->m_tail++;
+    return p_pla->m_pvalue[p_pla->m_head&l_mask];
+}
+
+/*
+ * Writes channels p_first .. p_first + p_nchannels - 1 into the delay
+ * and the delayed inputs times p_pgain to the outputs, after Dyn_gain
+ * for the same samples.
+ */
+void Dyn_Lookahead_delay(
+    Dyn_Lookahead      *p_pla,
+    LADSPA_Data *const *p_ppsrc,
+    LADSPA_Data *const *p_ppdst,
+    const LADSPA_Data  *p_pgain,
+    int                 p_first,
+    int                 p_nchannels,
+    unsigned long       p_offset,
+    unsigned long       p_nsamples )
+{
+    unsigned long l_mask = p_pla->m_mask;
+    // m_n has already moved past these samples in Dyn_gain
+    unsigned long l_n0 = p_pla->m_n - p_nsamples;
+    for(int c=p_first;c<p_first+p_nchannels;c++){
+        LADSPA_Data *l_pdelay = p_pla->m_pdelay + c*(l_mask + 1);
+        LADSPA_Data *l_psrc = p_ppsrc[c] + p_offset;
+        LADSPA_Data *l_pdst = p_ppdst[c] + p_offset;
+        for(unsigned long i=0;i<p_nsamples;i++){
+            unsigned long l_n = l_n0 + i;
+            l_pdelay[l_n&l_mask] = l_psrc[i];
+            l_pdst[i] = l_pdelay[(l_n - p_pla->m_length)&l_mask]*p_pgain[i];
+        }
+    }
+}
+
+/*
+ * One envelope step, env + delta*alpha with alpha the attack for a
+ * rising delta and the decay for a falling one, as
+ *
+ *   env + delta*(attack + decay)/2 + |delta|*(attack - decay)/2
+ *
+ * No compare at all, a noisy input rises and falls at random and a
+ * branch would mispredict, and the lanes of Dyn_gain_lanes vectorize.
+ * Attack 1 lands on the peak, within rounding. p_ksum and p_kdiff are
+ * the halved sum and difference from Dyn_envelope_k.
+ */
+static inline LADSPA_Data Dyn_envelope( LADSPA_Data p_env, LADSPA_Data p_peek,
+                                        LADSPA_Data p_ksum, LADSPA_Data p_kdiff )
+{
+    LADSPA_Data l_delta = p_peek - p_env;
+    return p_env + (l_delta*p_ksum + fabsf(l_delta)*p_kdiff);
+}
+
+static void Dyn_envelope_k( LADSPA_Data p_alpha_attack, LADSPA_Data p_alpha_decay,
+                            LADSPA_Data *p_pksum, LADSPA_Data *p_pkdiff )
+{
+    *p_pksum = 0.5f*(p_alpha_attack + p_alpha_decay);
+    *p_pkdiff = 0.5f*(p_alpha_attack - p_alpha_decay);
+}
+
+/*
+ * Samples where the curve is evaluated, ascending, into p_pbreak: the
+ * last one and, for p_attacks, each rise of p_penv and the sample
+ * before it. p_env0 is the envelope before the block. Compacted by
+ * always storing and advancing by the flag.
+ */
+static unsigned long Dyn_breakpoints(
+    const LADSPA_Data *p_penv,
+    LADSPA_Data        p_env0,
+    int                p_attacks,
+    unsigned long     *p_pbreak,
+    unsigned long      p_nsamples )
+{
+    int l_rise[DYN_GAIN_INTERVAL+1];
+    l_rise[0] = p_attacks & (p_penv[0] > p_env0);
+    for(unsigned long i=1;i<p_nsamples;i++)
+        l_rise[i] = p_attacks & (p_penv[i] > p_penv[i-1]);
+    l_rise[p_nsamples] = 1;
+    unsigned long l_nbreak = 0;
+    for(unsigned long i=0;i<p_nsamples;i++){
+        p_pbreak[l_nbreak] = i;
+        l_nbreak += l_rise[i] | l_rise[i+1];
+    }
+    return l_nbreak;
+}
+
+/*
+ * Ramps p_pgain from p_gain0, the gain before the block, to p_pbgain[b]
+ * at each breakpoint and returns the gain at the last.
+ */
+static LADSPA_Data Dyn_ramp(
+    const LADSPA_Data   *p_penv,
+    const unsigned long *p_pbreak,
+    const LADSPA_Data   *p_pbgain,
+    unsigned long        p_nbreak,
+    LADSPA_Data          p_gain0,
+    LADSPA_Data         *p_pgain )
+{
+    // ramp from the gain at sample l_i0 - 1 to the gain at l_i1, int
+    // counts convert to float in one instruction
+    LADSPA_Data l_gain0 = p_gain0;
+    int l_i0 = 0;
+    for(unsigned long b=0;b<p_nbreak;b++){
+        int l_i1 = (int)p_pbreak[b];
+        LADSPA_Data l_gain1 = p_pbgain[b];
+        LADSPA_Data l_dgain = (l_gain1 - l_gain0)/(l_i1 - l_i0 + 1);
+        for(int i=l_i0;i<=l_i1;i++){
+            LADSPA_Data l_gain = l_gain0 + l_dgain*(i - l_i0 + 1);
+            p_pgain[i] = p_penv[i]<DYN_ABS_MIN ? 0.0f : l_gain;
+        }
+        l_gain0 = l_gain1;
+        l_i0 = l_i1 + 1;
+    }
+    return l_gain0;
+}
+
+/*
+ * Gains for p_nsamples <= DYN_GAIN_INTERVAL samples starting at
+ * p_offset, detected over p_nchannels inputs, through p_pla if it is
+ * not NULL.
+ */
+void Dyn_gain(
+    Dyn_State         *p_pds,
+    const Dyn_Curve   *p_pcurve,
+    LADSPA_Data        p_alpha_attack,
+    LADSPA_Data        p_alpha_decay,
+    Dyn_Lookahead     *p_pla,
+    LADSPA_Data *const*p_ppsrc,
+    int                p_nchannels,
+    unsigned long      p_offset,
+    LADSPA_Data       *p_pgain,
+    unsigned long      p_nsamples )
+{
+    LADSPA_Data l_env[DYN_GAIN_INTERVAL];
+    unsigned long l_break[DYN_GAIN_INTERVAL];
+    LADSPA_Data l_env0 = p_pds->m_env;
+    // with enough lookahead the envelope holds a peak until it is
+    // played, so the attacks ramp over the block too, as do attacks
+    // spread over several samples
+    int l_attacks = !(p_pla && p_pla->m_length + 1 >= DYN_GAIN_INTERVAL) &&
+                    p_alpha_attack >= 1.0f;
+
+    LADSPA_Data l_ksum, l_kdiff;
+    Dyn_envelope_k(p_alpha_attack, p_alpha_decay, &l_ksum, &l_kdiff);
+
+    LADSPA_Data l_tp[DYN_GAIN_INTERVAL];
+    if(p_pds->m_true_peak){
+        for(int i=0;i<DYN_GAIN_INTERVAL;i++)
+            l_tp[i] = 0.0f;
+        for(int c=0;c<p_nchannels;c++)
+            Dyn_true_peak(p_pds, c, p_ppsrc[c] + p_offset, l_tp, p_nsamples);
+    }
+
+    for(unsigned long i=0;i<p_nsamples;i++){
+        LADSPA_Data l_peek = 0.0f;
+        if(p_pds->m_true_peak){
+            l_peek = l_tp[i];
+        }else{
+            for(int c=0;c<p_nchannels;c++){
+                LADSPA_Data l_x = p_ppsrc[c][p_offset+i];
+                LADSPA_Data l_peek1 = fabsf(l_x);
+                LADSPA_Data l_peek2 = fabsf((l_x + p_pds->m_x1[c])*PEEK2_K);
+                p_pds->m_x1[c] = l_x;
+                l_peek = l_peek1 > l_peek ? l_peek1 : l_peek;
+                l_peek = l_peek2 > l_peek ? l_peek2 : l_peek;
+            }
+        }
+        if(p_pla)
+            l_peek = Dyn_Lookahead_max(p_pla, l_peek);
+        p_pds->m_env = Dyn_envelope(p_pds->m_env, l_peek, l_ksum, l_kdiff);
+        l_env[i] = p_pds->m_env;
+    }
+    unsigned long l_nbreak = Dyn_breakpoints(l_env, l_env0, l_attacks,
+                                             l_break, p_nsamples);
+    LADSPA_Data l_benv[DYN_GAIN_INTERVAL];
+    LADSPA_Data l_bgain[DYN_GAIN_INTERVAL];
+    for(unsigned long b=0;b<l_nbreak;b++)
+        l_benv[b] = l_env[l_break[b]];
+    Dyn_Curve_gain_v(p_pcurve, l_benv, l_bgain, l_nbreak);
+    p_pds->m_gain = Dyn_ramp(l_env, l_break, l_bgain, l_nbreak,
+                             p_pds->m_gain, p_pgain);
+}
+
+/*
+ * Gains for p_nlanes <= DYN_LANES channels compressed independently,
+ * one Dyn_State each in p_pds, into p_ppgain[c]. Each lane gets what
+ * Dyn_gain gives for that channel alone, without lookahead or true
+ * peak. The detector and the envelopes of all the lanes step as one
+ * vector.
+ */
+void Dyn_gain_lanes(
+    Dyn_State         *p_pds,
+    const Dyn_Curve   *p_pcurve,
+    LADSPA_Data        p_alpha_attack,
+    LADSPA_Data        p_alpha_decay,
+    LADSPA_Data *const*p_ppsrc,
+    int                p_nlanes,
+    unsigned long      p_offset,
+    LADSPA_Data *const*p_ppgain,
+    unsigned long      p_nsamples )
+{
+    // row 0 is the sample before the block
+    LADSPA_Data l_x[DYN_GAIN_INTERVAL+1][DYN_LANES];
+    LADSPA_Data l_peek[DYN_GAIN_INTERVAL][DYN_LANES];
+    LADSPA_Data l_env[DYN_GAIN_INTERVAL][DYN_LANES];
+    LADSPA_Data l_env1[DYN_LANES];
+    LADSPA_Data l_ksum, l_kdiff;
+    Dyn_envelope_k(p_alpha_attack, p_alpha_decay, &l_ksum, &l_kdiff);
+    for(int c=0;c<DYN_LANES;c++){
+        // the unused lanes repeat lane 0 and are dropped
+        int l_c = c < p_nlanes ? c : 0;
+        l_x[0][c] = p_pds[l_c].m_x1[0];
+        l_env1[c] = p_pds[l_c].m_env;
+        for(unsigned long i=0;i<p_nsamples;i++)
+            l_x[i+1][c] = p_ppsrc[l_c][p_offset+i];
+    }
+
+    // the detector does not depend on the envelope, it is vectorized
+    // over the whole block and only the envelope steps per sample
+    for(unsigned long i=0;i<p_nsamples;i++){
+        for(int c=0;c<DYN_LANES;c++){
+            LADSPA_Data l_peek1 = fabsf(l_x[i+1][c]);
+            LADSPA_Data l_peek2 = fabsf((l_x[i+1][c] + l_x[i][c])*PEEK2_K);
+            l_peek[i][c] = l_peek2 > l_peek1 ? l_peek2 : l_peek1;
+        }
+    }
+    for(unsigned long i=0;i<p_nsamples;i++){
+        for(int c=0;c<DYN_LANES;c++){
+            l_env1[c] = Dyn_envelope(l_env1[c], l_peek[i][c], l_ksum, l_kdiff);
+            l_env[i][c] = l_env1[c];
+        }
+    }
+
+    // the curve for the breakpoints of all the lanes in one loop, on
+    // noise every attack is one
+    int l_attacks = p_alpha_attack >= 1.0f;
+    LADSPA_Data l_envc[DYN_LANES][DYN_GAIN_INTERVAL];
+    unsigned long l_break[DYN_LANES][DYN_GAIN_INTERVAL];
+    unsigned long l_nbreak[DYN_LANES];
+    LADSPA_Data l_benv[DYN_LANES*DYN_GAIN_INTERVAL];
+    LADSPA_Data l_bgain[DYN_LANES*DYN_GAIN_INTERVAL];
+    unsigned long l_nb = 0;
+    for(int c=0;c<p_nlanes;c++){
+        for(unsigned long i=0;i<p_nsamples;i++)
+            l_envc[c][i] = l_env[i][c];
+        l_nbreak[c] = Dyn_breakpoints(l_envc[c], p_pds[c].m_env, l_attacks,
+                                      l_break[c], p_nsamples);
+        for(unsigned long b=0;b<l_nbreak[c];b++)
+            l_benv[l_nb++] = l_envc[c][l_break[c][b]];
+    }
+    Dyn_Curve_gain_v(p_pcurve, l_benv, l_bgain, l_nb);
+
+    l_nb = 0;
+    for(int c=0;c<p_nlanes;c++){
+        p_pds[c].m_gain = Dyn_ramp(l_envc[c], l_break[c], l_bgain + l_nb,
+                                   l_nbreak[c], p_pds[c].m_gain, p_ppgain[c]);
+        l_nb += l_nbreak[c];
+        p_pds[c].m_x1[0] = l_x[p_nsamples][c];
+        p_pds[c].m_env = l_env1[c];
+    }
+}
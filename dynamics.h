@@ -0,0 +1,145 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+
+/*
+ * Envelope follower and gain computer shared by the compressors.
+ *
+ * The detector takes the larger of |x| and |(x[n] + x[n-1])/2| over
+ * all its input channels, so linked channels and sidechains share one
+ * envelope. The envelope follows a rising peak at once, or by the
+ * attack alpha per sample, and decays by alpha per sample. A step is
+ * env + delta*(a + d)/2 + |delta|*(a - d)/2 with no compare, so noise
+ * that rises and falls at random costs no mispredicted branches.
+ * Dyn_gain_lanes runs up to DYN_LANES unlinked channels as the lanes
+ * of one vector, a stereo pair costs about what one channel does.
+ *
+ * The static curve is kept in log2 units, gain = a + b*log2(env) on
+ * either side of the threshold. It is evaluated every DYN_GAIN_INTERVAL
+ * samples and the linear gain is ramped in between, 1 gives the per
+ * sample curve.
+ *
+ * A rising peak moves the envelope in one step, so the curve is also
+ * evaluated on each attack and on the sample before it, and the ramps
+ * only span decay. An attack over several samples ramps like the
+ * decay, with its own alpha in the bound below. There each sample
+ * moves log2(env) by between log2(1 - alpha) and 0, alpha ~
+ * 3/(decay*fs), and the ramp is within
+ * K*|1/ratio - 1|*alpha/4 of the per sample gain, relative,
+ * K = DYN_GAIN_INTERVAL. For ratio 4 and a 0.1 s decay at 48 kHz that
+ * is 1.9e-3 (0.016 dB) for K = 16.
+ *
+ * Lookahead delays the audio by L samples and feeds the detector the
+ * maximum over the last L + 1 samples, from a monotonic deque, so the
+ * envelope reaches a peak L samples before the peak is played and
+ * holds it until then. For L >= K - 1 the attacks are not evaluated
+ * separately, the gain ramps down over the block ahead of the peak and
+ * the output does not overshoot the curve. Each sample is pushed and
+ * popped at most once, O(1) amortized whatever L.
+ *
+ * True peak detection replaces the two sample average with the 4x
+ * oversampled signal. The phases 0, 1/4, 1/2 and 3/4 of the libfad
+ * windowed sinc, their central DYN_TP_TAPS taps, filter each block of
+ * K samples a vector of outputs at a time.
+ * Between 0.02 and 0.42 fs a sine reads from -0.41 dB, the 4x grid,
+ * to +0.58 dB. The points trail the input by DYN_TP_TAPS/2 samples, a
+ * lookahead of at least that catches inter sample peaks before they
+ * are played.
+ */
+
+#ifndef DYN_GAIN_INTERVAL
+#define DYN_GAIN_INTERVAL 16
+#endif
+
+#define DYN_CHANNELS_MAX 8
+#define DYN_LANES 4
+#define DYN_ABS_MIN 1.19209290e-7f
+#define DYN_LOOKAHEAD_MAX_MS 20.0f
+#define DYN_TP_TAPS 16
+#define DYN_TP_PHASES 4
+
+typedef struct {
+    LADSPA_Data m_threshold;
+    LADSPA_Data m_a_lo;
+    LADSPA_Data m_b_lo;
+    LADSPA_Data m_a_hi;
+    LADSPA_Data m_b_hi;
+} Dyn_Curve;
+
+typedef struct {
+    LADSPA_Data  m_env;
+    LADSPA_Data  m_gain;
+    LADSPA_Data  m_x1[DYN_CHANNELS_MAX];
+    int          m_true_peak;
+    LADSPA_Data  m_tp_hist[DYN_CHANNELS_MAX][DYN_TP_TAPS-1+DYN_GAIN_INTERVAL];
+    LADSPA_Data  m_tp_coeffs[DYN_TP_PHASES][DYN_TP_TAPS];
+} Dyn_State;
+
+typedef struct {
+    unsigned long  m_mask;
+    unsigned long  m_length;
+    unsigned long  m_n;
+    unsigned long  m_head;
+    unsigned long  m_tail;
+    unsigned long *m_pindex;
+    LADSPA_Data   *m_pvalue;
+    LADSPA_Data   *m_pdelay;
+} Dyn_Lookahead;
+
+void        Dyn_Curve_init( Dyn_Curve *p_pcurve, LADSPA_Data p_unity,
+                            LADSPA_Data p_ratio_hi, LADSPA_Data p_ratio_lo,
+                            LADSPA_Data p_threshold );
+LADSPA_Data Dyn_Curve_gain( const Dyn_Curve *p_pcurve, LADSPA_Data p_env );
+LADSPA_Data Dyn_decay_alpha( LADSPA_Data p_decay, LADSPA_Data p_sample_rate );
+LADSPA_Data Dyn_attack_alpha( LADSPA_Data p_attack, LADSPA_Data p_sample_rate );
+void        Dyn_State_init( Dyn_State *p_pds );
+void        Dyn_gain( Dyn_State *p_pds, const Dyn_Curve *p_pcurve,
+                      LADSPA_Data p_alpha_attack, LADSPA_Data p_alpha_decay,
+                      Dyn_Lookahead *p_pla,
+                      LADSPA_Data * const *p_ppsrc, int p_nchannels,
+                      unsigned long p_offset, LADSPA_Data *p_pgain,
+                      unsigned long p_nsamples );
+void        Dyn_gain_lanes( Dyn_State *p_pds, const Dyn_Curve *p_pcurve,
+                            LADSPA_Data p_alpha_attack,
+                            LADSPA_Data p_alpha_decay,
+                            LADSPA_Data * const *p_ppsrc, int p_nlanes,
+                            unsigned long p_offset,
+                            LADSPA_Data * const *p_ppgain,
+                            unsigned long p_nsamples );
+int         Dyn_Lookahead_init( Dyn_Lookahead *p_pla,
+                                LADSPA_Data p_sample_rate );
+void        Dyn_Lookahead_free( Dyn_Lookahead *p_pla );
+void        Dyn_Lookahead_reset( Dyn_Lookahead *p_pla,
+                                 unsigned long p_length );
+unsigned long Dyn_Lookahead_length( const Dyn_Lookahead *p_pla,
+                                    LADSPA_Data p_ms,
+                                    LADSPA_Data p_sample_rate );
+void        Dyn_Lookahead_delay( Dyn_Lookahead *p_pla,
+                                 LADSPA_Data * const *p_ppsrc,
+                                 LADSPA_Data * const *p_ppdst,
+                                 const LADSPA_Data *p_pgain, int p_first,
+                                 int p_nchannels, unsigned long p_offset,
+                                 unsigned long p_nsamples );
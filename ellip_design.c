@@ -0,0 +1,195 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "ellip_design.h"
+#include "bw_cache.h"
+#define _GNU_SOURCE
+#include <math.h>
+#include <complex.h>
+
+/*
+ * Design follows S. J. Orfanidis, "Lecture Notes on Elliptic Filter
+ * Design". All elliptic functions are evaluated with the normalized
+ * argument u, w = sn(u*K, k) and w = cd(u*K, k), through descending
+ * Landen transformations of the modulus
+ *
+ *   k[n] = (k[n-1]/(1 + sqrt(1 - k[n-1]^2)))^2
+ *
+ * starting from sin(u*pi/2) and cos(u*pi/2) and ascending back with
+ *
+ *   w = (1 + k[n])*w/(1 + k[n]*w^2)
+ *
+ * For order N = 2*L, ripple Rp and attenuation As
+ *
+ *   ep = sqrt(10^(Rp/10) - 1), es = sqrt(10^(As/10) - 1)
+ *   k1 = ep/es, k1' = sqrt(1 - k1^2)
+ *   u[i] = (2*i - 1)/N, i = 1..L
+ *   k' = k1'^N * prod sn(u[i]*K', k1')^4    (degree equation)
+ *   v0 = -j*asn(j/ep, k1)/N
+ *
+ *   zero[i] = j/(k*cd(u[i]*K, k))
+ *   pole[i] = j*cd((u[i] - j*v0)*K, k)
+ *
+ *   cnum0 = |zero|^2, cden0 = |pole|^2, cden1 = -2*real(pole)
+ *   gain = prod(cden0/cnum0)/sqrt(1 + ep^2)
+ */
+
+#define LANDEN_MAX 10
+
+static int landen( double k, double kp, double *v )
+{
+    int l_M = 0;
+    while( k > 1.0e-16 && l_M < LANDEN_MAX ){
+        k = k/(1.0 + kp);
+        k *= k;
+        kp = sqrt( 1.0 - k*k );
+        v[l_M++] = k;
+    }
+    return l_M;
+}
+
+static double complex landen_up( double complex w, const double *v, int M )
+{
+    for(int n=M-1;n>=0;n--){
+        w = (1.0 + v[n])*w/(1.0 + v[n]*w*w);
+    }
+    return w;
+}
+
+static double complex cde( double complex u, double k, double kp )
+{
+    double l_v[LANDEN_MAX];
+    int l_M = landen( k, kp, l_v );
+    return landen_up( ccos( u*M_PI/2.0 ), l_v, l_M );
+}
+
+static double sne( double u, double k, double kp )
+{
+    double l_v[LANDEN_MAX];
+    int l_M = landen( k, kp, l_v );
+    return creal( landen_up( sin( u*M_PI/2.0 ), l_v, l_M ) );
+}
+
+static double complex asne( double complex w, double k, double kp )
+{
+    double l_v[LANDEN_MAX];
+    int l_M = landen( k, kp, l_v );
+    double l_v1 = k;
+    for(int n=0;n<l_M;n++){
+        w = w/(1.0 + csqrt( 1.0 - w*w*l_v1*l_v1 ))*2.0/(1.0 + l_v[n]);
+        l_v1 = l_v[n];
+    }
+    return 2.0/M_PI*casin( w );
+}
+
+void Ellip_Prototype_design( Ellip_Prototype *p_pproto, int p_N_stages,
+                             double p_ripple, double p_attenuation )
+{
+    if( p_N_stages < 1 ) p_N_stages = 1;
+    if( p_N_stages > ELLIP_STAGES_MAX ) p_N_stages = ELLIP_STAGES_MAX;
+    int l_N = 2*p_N_stages;
+
+    double l_ep = sqrt( pow( 10.0, p_ripple/10.0 ) - 1.0 );
+    double l_es = sqrt( pow( 10.0, p_attenuation/10.0 ) - 1.0 );
+    double l_k1 = l_ep/l_es;
+    double l_k1p = sqrt( 1.0 - l_k1*l_k1 );
+
+    // degree equation
+    double l_kp = pow( l_k1p, l_N );
+    for(int i=1;i<=p_N_stages;i++){
+        double l_sn = sne( (2.0*i - 1.0)/l_N, l_k1p, l_k1 );
+        l_kp *= l_sn*l_sn*l_sn*l_sn;
+    }
+    double l_k = sqrt( 1.0 - l_kp*l_kp );
+
+    double complex l_v0 = -I*asne( I/l_ep, l_k1, l_k1p )/l_N;
+
+    double l_gain = 1.0/sqrt( 1.0 + l_ep*l_ep );
+    for(int i=1;i<=p_N_stages;i++){
+        double l_u = (2.0*i - 1.0)/l_N;
+        double complex l_zero = I/(l_k*cde( l_u, l_k, l_kp ));
+        double complex l_pole = I*cde( l_u - I*l_v0, l_k, l_kp );
+        // lowest Q stage first, as in the scilab designs
+        ec_stage *l_pst = &p_pproto->m_stages[p_N_stages-i];
+        l_pst->cnum0 = creal( l_zero*conj( l_zero ) );
+        l_pst->cden0 = creal( l_pole*conj( l_pole ) );
+        l_pst->cden1 = -2.0*creal( l_pole );
+        l_gain *= l_pst->cden0/l_pst->cnum0;
+    }
+    p_pproto->m_N_stages = p_N_stages;
+    p_pproto->m_gain = l_gain;
+}
+
+/*
+ * Prototypes only depend on the three controls, so designs are shared
+ * between instances through the coefficient cache.
+ */
+void Ellip_Prototype_get( Ellip_Prototype *p_pproto, int p_N_stages,
+                          float p_ripple, float p_attenuation )
+{
+    double l_coeff[1 + 3*ELLIP_STAGES_MAX];
+    BW_Cache_Key l_key;
+    if( p_N_stages < 1 ) p_N_stages = 1;
+    if( p_N_stages > ELLIP_STAGES_MAX ) p_N_stages = ELLIP_STAGES_MAX;
+    l_key.m_type = BW_CACHE_ELLIP;
+    l_key.m_N = p_N_stages;
+    l_key.m_fn = p_ripple;
+    l_key.m_Q = p_attenuation;
+    int l_ncoeff = 1 + 3*p_N_stages;
+    if( BW_Cache_lookup( &l_key, l_coeff, l_ncoeff ) ){
+        p_pproto->m_N_stages = p_N_stages;
+        p_pproto->m_gain = l_coeff[0];
+        for(int i=0;i<p_N_stages;i++){
+            p_pproto->m_stages[i].cden1 = l_coeff[1+3*i];
+            p_pproto->m_stages[i].cden0 = l_coeff[2+3*i];
+            p_pproto->m_stages[i].cnum0 = l_coeff[3+3*i];
+        }
+        return;
+    }
+    Ellip_Prototype_design( p_pproto, p_N_stages, p_ripple, p_attenuation );
+    l_coeff[0] = p_pproto->m_gain;
+    for(int i=0;i<p_N_stages;i++){
+        l_coeff[1+3*i] = p_pproto->m_stages[i].cden1;
+        l_coeff[2+3*i] = p_pproto->m_stages[i].cden0;
+        l_coeff[3+3*i] = p_pproto->m_stages[i].cnum0;
+    }
+    BW_Cache_store( &l_key, l_coeff, l_ncoeff );
+}
+
+/*
+ * |Hlp(j*W)| = gain * prod |cnum0 - W^2| / |cden0 - W^2 + j*cden1*W|
+ */
+double Ellip_Prototype_magnitude( const Ellip_Prototype *p_pproto, double p_W )
+{
+    double l_W2 = p_W*p_W;
+    double l_m = p_pproto->m_gain;
+    for(int i=0;i<p_pproto->m_N_stages;i++){
+        const ec_stage *l_pst = &p_pproto->m_stages[i];
+        double l_re = l_pst->cden0 - l_W2;
+        double l_im = l_pst->cden1*p_W;
+        l_m *= fabs( l_pst->cnum0 - l_W2 )/sqrt( l_re*l_re + l_im*l_im );
+    }
+    return l_m;
+}
@@ -27,7 +27,9 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
-#include "ellip_coeff.h"
+#include <string.h>
+#include "ellip_design.h"
+#include "linphase.h"
 
 /*
  *
@@ -60,6 +62,11 @@ enum {
     PORT_OUT,
     PORT_FREQUENCY,
     PORT_Q,
+    PORT_STAGES,
+    PORT_RIPPLE,
+    PORT_ATTENUATION,
+    PORT_LINEAR,
+    PORT_LATENCY,
     PORT_NPORTS
 };
 
@@ -132,13 +139,18 @@ static double BQ_eval(BQ_Data *bq, double x)
 typedef struct {
     LADSPA_Data  m_sample_rate;
     LADSPA_Data *m_pport[PORT_NPORTS];
-    BQ_Data      m_bqs[N_STAGES];
+    BQ_Data      m_bqs[ELLIP_STAGES_MAX];
+    Ellip_Prototype m_proto;
+    LADSPA_Data  m_ripple;
+    LADSPA_Data  m_attenuation;
+    Linphase    *m_plinphase;
+    int          m_linear;
 } Ellip_BS_Data;
 
 static void Ellip_BS_set( Ellip_BS_Data *ed, double K, double Q)
 {
-    for(int i=0;i<N_STAGES;i++){
-        BQ_set(&ed->m_bqs[i], K, Q, &ec_stages[i]);
+    for(int i=0;i<ed->m_proto.m_N_stages;i++){
+        BQ_set(&ed->m_bqs[i], K, Q, &ed->m_proto.m_stages[i]);
     }
 }
 
@@ -147,21 +159,47 @@ static LADSPA_Data Ellip_BS_eval(
         LADSPA_Data x)
 {
     double a = x;
-    for(int i=0;i<N_STAGES;i++){
+    for(int i=0;i<ed->m_proto.m_N_stages;i++){
         a = BQ_eval(&ed->m_bqs[i], a);
     }
-    a *= ec_gain;
+    a *= ed->m_proto.m_gain;
     return (LADSPA_Data)a;
 }
 
+/*
+ * Linear phase mode, magnitude of the elliptic prototype at the
+ * prototype frequency W of the digital frequency omega, with the same
+ * prewarping as the bilinear transform above.
+ */
+typedef struct {
+    Ellip_Prototype m_proto;
+    double m_K;
+    double m_Q;
+} Ellip_BS_Linphase_Params;
+
+static double Ellip_BS_magnitude( const void *p_pparams, double p_omega )
+{
+    const Ellip_BS_Linphase_Params *l_pp = p_pparams;
+    double l_O = tan(p_omega/2.0)*l_pp->m_K;
+    double l_W = 1.0/(l_pp->m_Q*(l_O - 1.0/l_O));
+    return Ellip_Prototype_magnitude(&l_pp->m_proto, l_W);
+}
+
 static LADSPA_Handle Ellip_BS_instantiate(
     const struct _LADSPA_Descriptor *p_pDescriptor,
     unsigned long p_sample_rate)
 {
     Ellip_BS_Data *l_pEllip_BS = malloc( sizeof(Ellip_BS_Data) );
     if(l_pEllip_BS){
+        l_pEllip_BS->m_plinphase = Linphase_new(Ellip_BS_magnitude);
+        if(!l_pEllip_BS->m_plinphase){
+            free(l_pEllip_BS);
+            return NULL;
+        }
+        l_pEllip_BS->m_linear = 0;
         l_pEllip_BS->m_sample_rate = (float)p_sample_rate;
-        for(int i=0;i<N_STAGES;i++){
+        l_pEllip_BS->m_proto.m_N_stages = 0;
+        for(int i=0;i<ELLIP_STAGES_MAX;i++){
             BQ_init(&l_pEllip_BS->m_bqs[i]);
         }
     }
@@ -186,6 +224,53 @@ static void Ellip_BS_run(
     LADSPA_Data *l_pdst = l_pEllip_BS->m_pport[PORT_OUT];
     LADSPA_Data *l_psrc_end = l_psrc + p_sample_count;
 
+    int l_N_stages = (int)*l_pEllip_BS->m_pport[PORT_STAGES];
+    if( l_N_stages < 1 ) l_N_stages = 1;
+    if( l_N_stages > ELLIP_STAGES_MAX ) l_N_stages = ELLIP_STAGES_MAX;
+    LADSPA_Data l_ripple = *l_pEllip_BS->m_pport[PORT_RIPPLE];
+    LADSPA_Data l_attenuation = *l_pEllip_BS->m_pport[PORT_ATTENUATION];
+    if(l_N_stages != l_pEllip_BS->m_proto.m_N_stages ||
+       l_ripple != l_pEllip_BS->m_ripple ||
+       l_attenuation != l_pEllip_BS->m_attenuation){
+        int l_N_old = l_pEllip_BS->m_proto.m_N_stages;
+        Ellip_Prototype_get(&l_pEllip_BS->m_proto, l_N_stages, l_ripple,
+                            l_attenuation);
+        // stages coming online start from rest
+        for(int i=l_N_old;i<l_pEllip_BS->m_proto.m_N_stages;i++){
+            BQ_init(&l_pEllip_BS->m_bqs[i]);
+        }
+        l_pEllip_BS->m_ripple = l_ripple;
+        l_pEllip_BS->m_attenuation = l_attenuation;
+    }
+
+    if(*l_pEllip_BS->m_pport[PORT_LINEAR] > 0.5f){
+        Ellip_BS_Linphase_Params l_params;
+        memset(&l_params, 0, sizeof(l_params));
+        l_params.m_proto.m_N_stages = l_pEllip_BS->m_proto.m_N_stages;
+        l_params.m_proto.m_gain = l_pEllip_BS->m_proto.m_gain;
+        memcpy(l_params.m_proto.m_stages, l_pEllip_BS->m_proto.m_stages,
+               sizeof(l_params.m_proto.m_stages));
+        l_params.m_K = 1.0/tan(M_PI* *l_pEllip_BS->m_pport[PORT_FREQUENCY]/
+                               l_pEllip_BS->m_sample_rate);
+        l_params.m_Q = *l_pEllip_BS->m_pport[PORT_Q];
+        if(!l_pEllip_BS->m_linear){
+            Linphase_reset(l_pEllip_BS->m_plinphase);
+            l_pEllip_BS->m_linear = 1;
+        }
+        Linphase_request(l_pEllip_BS->m_plinphase, &l_params, sizeof(l_params));
+        *l_pEllip_BS->m_pport[PORT_LATENCY] = (LADSPA_Data)LINPHASE_LATENCY;
+        Linphase_run(l_pEllip_BS->m_plinphase, l_psrc, l_pdst, p_sample_count);
+        return;
+    }
+    if(l_pEllip_BS->m_linear){
+        // back from linear phase mode, restart the recursive filter
+        for(int i=0;i<ELLIP_STAGES_MAX;i++){
+            BQ_init(&l_pEllip_BS->m_bqs[i]);
+        }
+        l_pEllip_BS->m_linear = 0;
+    }
+    *l_pEllip_BS->m_pport[PORT_LATENCY] = 0.0f;
+
     LADSPA_Data l_omega = 2.0f*M_PIf* *l_pEllip_BS->m_pport[PORT_FREQUENCY];
     l_omega /= l_pEllip_BS->m_sample_rate;
     double l_K = 1.0/tan((double)l_omega/2.0);
@@ -199,6 +284,8 @@ static void Ellip_BS_run(
 
 static void Ellip_BS_cleanup( LADSPA_Handle p_pInstance )
 {
+    Ellip_BS_Data *l_pEllip_BS = (Ellip_BS_Data*)p_pInstance;
+    Linphase_free(l_pEllip_BS->m_plinphase);
     free( p_pInstance );
 }
 
@@ -207,7 +294,12 @@ static LADSPA_PortDescriptor Ellip_BS_PortDescriptors[]=
     LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
-    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL
 };
 
 static const char *Ellip_BS_PortNames[]=
@@ -215,7 +307,12 @@ static const char *Ellip_BS_PortNames[]=
     "Input",
     "Output",
     "Frequency(Hertz)",
-    "Q(fc/(fc2-fc1))"
+    "Q(fc/(fc2-fc1))",
+    "Stages(Filter order/2)",
+    "Passband ripple(dB)",
+    "Stopband attenuation(dB)",
+    "Linear phase",
+    "latency"
 };
 
 static LADSPA_PortRangeHint Ellip_BS_PortRangeHints[]=
@@ -227,7 +324,19 @@ static LADSPA_PortRangeHint Ellip_BS_PortRangeHints[]=
      10.0f,20.0e3f},
     {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
      LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
-     0.1f,10.0f}
+     0.1f,10.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_INTEGER | LADSPA_HINT_DEFAULT_MAXIMUM,
+     1.0f, 5.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
+     ELLIP_RIPPLE_MIN,ELLIP_RIPPLE_MAX},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MIDDLE,
+     ELLIP_ATTENUATION_MIN,ELLIP_ATTENUATION_MAX},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f,0.0f},
+    {0,0.0f,0.0f}
 };
 
 LADSPA_Descriptor Ellip_BS_Descriptor=
@@ -27,7 +27,10 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
-#include "ellip_coeff.h"
+#include <string.h>
+#include "ellip_design.h"
+#include "multirate.h"
+#include "linphase.h"
 
 /*
  *
@@ -52,6 +55,11 @@ enum {
     PORT_IN,
     PORT_OUT,
     PORT_FREQUENCY,
+    PORT_STAGES,
+    PORT_RIPPLE,
+    PORT_ATTENUATION,
+    PORT_LINEAR,
+    PORT_LATENCY,
     PORT_NPORTS
 };
 
@@ -102,13 +110,19 @@ static double BQ_eval(BQ_Data *bq, double x)
 typedef struct {
     LADSPA_Data  m_sample_rate;
     LADSPA_Data *m_pport[PORT_NPORTS];
-    BQ_Data      m_bqs[N_STAGES];
+    BQ_Data      m_bqs[ELLIP_STAGES_MAX];
+    Ellip_Prototype m_proto;
+    LADSPA_Data  m_ripple;
+    LADSPA_Data  m_attenuation;
+    MR_Data      m_mr;
+    Linphase    *m_plinphase;
+    int          m_linear;
 } Ellip_HP_Data;
 
 static void Ellip_HP_set( Ellip_HP_Data *ed, double K)
 {
-    for(int i=0;i<N_STAGES;i++){
-        BQ_set(&ed->m_bqs[i], K, &ec_stages[i]);
+    for(int i=0;i<ed->m_proto.m_N_stages;i++){
+        BQ_set(&ed->m_bqs[i], K, &ed->m_proto.m_stages[i]);
     }
 }
 
@@ -117,21 +131,51 @@ static LADSPA_Data Ellip_HP_eval(
         LADSPA_Data x)
 {
     double a = x;
-    for(int i=0;i<N_STAGES;i++){
+    for(int i=0;i<ed->m_proto.m_N_stages;i++){
         a = BQ_eval(&ed->m_bqs[i], a);
     }
-    a *= ec_gain;
+    a *= ed->m_proto.m_gain;
     return (LADSPA_Data)a;
 }
 
+/*
+ * Linear phase mode, magnitude of the elliptic prototype at the
+ * prototype frequency W of the digital frequency omega, with the same
+ * prewarping as the bilinear transform above.
+ */
+typedef struct {
+    Ellip_Prototype m_proto;
+    double m_K;
+} Ellip_HP_Linphase_Params;
+
+static double Ellip_HP_magnitude( const void *p_pparams, double p_omega )
+{
+    const Ellip_HP_Linphase_Params *l_pp = p_pparams;
+    double l_W = 1.0/(tan(p_omega/2.0)*l_pp->m_K);
+    return Ellip_Prototype_magnitude(&l_pp->m_proto, l_W);
+}
+
+static LADSPA_Data Ellip_HP_filter( void *p_pcontext, LADSPA_Data x )
+{
+    return Ellip_HP_eval((Ellip_HP_Data*)p_pcontext, x);
+}
+
 static LADSPA_Handle Ellip_HP_instantiate(
     const struct _LADSPA_Descriptor *p_pDescriptor,
     unsigned long p_sample_rate)
 {
     Ellip_HP_Data *l_pEllip_HP = malloc( sizeof(Ellip_HP_Data) );
     if(l_pEllip_HP){
+        l_pEllip_HP->m_plinphase = Linphase_new(Ellip_HP_magnitude);
+        if(!l_pEllip_HP->m_plinphase){
+            free(l_pEllip_HP);
+            return NULL;
+        }
+        l_pEllip_HP->m_linear = 0;
         l_pEllip_HP->m_sample_rate = (float)p_sample_rate;
-        for(int i=0;i<N_STAGES;i++){
+        MR_init(&l_pEllip_HP->m_mr, 0);
+        l_pEllip_HP->m_proto.m_N_stages = 0;
+        for(int i=0;i<ELLIP_STAGES_MAX;i++){
             BQ_init(&l_pEllip_HP->m_bqs[i]);
         }
     }
@@ -156,11 +200,74 @@ static void Ellip_HP_run(
     LADSPA_Data *l_pdst = l_pEllip_HP->m_pport[PORT_OUT];
     LADSPA_Data *l_psrc_end = l_psrc + p_sample_count;
 
-    LADSPA_Data l_omega = 2.0f*M_PIf* *l_pEllip_HP->m_pport[PORT_FREQUENCY];
+    int l_N_stages = (int)*l_pEllip_HP->m_pport[PORT_STAGES];
+    if( l_N_stages < 1 ) l_N_stages = 1;
+    if( l_N_stages > ELLIP_STAGES_MAX ) l_N_stages = ELLIP_STAGES_MAX;
+    LADSPA_Data l_ripple = *l_pEllip_HP->m_pport[PORT_RIPPLE];
+    LADSPA_Data l_attenuation = *l_pEllip_HP->m_pport[PORT_ATTENUATION];
+    if(l_N_stages != l_pEllip_HP->m_proto.m_N_stages ||
+       l_ripple != l_pEllip_HP->m_ripple ||
+       l_attenuation != l_pEllip_HP->m_attenuation){
+        int l_N_old = l_pEllip_HP->m_proto.m_N_stages;
+        Ellip_Prototype_get(&l_pEllip_HP->m_proto, l_N_stages, l_ripple,
+                            l_attenuation);
+        // stages coming online start from rest
+        for(int i=l_N_old;i<l_pEllip_HP->m_proto.m_N_stages;i++){
+            BQ_init(&l_pEllip_HP->m_bqs[i]);
+        }
+        l_pEllip_HP->m_ripple = l_ripple;
+        l_pEllip_HP->m_attenuation = l_attenuation;
+    }
+
+    if(*l_pEllip_HP->m_pport[PORT_LINEAR] > 0.5f){
+        Ellip_HP_Linphase_Params l_params;
+        memset(&l_params, 0, sizeof(l_params));
+        l_params.m_proto.m_N_stages = l_pEllip_HP->m_proto.m_N_stages;
+        l_params.m_proto.m_gain = l_pEllip_HP->m_proto.m_gain;
+        memcpy(l_params.m_proto.m_stages, l_pEllip_HP->m_proto.m_stages,
+               sizeof(l_params.m_proto.m_stages));
+        l_params.m_K = 1.0/tan(M_PI* *l_pEllip_HP->m_pport[PORT_FREQUENCY]/
+                               l_pEllip_HP->m_sample_rate);
+        if(!l_pEllip_HP->m_linear){
+            Linphase_reset(l_pEllip_HP->m_plinphase);
+            l_pEllip_HP->m_linear = 1;
+        }
+        Linphase_request(l_pEllip_HP->m_plinphase, &l_params, sizeof(l_params));
+        *l_pEllip_HP->m_pport[PORT_LATENCY] = (LADSPA_Data)LINPHASE_LATENCY;
+        Linphase_run(l_pEllip_HP->m_plinphase, l_psrc, l_pdst, p_sample_count);
+        return;
+    }
+    if(l_pEllip_HP->m_linear){
+        // back from linear phase mode, restart the recursive filter
+        for(int i=0;i<ELLIP_STAGES_MAX;i++){
+            BQ_init(&l_pEllip_HP->m_bqs[i]);
+        }
+        MR_init(&l_pEllip_HP->m_mr, l_pEllip_HP->m_mr.m_D);
+        l_pEllip_HP->m_linear = 0;
+    }
+
+    LADSPA_Data l_frequency = *l_pEllip_HP->m_pport[PORT_FREQUENCY];
+    int l_D = MR_stages(l_frequency/l_pEllip_HP->m_sample_rate,
+                        l_pEllip_HP->m_mr.m_D);
+    if(l_D != l_pEllip_HP->m_mr.m_D){
+        // the filter moves to another rate, restart it from rest
+        MR_init(&l_pEllip_HP->m_mr, l_D);
+        for(int i=0;i<l_pEllip_HP->m_proto.m_N_stages;i++){
+            BQ_init(&l_pEllip_HP->m_bqs[i]);
+        }
+    }
+    l_frequency *= (float)(1 << l_D);
+    *l_pEllip_HP->m_pport[PORT_LATENCY] = (LADSPA_Data)l_pEllip_HP->m_mr.m_latency;
+    LADSPA_Data l_omega = 2.0f*M_PIf*l_frequency;
     l_omega /= l_pEllip_HP->m_sample_rate;
     double l_K = 1.0/tan((double)l_omega/2.0);
     Ellip_HP_set(l_pEllip_HP, l_K);
 
+    if(l_D){
+        MR_run(&l_pEllip_HP->m_mr, l_psrc, l_pdst, p_sample_count,
+               Ellip_HP_filter, l_pEllip_HP, 1);
+        return;
+    }
     for(;l_psrc!=l_psrc_end;l_psrc++,l_pdst++){
         *l_pdst = Ellip_HP_eval(l_pEllip_HP, *l_psrc);
     }
@@ -168,6 +275,8 @@ static void Ellip_HP_run(
 
 static void Ellip_HP_cleanup( LADSPA_Handle p_pInstance )
 {
+    Ellip_HP_Data *l_pEllip_HP = (Ellip_HP_Data*)p_pInstance;
+    Linphase_free(l_pEllip_HP->m_plinphase);
     free( p_pInstance );
 }
 
@@ -175,14 +284,24 @@ static LADSPA_PortDescriptor Ellip_HP_PortDescriptors[]=
 {
     LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
     LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
-    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL
 };
 
 static const char *Ellip_HP_PortNames[]=
 {
     "Input",
     "Output",
-    "Frequency(Hertz)"
+    "Frequency(Hertz)",
+    "Stages(Filter order/2)",
+    "Passband ripple(dB)",
+    "Stopband attenuation(dB)",
+    "Linear phase",
+    "latency"
 };
 
 static LADSPA_PortRangeHint Ellip_HP_PortRangeHints[]=
@@ -191,7 +310,19 @@ static LADSPA_PortRangeHint Ellip_HP_PortRangeHints[]=
     {0,0.0f,0.0f},
     {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
      LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
-     10.0f,20.0e3f}
+     10.0f,20.0e3f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_INTEGER | LADSPA_HINT_DEFAULT_MAXIMUM,
+     1.0f, 5.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
+     ELLIP_RIPPLE_MIN,ELLIP_RIPPLE_MAX},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MIDDLE,
+     ELLIP_ATTENUATION_MIN,ELLIP_ATTENUATION_MAX},
+    {LADSPA_HINT_TOGGLED | LADSPA_HINT_DEFAULT_0,
+     0.0f,0.0f},
+    {0,0.0f,0.0f}
 };
 
 LADSPA_Descriptor Ellip_HP_Descriptor=
@@ -27,6 +27,9 @@ Contact: tim.krause@twkrause.ca
 #include "fad_table.h"
 #include <math.h>
 
+#define FAD_BLOCK 64
+#define FAD_LANES 8
+
 float FadSample( float *p_pBuf, long p_start, long p_Nbuf, float p_alpha )
 {
     if(p_alpha < 0.0) p_alpha=0.0;
@@ -36,7 +39,7 @@ float FadSample( float *p_pBuf, long p_start, long p_Nbuf, float p_alpha )
 	long l_Nloop2;
 	
 	if( p_start + FAD_NWINDOW - 1 >= p_Nbuf ){
-		l_Nloop1 = p_Nbuf - 1 - p_start;
+		l_Nloop1 = p_Nbuf - p_start;
 		l_Nloop2 = FAD_NWINDOW - l_Nloop1;
 	}else{
 		l_Nloop1 = FAD_NWINDOW;
@@ -63,3 +66,110 @@ unsigned long FadNwindow( void )
 {
 	return FAD_NWINDOW;
 }
+
+/*
+ * The FadNwindow() taps FadSample uses for p_alpha, the point between
+ * taps FadNwindow()/2 - 1 and FadNwindow()/2.
+ */
+const float *FadSinc( float p_alpha )
+{
+    if(p_alpha < 0.0) p_alpha=0.0;
+    if(p_alpha >=1.0) p_alpha=1.0-1.0f/FAD_FSS;
+    return &g_sinc[ (long)floorf(p_alpha*FAD_FSS) ][0];
+}
+
+/*
+ * p_n consecutive FadSample values, p_pdst[i] = FadSample( p_pBuf,
+ * p_start + i, p_Nbuf, p_alpha ), with the wrap handled once per
+ * FAD_BLOCK outputs. The sums run in the same order as FadSample's, a
+ * vector of outputs per tap, so the values are the same.
+ */
+void FadBlock( float *p_pBuf, long p_start, long p_Nbuf, float p_alpha,
+	float *p_pdst, long p_n )
+{
+	const float *l_psinc = FadSinc( p_alpha );
+	float l_x[FAD_BLOCK + FAD_NWINDOW - 1];
+	float l_y[FAD_BLOCK];
+
+	while( p_n > 0 ){
+		long l_n = p_n < FAD_BLOCK ? p_n : FAD_BLOCK;
+		long l_Ncopy = l_n + FAD_NWINDOW - 1;
+		long l_Nloop1 = p_Nbuf - p_start;
+		if( l_Nloop1 > l_Ncopy )
+			l_Nloop1 = l_Ncopy;
+		long i;
+		for( i = 0; i < l_Nloop1; i++ )
+			l_x[i] = p_pBuf[p_start + i];
+		for( ; i < l_Ncopy; i++ )
+			l_x[i] = p_pBuf[p_start + i - p_Nbuf];
+		for( ; i < FAD_BLOCK + FAD_NWINDOW - 1; i++ )
+			l_x[i] = 0.0f;
+
+		// a full FAD_BLOCK every time, the fixed count vectorizes
+		for( i = 0; i < FAD_BLOCK; i++ )
+			l_y[i] = 0.0f;
+		for( int k = 0; k < FAD_NWINDOW; k++ ){
+			for( i = 0; i < FAD_BLOCK; i++ )
+				l_y[i] += l_x[i + k] * l_psinc[k];
+		}
+		for( i = 0; i < l_n; i++ )
+			p_pdst[i] = l_y[i];
+
+		p_start += l_n;
+		if( p_start >= p_Nbuf )
+			p_start -= p_Nbuf;
+		p_pdst += l_n;
+		p_n -= l_n;
+	}
+}
+
+/*
+ * The FAD_NWINDOW tap sum in FAD_LANES interleaved partial sums, one
+ * vector, added pairwise at the end.
+ */
+static inline float Fad_dot( const float *p_px, const float *p_psinc )
+{
+	float l_acc[FAD_LANES];
+	for( int j = 0; j < FAD_LANES; j++ )
+		l_acc[j] = p_px[j] * p_psinc[j];
+	for( int k = FAD_LANES; k < FAD_NWINDOW; k += FAD_LANES ){
+		for( int j = 0; j < FAD_LANES; j++ )
+			l_acc[j] += p_px[k + j] * p_psinc[k + j];
+	}
+	for( int l_n = FAD_LANES/2; l_n; l_n /= 2 ){
+		for( int j = 0; j < l_n; j++ )
+			l_acc[j] += l_acc[j + l_n];
+	}
+	return l_acc[0];
+}
+
+/*
+ * p_n reads at their own starts and fractions, p_pdst[v] = FadSample(
+ * p_pBuf, p_pstart[v], p_Nbuf, p_palpha[v] ) up to rounding, for the
+ * voices of a modulated delay. Fad_dot makes each read a few vector
+ * multiply adds instead of a sum FAD_NWINDOW long.
+ */
+void FadSamples( float *p_pBuf, long p_Nbuf, const long *p_pstart,
+	const float *p_palpha, float *p_pdst, long p_n )
+{
+	for( long v = 0; v < p_n; v++ ){
+		// FadSinc's row, alpha >= 0 so the cast is floorf
+		float l_alpha = p_palpha[v];
+		l_alpha = l_alpha < 0.0f ? 0.0f : l_alpha;
+		long l_row = (long)(l_alpha*FAD_FSS);
+		l_row = l_row > FAD_FSS - 1 ? FAD_FSS - 1 : l_row;
+		const float *l_psinc = &g_sinc[l_row][0];
+		const float *l_psrc = &p_pBuf[p_pstart[v]];
+		float l_x[FAD_NWINDOW];
+		if( p_pstart[v] + FAD_NWINDOW > p_Nbuf ){
+			long l_Nloop1 = p_Nbuf - p_pstart[v];
+			long i;
+			for( i = 0; i < l_Nloop1; i++ )
+				l_x[i] = l_psrc[i];
+			for( ; i < FAD_NWINDOW; i++ )
+				l_x[i] = p_pBuf[i - l_Nloop1];
+			l_psrc = l_x;
+		}
+		p_pdst[v] = Fad_dot( l_psrc, l_psinc );
+	}
+}
@@ -26,3 +26,8 @@ Contact: tim.krause@twkrause.ca
 
 float FadSample( float *p_pBuf, long p_start, long p_Nbuf, float p_alpha );
 unsigned long FadNwindow( void );
+const float *FadSinc( float p_alpha );
+void FadBlock( float *p_pBuf, long p_start, long p_Nbuf, float p_alpha,
+	float *p_pdst, long p_n );
+void FadSamples( float *p_pBuf, long p_Nbuf, const long *p_pstart,
+	const float *p_palpha, float *p_pdst, long p_n );
@@ -0,0 +1,299 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+#include <math.h>
+
+/*
+ * Fast float math for the per sample paths.
+ *
+ * Polynomial and bit manipulation versions of the libm functions used
+ * in the hot loops, in two accuracy tiers. The full tier is at or
+ * below the rounding noise of a float signal, the _fast tier is about
+ * -80 dB and meant for control signals: envelopes, gain computers,
+ * LFOs.
+ *
+ *   function            max error                    domain
+ *   FM_exp2f            2.5e-7 relative              -126 <= x <= 127
+ *   FM_exp2f_fast       7.5e-5 relative
+ *   FM_log2f            1.2e-7 absolute              x > 0, normal
+ *   FM_log2f_fast       1.1e-4 absolute
+ *   FM_exp10f           1.2e-6 relative              |x| <= 6
+ *   FM_exp10f_fast      7.6e-5 relative
+ *   FM_log10f(_fast)    log2f*log10(2)               as log2f
+ *   FM_powf             3.5e-7 + 1.0e-7*|y|          x >= 0, 0 for x = 0,
+ *                         + 5.0e-8*|t| relative      |t| <= 126
+ *   FM_powf_fast        7.5e-5 + 8.0e-5*|y|
+ *                         + 5.0e-8*|t| relative
+ *   FM_sinf, FM_cosf    8.0e-7 absolute              |x| <= 2*pi
+ *   FM_sinf_fast, ..    7.0e-5 absolute
+ *   FM_tanf             6.5e-6 relative              |x| <= 0.49*pi
+ *   FM_tanf_fast        4.0e-4 relative
+ *
+ * log2f is exact to the float rounding of e + u*q, so for large or
+ * small x the absolute error is one ulp of the result. exp10f loses
+ * the rounding of x*log2(10) on top of exp2f. powf is exp2f(t) with
+ * t = y*log2f(x), the absolute error of log2f times |y| and the
+ * rounding of t come out as relative error, so it grows with |y| and
+ * the size of the result, to about 9e-6 for t near +-126.
+ *
+ * sinf and cosf reduce x modulo 2*pi in float, the error grows with
+ * |x|/(2*pi), keep phase accumulators wrapped. The reduction is only
+ * valid for |x| < 2^22*2*pi.
+ *
+ * exp2f: x = k + f, k = round(x), |f| <= 1/2
+ *        2^x = 2^k*p(f), 2^k built in the exponent bits
+ * log2f: x = 2^e*m, sqrt(1/2) <= m < sqrt(2), u = m - 1
+ *        log2(x) = e + u*q(u)
+ * sinf:  r = x/(2*pi) reduced to |r| <= 1/2, b = |r| or 1/2 - |r|
+ *        sin(x) = sign(r)*b*s(b^2)
+ * tanf:  sinf(x)/cosf(x)
+ *
+ * p, q and s are minimax polynomials, the coefficients are from a
+ * Remez exchange on the intervals above.
+ *
+ * The _v forms run over arrays with branch free loops which gcc
+ * vectorizes, the clamps need -fno-trapping-math for that (set in the
+ * Makefile, it changes no results).
+ *
+ * Building with TWK_LIBM defined (make LIBM=1) maps all of these onto
+ * the libm function of the same name, exp10f onto powf(10, x), for
+ * reference runs.
+ */
+
+#ifdef TWK_LIBM
+
+static inline float FM_exp2f( float x ) { return exp2f(x); }
+static inline float FM_exp2f_fast( float x ) { return exp2f(x); }
+static inline float FM_log2f( float x ) { return log2f(x); }
+static inline float FM_log2f_fast( float x ) { return log2f(x); }
+static inline float FM_sinf( float x ) { return sinf(x); }
+static inline float FM_sinf_fast( float x ) { return sinf(x); }
+static inline float FM_cosf( float x ) { return cosf(x); }
+static inline float FM_cosf_fast( float x ) { return cosf(x); }
+static inline float FM_tanf( float x ) { return tanf(x); }
+static inline float FM_tanf_fast( float x ) { return tanf(x); }
+static inline float FM_exp10f( float x ) { return powf(10.0f,x); }
+static inline float FM_exp10f_fast( float x ) { return powf(10.0f,x); }
+static inline float FM_log10f( float x ) { return log10f(x); }
+static inline float FM_log10f_fast( float x ) { return log10f(x); }
+
+static inline float FM_powf( float x, float y )
+{
+    return x > 0.0f ? powf(x,y) : 0.0f;
+}
+
+static inline float FM_powf_fast( float x, float y )
+{
+    return x > 0.0f ? powf(x,y) : 0.0f;
+}
+
+#else
+
+typedef union {
+    float m_f;
+    int   m_i;
+} FM_Bits;
+
+/*
+ * Adding and subtracting 1.5*2^23 rounds a float to the nearest
+ * integer and leaves it in the low mantissa bits, cheaper than a
+ * round trip through int and good for |x| < 2^22.
+ */
+#define FM_ROUND_MAGIC 12582912.0f
+#define FM_ROUND_MAGIC_BITS 0x4b400000
+
+static inline float FM_exp2_split( float x, float *p_pf )
+{
+    x = x < -126.0f ? -126.0f : x;
+    x = x > 127.0f ? 127.0f : x;
+    FM_Bits l_k;
+    l_k.m_f = x + FM_ROUND_MAGIC;
+    *p_pf = x - (l_k.m_f - FM_ROUND_MAGIC);
+    FM_Bits l_scale;
+    l_scale.m_i = (l_k.m_i - FM_ROUND_MAGIC_BITS + 127) << 23;
+    return l_scale.m_f;
+}
+
+static inline float FM_exp2f( float x )
+{
+    float f;
+    float l_scale = FM_exp2_split(x, &f);
+    float p = 1.3276472168e-03f;
+    p = p*f + 9.6755413310e-03f;
+    p = p*f + 5.5507132729e-02f;
+    p = p*f + 2.4022119724e-01f;
+    p = p*f + 6.9314696707e-01f;
+    p = p*f + 1.0000000717e+00f;
+    return l_scale*p;
+}
+
+static inline float FM_exp2f_fast( float x )
+{
+    float f;
+    float l_scale = FM_exp2_split(x, &f);
+    float p = 5.5171669093e-02f;
+    p = p*f + 2.4261112222e-01f;
+    p = p*f + 6.9326098545e-01f;
+    p = p*f + 9.9992807354e-01f;
+    return l_scale*p;
+}
+
+static inline float FM_log2_split( float x, float *p_pu )
+{
+    FM_Bits l_bits;
+    l_bits.m_f = x;
+    // move the mantissa to [sqrt(1/2), sqrt(2))
+    int l_i = l_bits.m_i - 0x3f3504f3;
+    int e = l_i >> 23;
+    l_bits.m_i = (l_i & 0x007fffff) + 0x3f3504f3;
+    *p_pu = l_bits.m_f - 1.0f;
+    return (float)e;
+}
+
+static inline float FM_log2f( float x )
+{
+    float u;
+    float e = FM_log2_split(x, &u);
+    float q = -1.4574451794e-01f;
+    q = q*u + 2.3689039779e-01f;
+    q = q*u - 2.5006903438e-01f;
+    q = q*u + 2.8670745240e-01f;
+    q = q*u - 3.6008721626e-01f;
+    q = q*u + 4.8093944495e-01f;
+    q = q*u - 7.2135714892e-01f;
+    q = q*u + 1.4426947724e+00f;
+    return e + u*q;
+}
+
+static inline float FM_log2f_fast( float x )
+{
+    float u;
+    float e = FM_log2_split(x, &u);
+    float q = -3.2962981867e-01f;
+    q = q*u + 5.1750940187e-01f;
+    q = q*u - 7.2490415151e-01f;
+    q = q*u + 1.4417606483e+00f;
+    return e + u*q;
+}
+
+/*
+ * p_r in turns, returns b in [0, 1/4] and the sign of the result
+ */
+static inline float FM_sin_reduce( float p_r, float *p_psign )
+{
+    float f = p_r - ((p_r + FM_ROUND_MAGIC) - FM_ROUND_MAGIC);
+    *p_psign = copysignf(1.0f, f);
+    float a = fabsf(f);
+    float l_b = 0.5f - a;
+    return a < l_b ? a : l_b;
+}
+
+static inline float FM_sin_turns( float p_r )
+{
+    float l_sign;
+    float b = FM_sin_reduce(p_r, &l_sign);
+    float b2 = b*b;
+    float s = 3.9536705966e+01f;
+    s = s*b2 - 7.6549782278e+01f;
+    s = s*b2 + 8.1601004072e+01f;
+    s = s*b2 - 4.1341655031e+01f;
+    s = s*b2 + 6.2831851601e+00f;
+    return l_sign*b*s;
+}
+
+static inline float FM_sin_turns_fast( float p_r )
+{
+    float l_sign;
+    float b = FM_sin_reduce(p_r, &l_sign);
+    float b2 = b*b;
+    float s = 7.3585514509e+01f;
+    s = s*b2 - 4.1095242671e+01f;
+    s = s*b2 + 6.2812800764e+00f;
+    return l_sign*b*s;
+}
+
+#define FM_1_2PI 0.159154943f
+
+static inline float FM_sinf( float x ) { return FM_sin_turns(x*FM_1_2PI); }
+static inline float FM_sinf_fast( float x ) { return FM_sin_turns_fast(x*FM_1_2PI); }
+static inline float FM_cosf( float x ) { return FM_sin_turns(x*FM_1_2PI + 0.25f); }
+static inline float FM_cosf_fast( float x ) { return FM_sin_turns_fast(x*FM_1_2PI + 0.25f); }
+
+static inline float FM_tanf( float x )
+{
+    float r = x*FM_1_2PI;
+    return FM_sin_turns(r)/FM_sin_turns(r + 0.25f);
+}
+
+static inline float FM_tanf_fast( float x )
+{
+    float r = x*FM_1_2PI;
+    return FM_sin_turns_fast(r)/FM_sin_turns_fast(r + 0.25f);
+}
+
+#define FM_LOG2_10 3.32192809f
+#define FM_LOG10_2 0.301029996f
+
+static inline float FM_exp10f( float x ) { return FM_exp2f(x*FM_LOG2_10); }
+static inline float FM_exp10f_fast( float x ) { return FM_exp2f_fast(x*FM_LOG2_10); }
+static inline float FM_log10f( float x ) { return FM_log2f(x)*FM_LOG10_2; }
+static inline float FM_log10f_fast( float x ) { return FM_log2f_fast(x)*FM_LOG10_2; }
+
+static inline float FM_powf( float x, float y )
+{
+    float l_p = FM_exp2f(y*FM_log2f(x));
+    return x > 0.0f ? l_p : 0.0f;
+}
+
+static inline float FM_powf_fast( float x, float y )
+{
+    float l_p = FM_exp2f_fast(y*FM_log2f_fast(x));
+    return x > 0.0f ? l_p : 0.0f;
+}
+
+#endif
+
+#define FM_VECTOR(NAME) \
+static inline void NAME##_v( const float *p_px, float *p_py, unsigned long p_n ) \
+{ \
+    for(unsigned long i=0;i<p_n;i++) \
+        p_py[i] = NAME(p_px[i]); \
+}
+
+FM_VECTOR(FM_exp2f)
+FM_VECTOR(FM_exp2f_fast)
+FM_VECTOR(FM_log2f)
+FM_VECTOR(FM_log2f_fast)
+FM_VECTOR(FM_exp10f)
+FM_VECTOR(FM_exp10f_fast)
+FM_VECTOR(FM_log10f)
+FM_VECTOR(FM_log10f_fast)
+FM_VECTOR(FM_sinf)
+FM_VECTOR(FM_sinf_fast)
+FM_VECTOR(FM_cosf)
+FM_VECTOR(FM_cosf_fast)
+FM_VECTOR(FM_tanf)
+FM_VECTOR(FM_tanf_fast)
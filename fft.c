@@ -0,0 +1,155 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "fft.h"
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+
+/*
+ * Real forward transform, z[m] = x[2*m] + j*x[2*m+1], Z = FFT(z)
+ *
+ *   Xe[k] = (Z[k] + conj(Z[nc-k]))/2
+ *   Xo[k] = (Z[k] - conj(Z[nc-k]))/(2*j)
+ *   X[k]  = Xe[k] + e^(-j*2*pi*k/n)*Xo[k],  k = 0..nc, Z[nc] = Z[0]
+ *
+ * Inverse
+ *
+ *   Xe[k] = (X[k] + conj(X[nc-k]))/2
+ *   Xo[k] = (X[k] - conj(X[nc-k]))/2*e^(j*2*pi*k/n)
+ *   Z[k]  = Xe[k] + j*Xo[k],  k = 0..nc-1
+ *
+ * followed by an unscaled inverse complex FFT.
+ */
+
+int FFT_Plan_init( FFT_Plan *p_pplan, int p_n )
+{
+    int l_nc = p_n/2;
+    int l_bits = 0;
+    while( (1 << l_bits) < l_nc ) l_bits++;
+    p_pplan->m_n = p_n;
+    p_pplan->m_nc = l_nc;
+    p_pplan->m_prev = malloc( sizeof(unsigned int)*l_nc );
+    p_pplan->m_ptw = malloc( sizeof(float complex)*(l_nc/2 + 1) );
+    p_pplan->m_prtw = malloc( sizeof(float complex)*l_nc );
+    p_pplan->m_pwork = malloc( sizeof(float complex)*l_nc );
+    if( !p_pplan->m_prev || !p_pplan->m_ptw || !p_pplan->m_prtw ||
+        !p_pplan->m_pwork ){
+        FFT_Plan_free( p_pplan );
+        return 0;
+    }
+    for(unsigned int i=0;i<(unsigned int)l_nc;i++){
+        unsigned int l_r = 0;
+        for(int b=0;b<l_bits;b++){
+            if( i & (1u << b) )
+                l_r |= 1u << (l_bits - 1 - b);
+        }
+        p_pplan->m_prev[i] = l_r;
+    }
+    for(int k=0;k<=l_nc/2;k++){
+        double l_a = -2.0*M_PI*k/l_nc;
+        p_pplan->m_ptw[k] = cos( l_a ) + I*sin( l_a );
+    }
+    for(int k=0;k<l_nc;k++){
+        double l_a = -2.0*M_PI*k/p_n;
+        p_pplan->m_prtw[k] = cos( l_a ) + I*sin( l_a );
+    }
+    return 1;
+}
+
+void FFT_Plan_free( FFT_Plan *p_pplan )
+{
+    free( p_pplan->m_prev );
+    free( p_pplan->m_ptw );
+    free( p_pplan->m_prtw );
+    free( p_pplan->m_pwork );
+    p_pplan->m_prev = NULL;
+    p_pplan->m_ptw = NULL;
+    p_pplan->m_prtw = NULL;
+    p_pplan->m_pwork = NULL;
+}
+
+/*
+ * In place iterative decimation in time on bit reversed input.
+ * p_inverse conjugates the twiddle factors.
+ */
+static void FFT_complex( const FFT_Plan *p_pplan, float complex *p_pz,
+                         int p_inverse )
+{
+    int l_nc = p_pplan->m_nc;
+    for(int l_len=2;l_len<=l_nc;l_len<<=1){
+        int l_half = l_len/2;
+        int l_step = l_nc/l_len;
+        for(int i=0;i<l_nc;i+=l_len){
+            for(int k=0;k<l_half;k++){
+                float complex l_w = p_pplan->m_ptw[k*l_step];
+                if( p_inverse )
+                    l_w = conjf( l_w );
+                float complex l_t = l_w*p_pz[i+k+l_half];
+                p_pz[i+k+l_half] = p_pz[i+k] - l_t;
+                p_pz[i+k] += l_t;
+            }
+        }
+    }
+}
+
+void FFT_real_forward( const FFT_Plan *p_pplan, const float *p_px,
+                       float complex *p_pX )
+{
+    int l_nc = p_pplan->m_nc;
+    float complex *l_pz = p_pplan->m_pwork;
+    for(int m=0;m<l_nc;m++){
+        l_pz[p_pplan->m_prev[m]] = p_px[2*m] + I*p_px[2*m+1];
+    }
+    FFT_complex( p_pplan, l_pz, 0 );
+    p_pX[0] = crealf( l_pz[0] ) + cimagf( l_pz[0] );
+    p_pX[l_nc] = crealf( l_pz[0] ) - cimagf( l_pz[0] );
+    for(int k=1;k<l_nc;k++){
+        float complex l_a = l_pz[k];
+        float complex l_b = conjf( l_pz[l_nc-k] );
+        float complex l_e = 0.5f*(l_a + l_b);
+        float complex l_o = -0.5f*I*(l_a - l_b);
+        p_pX[k] = l_e + p_pplan->m_prtw[k]*l_o;
+    }
+}
+
+void FFT_real_inverse( const FFT_Plan *p_pplan, const float complex *p_pX,
+                       float *p_px )
+{
+    int l_nc = p_pplan->m_nc;
+    float complex *l_pz = p_pplan->m_pwork;
+    for(int k=0;k<l_nc;k++){
+        float complex l_a = p_pX[k];
+        float complex l_b = conjf( p_pX[l_nc-k] );
+        float complex l_e = 0.5f*(l_a + l_b);
+        float complex l_o = 0.5f*(l_a - l_b)*conjf( p_pplan->m_prtw[k] );
+        l_pz[p_pplan->m_prev[k]] = l_e + I*l_o;
+    }
+    FFT_complex( p_pplan, l_pz, 1 );
+    for(int m=0;m<l_nc;m++){
+        p_px[2*m] = crealf( l_pz[m] );
+        p_px[2*m+1] = cimagf( l_pz[m] );
+    }
+}
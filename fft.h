@@ -0,0 +1,51 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <complex.h>
+
+/*
+ * Radix 2 FFT for real signals.
+ *
+ * A real sequence of length n is transformed through a complex FFT of
+ * length n/2 on the even/odd interleaved samples, giving the n/2+1
+ * non negative frequency bins. The inverse is unscaled and returns
+ * n/2 times the original sequence.
+ */
+
+typedef struct {
+    int            m_n;        // real length, power of 2, >= 4
+    int            m_nc;       // complex length n/2
+    unsigned int  *m_prev;     // bit reversal permutation, m_nc
+    float complex *m_ptw;      // e^(-j*2*pi*k/nc), m_nc/2
+    float complex *m_prtw;     // e^(-j*2*pi*k/n), m_nc
+    float complex *m_pwork;    // m_nc
+} FFT_Plan;
+
+int  FFT_Plan_init( FFT_Plan *p_pplan, int p_n );
+void FFT_Plan_free( FFT_Plan *p_pplan );
+void FFT_real_forward( const FFT_Plan *p_pplan, const float *p_px,
+                       float complex *p_pX );
+void FFT_real_inverse( const FFT_Plan *p_pplan, const float complex *p_pX,
+                       float *p_px );
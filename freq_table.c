@@ -0,0 +1,189 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "freq_table.h"
+#define _GNU_SOURCE
+#include <math.h>
+#include "fast_math.h"
+
+/*
+ * Table point i is at f[i] = FT_FMIN*2^(i/FT_PPO). The cutoff f is in
+ * the cell i = floor(FT_PPO*log2(f/FT_FMIN)) and each table value is
+ *
+ *   v[i] + (f - f[i])/(f[i+1] - f[i])*(v[i+1] - v[i])
+ *
+ * Interpolating in f rather than in log2(f) leaves only the curvature
+ * of tan() and of the section denominators as error. Cutoffs outside
+ * the table are clamped to its ends.
+ *
+ * Second order section, g = w0*t
+ *
+ *   h  = 1/(1 + 2*R*g + g^2)                       (table)
+ *   hp = (x - (2*R + g)*s1 - s2)*h
+ *   bp = g*hp + s1,  s1 = bp + g*hp
+ *   lp = g*bp + s2,  s2 = lp + g*bp
+ *   y  = n2*hp + n1/w0*bp + n0/w0^2*lp
+ *
+ * First order section, g = t
+ *
+ *   h  = g/(1 + g)                                 (table)
+ *   v  = (x - s1)*h
+ *   lp = v + s1,  s1 = lp + v
+ *   y  = n1*(x - lp) + n0*lp
+ */
+
+void FT_Filter_init( FT_Filter *p_pft, LADSPA_Data p_sample_rate )
+{
+    double l_fmax = 0.49*p_sample_rate;
+    int l_npoints = (int)floor(FT_PPO*log2(l_fmax/FT_FMIN)) + 1;
+    if(l_npoints < 2)
+        l_npoints = 2;
+    if(l_npoints > FT_POINTS_MAX)
+        l_npoints = FT_POINTS_MAX;
+    p_pft->m_npoints = l_npoints;
+    p_pft->m_nsections = 0;
+    p_pft->m_sample_rate = p_sample_rate;
+    p_pft->m_gain = 1.0;
+    for(int i=0;i<l_npoints;i++){
+        p_pft->m_f[i] = FT_FMIN*exp2((double)i/FT_PPO);
+        p_pft->m_t[i] = tan(M_PI*p_pft->m_f[i]/p_sample_rate);
+    }
+    for(int i=0;i<l_npoints-1;i++){
+        p_pft->m_rdf[i] = 1.0/(p_pft->m_f[i+1] - p_pft->m_f[i]);
+    }
+    p_pft->m_rdf[l_npoints-1] = 0.0;
+    FT_Filter_reset(p_pft);
+}
+
+void FT_Filter_reset( FT_Filter *p_pft )
+{
+    for(int s=0;s<FT_SECTIONS_MAX;s++){
+        p_pft->m_s1[s] = 0.0;
+        p_pft->m_s2[s] = 0.0;
+    }
+}
+
+void FT_Filter_design( FT_Filter *p_pft, const FT_Section *p_psections,
+                       int p_nsections, double p_gain )
+{
+    if(p_nsections > FT_SECTIONS_MAX)
+        p_nsections = FT_SECTIONS_MAX;
+    for(int s=0;s<p_nsections;s++){
+        const FT_Section *l_psec = &p_psections[s];
+        for(int i=0;i<p_pft->m_npoints;i++){
+            double l_t = p_pft->m_t[i];
+            if(l_psec->m_order == 1){
+                p_pft->m_h[i][s] = l_t/(1.0 + l_t);
+            } else {
+                double l_g = l_psec->m_w0*l_t;
+                p_pft->m_h[i][s] = 1.0/(1.0 + 2.0*l_psec->m_R*l_g + l_g*l_g);
+            }
+        }
+        if(s >= p_pft->m_nsections ||
+           l_psec->m_order != p_pft->m_sections[s].m_order){
+            // sections coming online start from rest
+            p_pft->m_s1[s] = 0.0;
+            p_pft->m_s2[s] = 0.0;
+        }
+        p_pft->m_sections[s] = *l_psec;
+    }
+    p_pft->m_nsections = p_nsections;
+    p_pft->m_gain = p_gain;
+}
+
+void FT_Filter_run( FT_Filter *p_pft, LADSPA_Data *p_psrc,
+                    LADSPA_Data *p_pfrequency, LADSPA_Data *p_pdst,
+                    unsigned long p_nsamples )
+{
+    const float l_log2fmin = log2f(FT_FMIN);
+    const float l_xmax = (float)(p_pft->m_npoints - 1);
+    const int l_nsections = p_pft->m_nsections;
+    const double l_gain = p_pft->m_gain;
+    const FT_Section *l_psec = p_pft->m_sections;
+    double *l_ps1 = p_pft->m_s1;
+    double *l_ps2 = p_pft->m_s2;
+
+    // output weights of the state variable outputs
+    double l_chp[FT_SECTIONS_MAX], l_cbp[FT_SECTIONS_MAX];
+    double l_clp[FT_SECTIONS_MAX];
+    for(int s=0;s<l_nsections;s++){
+        if(l_psec[s].m_order == 1){
+            l_chp[s] = l_psec[s].m_n1;
+            l_cbp[s] = 0.0;
+            l_clp[s] = l_psec[s].m_n0;
+        } else {
+            double l_w0 = l_psec[s].m_w0;
+            l_chp[s] = l_psec[s].m_n2;
+            l_cbp[s] = l_psec[s].m_n1/l_w0;
+            l_clp[s] = l_psec[s].m_n0/(l_w0*l_w0);
+        }
+    }
+
+    for(unsigned long n=0;n<p_nsamples;n++){
+        float l_f = p_pfrequency[n];
+        // FM_log2f needs f > 0, this also maps NaN to the bottom cell
+        float l_fc = l_f > FT_FMIN ? l_f : FT_FMIN;
+        float l_x = FT_PPO*(FM_log2f(l_fc) - l_log2fmin);
+        int l_i;
+        double l_frac;
+        if(!(l_x > 0.0f)){
+            l_i = 0;
+            l_frac = 0.0;
+        } else if(l_x >= l_xmax){
+            l_i = p_pft->m_npoints - 2;
+            l_frac = 1.0;
+        } else {
+            l_i = (int)l_x;
+            l_frac = (l_f - p_pft->m_f[l_i])*p_pft->m_rdf[l_i];
+        }
+        const double *l_ph0 = p_pft->m_h[l_i];
+        const double *l_ph1 = p_pft->m_h[l_i+1];
+        double l_t = p_pft->m_t[l_i] +
+                     l_frac*(p_pft->m_t[l_i+1] - p_pft->m_t[l_i]);
+
+        double l_a = p_psrc[n];
+        for(int s=0;s<l_nsections;s++){
+            double l_h = l_ph0[s] + l_frac*(l_ph1[s] - l_ph0[s]);
+            if(l_psec[s].m_order == 1){
+                double l_v = (l_a - l_ps1[s])*l_h;
+                double l_lp = l_v + l_ps1[s];
+                l_ps1[s] = l_lp + l_v;
+                l_a = l_chp[s]*(l_a - l_lp) + l_clp[s]*l_lp;
+            } else {
+                double l_g = l_psec[s].m_w0*l_t;
+                double l_hp = (l_a - (2.0*l_psec[s].m_R + l_g)*l_ps1[s]
+                               - l_ps2[s])*l_h;
+                double l_v1 = l_g*l_hp;
+                double l_bp = l_v1 + l_ps1[s];
+                l_ps1[s] = l_bp + l_v1;
+                double l_v2 = l_g*l_bp;
+                double l_lp = l_v2 + l_ps2[s];
+                l_ps2[s] = l_lp + l_v2;
+                l_a = l_chp[s]*l_hp + l_cbp[s]*l_bp + l_clp[s]*l_lp;
+            }
+        }
+        p_pdst[n] = (LADSPA_Data)(l_a*l_gain);
+    }
+}
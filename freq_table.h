@@ -0,0 +1,85 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+
+/*
+ * Log frequency coefficient tables for audio rate cutoff modulation.
+ *
+ * The filter is a cascade of up to FT_SECTIONS_MAX analog sections
+ * normalized to a cutoff of 1 rad/s
+ *
+ *           n2*s^2 + n1*s + n0                  n1*s + n0
+ *  H(s) = ------------------------      or      H(s) = -----------
+ *          s^2 + 2*R*w0*s + w0^2                         s + 1
+ *
+ * each discretized as a topology preserving (trapezoidal) state
+ * variable filter, which gives the bilinear transform response and
+ * stays well behaved when the cutoff changes every sample.
+ *
+ * The per sample coefficients, t = tan(pi*fc/fs) and the section
+ * denominators, are computed once at FT_PPO points per octave from
+ * FT_FMIN up to just below Nyquist. The filter looks the cutoff up per
+ * sample and interpolates linearly in frequency between the
+ * neighbouring points, so
+ * a cutoff that changes every sample costs a log2 and a few multiply
+ * adds per section instead of a tan and a divide per section.
+ */
+
+#define FT_PPO 32
+#define FT_FMIN 10.0f
+#define FT_POINTS_MAX 512
+#define FT_SECTIONS_MAX 6
+
+typedef struct {
+    int    m_order;
+    double m_w0;
+    double m_R;
+    double m_n2;
+    double m_n1;
+    double m_n0;
+} FT_Section;
+
+typedef struct {
+    int         m_npoints;
+    int         m_nsections;
+    LADSPA_Data m_sample_rate;
+    double      m_gain;
+    FT_Section  m_sections[FT_SECTIONS_MAX];
+    double      m_s1[FT_SECTIONS_MAX];
+    double      m_s2[FT_SECTIONS_MAX];
+    double      m_f[FT_POINTS_MAX];
+    double      m_rdf[FT_POINTS_MAX];
+    double      m_t[FT_POINTS_MAX];
+    double      m_h[FT_POINTS_MAX][FT_SECTIONS_MAX];
+} FT_Filter;
+
+void FT_Filter_init( FT_Filter *p_pft, LADSPA_Data p_sample_rate );
+void FT_Filter_reset( FT_Filter *p_pft );
+void FT_Filter_design( FT_Filter *p_pft, const FT_Section *p_psections,
+                       int p_nsections, double p_gain );
+void FT_Filter_run( FT_Filter *p_pft, LADSPA_Data *p_psrc,
+                    LADSPA_Data *p_pfrequency, LADSPA_Data *p_pdst,
+                    unsigned long p_nsamples );
@@ -0,0 +1,152 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "lfo.h"
+#include <math.h>
+#include "fast_math.h"
+
+#define LFO_2PI 6.28318531f
+
+void LFO_reset( LFO *p_lfo )
+{
+    p_lfo->m_phase = 0.0f;
+    p_lfo->m_cycle = 0;
+}
+
+/*
+ * floorf without the libm call, so the loops vectorize.
+ */
+static inline float LFO_floor( float x )
+{
+    float l_t = (float)(int)x;
+    return l_t > x ? l_t - 1.0f : l_t;
+}
+
+static void LFO_sine( float p_r, float p_dphase, LADSPA_Data *p_pdst, unsigned long p_n )
+{
+    float l_s[LFO_LANES];
+    float l_c[LFO_LANES];
+    for(int k=0;k<LFO_LANES;k++){
+        float l_x = LFO_2PI*(p_r + k*p_dphase);
+        l_s[k] = FM_sinf( l_x );
+        l_c[k] = FM_cosf( l_x );
+    }
+    float l_step = LFO_LANES*p_dphase;
+    l_step = LFO_2PI*(l_step - LFO_floor( l_step ));
+    float l_sin = FM_sinf( l_step );
+    float l_cos = FM_cosf( l_step );
+    unsigned long i;
+    for(i=0;i+LFO_LANES<=p_n;i+=LFO_LANES){
+        float l_s1[LFO_LANES];
+        for(int k=0;k<LFO_LANES;k++){
+            p_pdst[i+k] = l_s[k];
+            l_s1[k] = l_s[k]*l_cos + l_c[k]*l_sin;
+            l_c[k] = l_c[k]*l_cos - l_s[k]*l_sin;
+        }
+        for(int k=0;k<LFO_LANES;k++)
+            l_s[k] = l_s1[k];
+    }
+    for(int k=0;i<p_n;i++,k++)
+        p_pdst[i] = l_s[k];
+}
+
+static void LFO_triangle( float p_r, float p_dphase, LADSPA_Data *p_pdst, unsigned long p_n )
+{
+    // a quarter cycle on, the peak at 1/2
+    p_r += 0.25f;
+    for(int i=0;i<(int)p_n;i++){
+        float l_x = p_r + i*p_dphase;
+        l_x -= LFO_floor( l_x );
+        p_pdst[i] = 1.0f - 4.0f*fabsf( l_x - 0.5f );
+    }
+}
+
+static void LFO_sample_hold(
+    float p_r,
+    unsigned int p_cycle,
+    float p_dphase,
+    LADSPA_Data *p_pdst,
+    unsigned long p_n )
+{
+    for(int i=0;i<(int)p_n;i++){
+        // integer hash of the cycle count, to [-1, 1)
+        unsigned int h = p_cycle + (unsigned int)(int)LFO_floor( p_r + i*p_dphase );
+        h ^= h >> 16;
+        h *= 0x7feb352dU;
+        h ^= h >> 15;
+        h *= 0x846ca68bU;
+        h ^= h >> 16;
+        p_pdst[i] = (float)(int)h*(1.0f/2147483648.0f);
+    }
+}
+
+void LFO_generate(
+    const LFO *p_lfo,
+    int p_shape,
+    float p_dphase,
+    float p_offset,
+    LADSPA_Data *p_pdst,
+    unsigned long p_n )
+{
+    p_offset -= LFO_floor( p_offset );
+    float l_r = p_lfo->m_phase + p_offset;
+    float l_whole = LFO_floor( l_r );
+    // the offset, to 1/65536 cycle, moves the sample and hold sequence
+    unsigned int l_cycle = p_lfo->m_cycle + (unsigned int)(int)l_whole
+                           + (unsigned int)(p_offset*65536.0f)*0x9e3779b9U;
+    l_r -= l_whole;
+    while( p_n ){
+        unsigned long l_n = p_n < LFO_BLOCK ? p_n : LFO_BLOCK;
+        switch( p_shape ){
+        case LFO_TRIANGLE:
+            LFO_triangle( l_r, p_dphase, p_pdst, l_n );
+            break;
+        case LFO_SAMPLE_HOLD:
+            LFO_sample_hold( l_r, l_cycle, p_dphase, p_pdst, l_n );
+            break;
+        default:
+            LFO_sine( l_r, p_dphase, p_pdst, l_n );
+            break;
+        }
+        l_r += l_n*p_dphase;
+        l_whole = LFO_floor( l_r );
+        l_cycle += (unsigned int)(int)l_whole;
+        l_r -= l_whole;
+        p_pdst += l_n;
+        p_n -= l_n;
+    }
+}
+
+void LFO_advance( LFO *p_lfo, float p_dphase, unsigned long p_n )
+{
+    while( p_n ){
+        unsigned long l_n = p_n < LFO_BLOCK ? p_n : LFO_BLOCK;
+        float l_r = p_lfo->m_phase + l_n*p_dphase;
+        float l_whole = LFO_floor( l_r );
+        p_lfo->m_cycle += (unsigned int)(int)l_whole;
+        p_lfo->m_phase = l_r - l_whole;
+        p_n -= l_n;
+    }
+}
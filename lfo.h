@@ -0,0 +1,100 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+
+/*
+ * Low frequency oscillator for the modulation plugins.
+ *
+ * The phase is kept in cycles, 0 <= m_phase < 1, with the whole
+ * cycles counted in m_cycle. LFO_generate fills a buffer from the
+ * phase without moving it, at p_offset cycles ahead, so one LFO can
+ * drive the channels of a stereo effect at different phases.
+ * LFO_advance then moves it on by the block. All shapes run from
+ * -1 to 1 and start at 0 rising, like sin(2*pi*phase).
+ *
+ *   LFO_SINE          a rotating unit vector, see below
+ *   LFO_TRIANGLE      from the phase, peaks at 1/4 and 3/4 cycle
+ *   LFO_SAMPLE_HOLD   one value per cycle, a hash of the cycle
+ *                     count and the offset, so each offset has a
+ *                     sequence of its own
+ *
+ * The sine rotates LFO_LANES vectors (cos, sin) one lane apart by
+ * LFO_LANES steps at a time, two multiplies and an add per output and
+ * lane, across the lanes of a vector. They are seeded with FM_sinf
+ * and FM_cosf every LFO_BLOCK samples, the renormalization, so the
+ * rounding of the rotation does not build up: the output is within
+ * 2e-6 of sin(2*pi*phase).
+ */
+
+#define LFO_LANES 8
+#define LFO_BLOCK 256
+
+enum {
+    LFO_SINE,
+    LFO_TRIANGLE,
+    LFO_SAMPLE_HOLD,
+    LFO_NSHAPES
+};
+
+typedef struct {
+    float        m_phase;
+    unsigned int m_cycle;
+} LFO;
+
+void LFO_reset( LFO *p_lfo );
+void LFO_generate(
+    const LFO *p_lfo,
+    int p_shape,
+    float p_dphase,
+    float p_offset,
+    LADSPA_Data *p_pdst,
+    unsigned long p_n );
+void LFO_advance( LFO *p_lfo, float p_dphase, unsigned long p_n );
+
+/*
+ * The shape from a control port, rounded and kept in range.
+ */
+static inline int LFO_shape( LADSPA_Data p_port )
+{
+    int l_shape = (int)(p_port + 0.5f);
+    if( l_shape < 0 ) l_shape = 0;
+    if( l_shape >= LFO_NSHAPES ) l_shape = LFO_NSHAPES - 1;
+    return l_shape;
+}
+
+/*
+ * LFO_generate and LFO_advance for one output.
+ */
+static inline void LFO_run(
+    LFO *p_lfo,
+    int p_shape,
+    float p_dphase,
+    LADSPA_Data *p_pdst,
+    unsigned long p_n )
+{
+    LFO_generate( p_lfo, p_shape, p_dphase, 0.0f, p_pdst, p_n );
+    LFO_advance( p_lfo, p_dphase, p_n );
+}
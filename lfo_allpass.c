@@ -24,10 +24,12 @@ Contact: tim.krause@twkrause.ca
 
 */
 #include <fad.h>
+#include "delay_ring.h"
 #include <ladspa.h>
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "lfo.h"
 
 #define DELAY_MAX 10.0f
 
@@ -39,6 +41,8 @@ enum {
 	PORT_FEEDBACK,
 	PORT_LFO_FREQUENCY,
 	PORT_LFO_AMOUNT,
+	PORT_LFO_SHAPE,
+	PORT_COMPACT,
 	PORT_NPORTS
 };
 
@@ -46,12 +50,22 @@ typedef struct
 {
 	unsigned long m_sample_rate;
 	LADSPA_Data *m_pport[PORT_NPORTS];
-	float      *m_pdata;
-	long  m_Nbuf;
+	Delay_Ring m_ring;
 	long  m_write_index;
-	float m_lfo_theta;
+	LFO   m_lfo;
 } LFOAllPass;
 
+/*
+ * Ring samples for delays up to p_delay samples, run() keeps the delay
+ * at least FadNwindow()/2 and the sine LFO can overshoot 1 by 2e-6.
+ */
+static long LFOAllPass_Nring( float p_delay )
+{
+	if( p_delay < FadNwindow()/2 )
+		p_delay = FadNwindow()/2;
+	return (long)ceilf(p_delay*1.0001f) + FadNwindow();
+}
+
 static LADSPA_Handle LFOAllPass_instantiate(
 	const struct _LADSPA_Descriptor *p_pDescriptor,
 	unsigned long p_sample_rate )
@@ -61,13 +75,16 @@ static LADSPA_Handle LFOAllPass_instantiate(
 		return NULL;
 
 	l_pLFOAllPass->m_sample_rate = p_sample_rate;
-	l_pLFOAllPass->m_Nbuf = (long)(p_sample_rate*DELAY_MAX*2) + FadNwindow();
 	l_pLFOAllPass->m_write_index = 0;
-	l_pLFOAllPass->m_lfo_theta=0.0;
+	LFO_reset( &l_pLFOAllPass->m_lfo );
+	int i;
+	for(i=0;i<PORT_NPORTS;i++)
+		l_pLFOAllPass->m_pport[i] = NULL;
 
-	l_pLFOAllPass->m_pdata = malloc( sizeof(float) * l_pLFOAllPass->m_Nbuf );
-	
-	if( l_pLFOAllPass->m_pdata == NULL ) {
+	// the LFO can double the delay
+	if( !Delay_Ring_init( &l_pLFOAllPass->m_ring,
+			LFOAllPass_Nring( Delay_Ring_hint()*p_sample_rate*2 ),
+			LFOAllPass_Nring( p_sample_rate*DELAY_MAX*2 ) ) ) {
 		free( l_pLFOAllPass );
 		return NULL;
 	}
@@ -87,12 +104,16 @@ static void LFOAllPass_connect_port(
 static void LFOAllPass_activate( LADSPA_Handle p_instance )
 {
 	LFOAllPass* l_pLFOAllPass = (LFOAllPass*)p_instance;
-	l_pLFOAllPass->m_lfo_theta=0.0;
+	LFO_reset( &l_pLFOAllPass->m_lfo );
 	l_pLFOAllPass->m_write_index = 0;
-	long i;
-	for(i=0;i<l_pLFOAllPass->m_Nbuf;i++){
-		l_pLFOAllPass->m_pdata[i]=0.0;
-	}
+	// size the ring for the delay and LFO set now, when connected
+	long l_N = 0;
+	if( l_pLFOAllPass->m_pport[PORT_DELAY] && l_pLFOAllPass->m_pport[PORT_LFO_AMOUNT] )
+		l_N = LFOAllPass_Nring( *l_pLFOAllPass->m_pport[PORT_DELAY] * l_pLFOAllPass->m_sample_rate
+			* (1.0f + fabsf( *l_pLFOAllPass->m_pport[PORT_LFO_AMOUNT] )) );
+	// the storage follows the port at activate only
+	int l_compact = l_pLFOAllPass->m_pport[PORT_COMPACT] && *l_pLFOAllPass->m_pport[PORT_COMPACT] > 0.0f;
+	Delay_Ring_reset( &l_pLFOAllPass->m_ring, l_N, l_compact );
 }
 
 static void LFOAllPass_run( LADSPA_Handle p_instance, unsigned long p_sample_count )
@@ -101,34 +122,48 @@ static void LFOAllPass_run( LADSPA_Handle p_instance, unsigned long p_sample_cou
 	LADSPA_Data *l_psrc = l_pLFOAllPass->m_pport[PORT_IN];
 	LADSPA_Data *l_pdst = l_pLFOAllPass->m_pport[PORT_OUT];
 	long l_sample;
-    float l_dtheta = 2.0f * M_PIf * *l_pLFOAllPass->m_pport[PORT_LFO_FREQUENCY] / l_pLFOAllPass->m_sample_rate;
+	float l_dphase = *l_pLFOAllPass->m_pport[PORT_LFO_FREQUENCY] / l_pLFOAllPass->m_sample_rate;
+	int l_shape = LFO_shape( *l_pLFOAllPass->m_pport[PORT_LFO_SHAPE] );
+	float l_lfo[LFO_BLOCK];
 	float l_g = *l_pLFOAllPass->m_pport[PORT_FEEDBACK];
+
+	// past the ring the delay waits at its end for the worker to grow it
+	Delay_Ring_grow( &l_pLFOAllPass->m_ring,
+		LFOAllPass_Nring( *l_pLFOAllPass->m_pport[PORT_DELAY] * l_pLFOAllPass->m_sample_rate
+			* (1.0f + fabsf( *l_pLFOAllPass->m_pport[PORT_LFO_AMOUNT] )) ),
+		l_pLFOAllPass->m_write_index );
+	float l_delay_max = (float)(l_pLFOAllPass->m_ring.m_Nbuf - FadNwindow());
 	
 	for( l_sample=0;l_sample<p_sample_count;l_sample++){
+		if( l_sample % LFO_BLOCK == 0 ){
+			unsigned long l_n = p_sample_count - l_sample;
+			LFO_run( &l_pLFOAllPass->m_lfo, l_shape, l_dphase, l_lfo, l_n < LFO_BLOCK ? l_n : LFO_BLOCK );
+		}
 		float  l_delay = *l_pLFOAllPass->m_pport[PORT_DELAY] * l_pLFOAllPass->m_sample_rate;
-		l_delay *= (1.0f + sinf( l_pLFOAllPass->m_lfo_theta ) * *l_pLFOAllPass->m_pport[PORT_LFO_AMOUNT]);
+		l_delay *= (1.0f + l_lfo[l_sample % LFO_BLOCK] * *l_pLFOAllPass->m_pport[PORT_LFO_AMOUNT]);
 		if(l_delay<FadNwindow()/2)l_delay=FadNwindow()/2;
+		if(l_delay>l_delay_max)l_delay=l_delay_max;
 		long l_delay_int = (long)ceilf(l_delay);
 		float l_delay_frac = l_delay_int - l_delay;
         long l_wet_index = l_pLFOAllPass->m_write_index - FadNwindow()/2 - 1 - l_delay_int;
-		if( l_wet_index < 0 )
-			l_wet_index += l_pLFOAllPass->m_Nbuf;
-		LADSPA_Data l_H = FadSample( l_pLFOAllPass->m_pdata, l_wet_index, l_pLFOAllPass->m_Nbuf, l_delay_frac );
+		if( l_wet_index < 0 ){
+			l_wet_index += l_pLFOAllPass->m_ring.m_Nbuf;
+			Delay_Ring_clear( &l_pLFOAllPass->m_ring, l_wet_index );
+		}
+		LADSPA_Data l_H = Delay_Ring_sample( &l_pLFOAllPass->m_ring, l_wet_index, l_delay_frac );
 		LADSPA_Data l_m = *l_psrc + l_H*l_g;
 		if(l_m>1.0f)l_m=1.0f;
 		if(l_m<-1.0f)l_m=-1.0f;
 		*l_pdst = l_H - l_m*l_g;
 		// write the incoming data to the cyclic buffer
-		l_pLFOAllPass->m_pdata[l_pLFOAllPass->m_write_index] = l_m;
+		Delay_Ring_put( &l_pLFOAllPass->m_ring, l_pLFOAllPass->m_write_index, l_m );
+		Delay_Ring_wrote( &l_pLFOAllPass->m_ring, 1 );
 		// update the pointers and write index
 		l_psrc++;
 		l_pdst++;
 		l_pLFOAllPass->m_write_index++;
-		if( l_pLFOAllPass->m_write_index == l_pLFOAllPass->m_Nbuf )
+		if( l_pLFOAllPass->m_write_index == l_pLFOAllPass->m_ring.m_Nbuf )
 			l_pLFOAllPass->m_write_index = 0;
-		l_pLFOAllPass->m_lfo_theta += l_dtheta;
-        if( l_pLFOAllPass->m_lfo_theta >= 2.0f*M_PIf )
-            l_pLFOAllPass->m_lfo_theta -= 2.0f*M_PIf;
 	}
 }
 
@@ -136,7 +171,7 @@ static void LFOAllPass_cleanup( LADSPA_Handle p_instance )
 {
 	LFOAllPass* l_pLFOAllPass = (LFOAllPass*)p_instance;
 	
-	free( l_pLFOAllPass->m_pdata );
+	Delay_Ring_free( &l_pLFOAllPass->m_ring );
 	free( l_pLFOAllPass );
 }
 
@@ -147,6 +182,8 @@ static LADSPA_PortDescriptor LFOAllPass_PortDescriptors[]=
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
 };
 
@@ -157,7 +194,9 @@ static const char* LFOAllPass_PortNames[]=
 	"Delay",
 	"Feedback",
 	"LFO Frequency",
-	"LFO Amount"
+	"LFO Amount",
+	"LFO Shape",
+	"Compact storage(on activate)"
 };
 
 static LADSPA_PortRangeHint LFOAllPass_PortRangeHints[]=
@@ -184,6 +223,16 @@ static LADSPA_PortRangeHint LFOAllPass_PortRangeHints[]=
 		LADSPA_HINT_BOUNDED_ABOVE |
 		LADSPA_HINT_DEFAULT_LOW,
 		0.0,1.0
+	},
+	{ LADSPA_HINT_BOUNDED_BELOW |
+		LADSPA_HINT_BOUNDED_ABOVE |
+		LADSPA_HINT_INTEGER |
+		LADSPA_HINT_DEFAULT_MINIMUM,
+		0.0, LFO_NSHAPES - 1
+	},
+	{ LADSPA_HINT_TOGGLED |
+		LADSPA_HINT_DEFAULT_0,
+		0.0, 0.0
 	}
 };
 
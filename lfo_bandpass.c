@@ -30,19 +30,18 @@ Contact: tim.krause@twkrause.ca
  * fs = sampling frequency
  * B = bandwidth
  * 
- *                        1 - R*z^-2
- * H(z) = (1-R)-----------------------------------
- *              1 - 2*R*cos(theta)*z^-1 + R^2*z^-2
+ * Zero delay feedback state variable band pass, unity gain at fc,
+ * see svf.h
  * 
- * theta = 2*pi*fc/fs
- * R = exp(-pi*B/fs)
- * G = 1-R
+ * b = pi*B/fs
  */
 
 #include <ladspa.h>
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "svf.h"
+#include "lfo.h"
 
 enum {
 	PORT_IN,
@@ -52,6 +51,7 @@ enum {
 	PORT_GAIN,
 	PORT_LFO_FREQUENCY,
 	PORT_LFO_AMOUNT,
+	PORT_LFO_SHAPE,
 	PORT_NPORTS
 };
 
@@ -59,9 +59,8 @@ typedef struct
 {
 	unsigned long m_sample_rate;
 	LADSPA_Data *m_pport[PORT_NPORTS];
-	LADSPA_Data m_z1;
-	LADSPA_Data m_z2;
-	LADSPA_Data m_lfo_theta;
+	SVF_State m_svf;
+	LFO m_lfo;
 } Bandpass_Data;
 
 static LADSPA_Handle Bandpass_instantiate(
@@ -71,9 +70,8 @@ static LADSPA_Handle Bandpass_instantiate(
 	Bandpass_Data *l_pBandpass = malloc( sizeof(Bandpass_Data) );
 	if( l_pBandpass ){
 		l_pBandpass->m_sample_rate = p_sample_rate;
-		l_pBandpass->m_z1 = 0.0;
-		l_pBandpass->m_z2 = 0.0;
-		l_pBandpass->m_lfo_theta = 0.0;
+		SVF_init(&l_pBandpass->m_svf);
+		LFO_reset( &l_pBandpass->m_lfo );
 	}
 	return (LADSPA_Handle)l_pBandpass;
 }
@@ -93,29 +91,31 @@ static void Bandpass_run(
 {
 	Bandpass_Data *l_pBandpass = (Bandpass_Data*)p_pInstance;
 	
-	LADSPA_Data l_R = expf(-M_PI * *l_pBandpass->m_pport[PORT_BANDWIDTH] / l_pBandpass->m_sample_rate );
-	LADSPA_Data l_G = 1 - l_R;
-	l_G *= exp10f( *l_pBandpass->m_pport[PORT_GAIN] / 20 );
-	LADSPA_Data l_a2 = l_R*l_R;
-	LADSPA_Data l_lfo_dtheta = 2 * M_PI * *l_pBandpass->m_pport[PORT_LFO_FREQUENCY] / l_pBandpass->m_sample_rate;
+	LADSPA_Data l_b = M_PI * *l_pBandpass->m_pport[PORT_BANDWIDTH] / l_pBandpass->m_sample_rate;
+	LADSPA_Data l_G = exp10f( *l_pBandpass->m_pport[PORT_GAIN] / 20 );
+	LADSPA_Data l_rfs = 1.0f / l_pBandpass->m_sample_rate;
+	LADSPA_Data l_lfo_dphase = *l_pBandpass->m_pport[PORT_LFO_FREQUENCY] / l_pBandpass->m_sample_rate;
+	int l_lfo_shape = LFO_shape( *l_pBandpass->m_pport[PORT_LFO_SHAPE] );
 	
 	unsigned long l_sample;
 	LADSPA_Data *l_psrc = l_pBandpass->m_pport[PORT_IN];
 	LADSPA_Data *l_pdst = l_pBandpass->m_pport[PORT_OUT];
+	LADSPA_Data l_lfo[SVF_CHUNK];
+	LADSPA_Data l_fn[SVF_CHUNK];
+	SVF_Coeffs l_coeffs;
 	
-	for( l_sample = 0; l_sample < p_sample_count; l_sample++ ){
-		LADSPA_Data l_frequency = *l_pBandpass->m_pport[PORT_FREQUENCY] + (0.5+0.5*sinf(l_pBandpass->m_lfo_theta)) * *l_pBandpass->m_pport[PORT_LFO_AMOUNT];
-		LADSPA_Data l_theta = 2 * M_PI * l_frequency / l_pBandpass->m_sample_rate;
-		LADSPA_Data l_a1 = -2 * l_R * cosf(l_theta);
-		LADSPA_Data m = *l_psrc - l_a1*l_pBandpass->m_z1 - l_a2*l_pBandpass->m_z2;
-		*l_pdst = l_G*(m - l_R*l_pBandpass->m_z2);
-		l_pBandpass->m_z2 = l_pBandpass->m_z1;
-		l_pBandpass->m_z1 = m;
-		l_psrc++;
-		l_pdst++;
-		l_pBandpass->m_lfo_theta += l_lfo_dtheta;
-		if( l_pBandpass->m_lfo_theta >= 2*M_PI )
-			l_pBandpass->m_lfo_theta -= 2*M_PI;
+	while( p_sample_count ){
+		unsigned long l_n = p_sample_count < SVF_CHUNK ? p_sample_count : SVF_CHUNK;
+		LFO_run( &l_pBandpass->m_lfo, l_lfo_shape, l_lfo_dphase, l_lfo, l_n );
+		for( l_sample = 0; l_sample < l_n; l_sample++ ){
+			LADSPA_Data l_frequency = *l_pBandpass->m_pport[PORT_FREQUENCY] + (0.5f+0.5f*l_lfo[l_sample]) * *l_pBandpass->m_pport[PORT_LFO_AMOUNT];
+			l_fn[l_sample] = SVF_fn( l_frequency, l_rfs );
+		}
+		SVF_bandpass_coeffs( &l_coeffs, l_fn, l_b, l_n );
+		SVF_bandpass( &l_pBandpass->m_svf, &l_coeffs, l_psrc, l_pdst, l_G, l_n );
+		l_psrc += l_n;
+		l_pdst += l_n;
+		p_sample_count -= l_n;
 	}
 }
 
@@ -132,6 +132,7 @@ static LADSPA_PortDescriptor Bandpass_PortDescriptors[]=
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL
 };
 
@@ -143,7 +144,8 @@ static const char* Bandpass_PortNames[]=
 	"Bandwidth",
 	"Gain",
 	"LFO frequency",
-	"LFO amount"
+	"LFO amount",
+	"LFO shape"
 };
 
 static LADSPA_PortRangeHint Bandpass_PortRangeHints[]=
@@ -175,6 +177,12 @@ static LADSPA_PortRangeHint Bandpass_PortRangeHints[]=
 		LADSPA_HINT_BOUNDED_ABOVE|
 		LADSPA_HINT_DEFAULT_LOW,
 		0,5000
+	},
+	{ LADSPA_HINT_BOUNDED_BELOW|
+		LADSPA_HINT_BOUNDED_ABOVE|
+		LADSPA_HINT_INTEGER|
+		LADSPA_HINT_DEFAULT_MINIMUM,
+		0,LFO_NSHAPES-1
 	}
 };
 
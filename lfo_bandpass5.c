@@ -30,19 +30,18 @@ Contact: tim.krause@twkrause.ca
  * fs = sampling frequency
  * B = bandwidth
  * 
- *                        1 - R*z^-2
- * H(z) = (1-R)-----------------------------------
- *              1 - 2*R*cos(theta)*z^-1 + R^2*z^-2
+ * Zero delay feedback state variable band pass, unity gain at fc,
+ * see svf.h
  * 
- * theta = 2*pi*fc/fs
- * R = exp(-pi*B/fs)
- * G = 1-R
+ * b = pi*B/fs
  */
 
 #include <ladspa.h>
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "svf.h"
+#include "lfo.h"
 
 enum {
 	PORT_IN,
@@ -78,6 +77,8 @@ enum {
 	PORT_LFO_FREQUENCY5,
 	PORT_LFO_AMOUNT5,
 
+	PORT_LFO_SHAPE,
+
 	PORT_NPORTS
 
 };
@@ -93,14 +94,12 @@ typedef struct
 
 typedef struct
 {
-	LADSPA_Data m_z1;
-	LADSPA_Data m_z2;
-    LADSPA_Data m_a1;
-    LADSPA_Data m_a2;
-    LADSPA_Data m_R;
+    SVF_State   m_svf;
+    LADSPA_Data m_b;
     LADSPA_Data m_G;
-	LADSPA_Data m_lfo_theta;
-    LADSPA_Data m_lfo_dtheta;
+    LFO         m_lfo;
+    LADSPA_Data m_lfo_dphase;
+    int         m_lfo_shape;
     Bandpass_Port_Data *m_port_data;
 } Filter_Data;
 
@@ -113,38 +112,41 @@ typedef struct
 
 void static Filter_init(Filter_Data *filter, Bandpass_Port_Data *port_data)
 {
-    filter->m_z1 = 0.0f;
-    filter->m_z2 = 0.0f;
-    filter->m_lfo_theta = 0.0f;
+    SVF_init(&filter->m_svf);
+    LFO_reset(&filter->m_lfo);
     filter->m_port_data = port_data;
 }
 
-static void Filter_set(Filter_Data *filter, LADSPA_Data sample_rate)
+static void Filter_set(Filter_Data *filter, LADSPA_Data sample_rate, int lfo_shape)
 {
-    filter->m_R = expf(-M_PIf * *filter->m_port_data->m_bandwidth / sample_rate );
-    filter->m_G = 1.0f - filter->m_R;
-    filter->m_G *= exp10f( *filter->m_port_data->m_gain / 20.0f );
-    filter->m_a2 = filter->m_R*filter->m_R;
-    filter->m_lfo_dtheta = 2.0f * M_PIf * *filter->m_port_data->m_lfo_frequency / sample_rate;
+    filter->m_b = M_PIf * *filter->m_port_data->m_bandwidth / sample_rate;
+    filter->m_G = exp10f( *filter->m_port_data->m_gain / 20.0f );
+    filter->m_lfo_dphase = *filter->m_port_data->m_lfo_frequency / sample_rate;
+    filter->m_lfo_shape = lfo_shape;
 }
 
-static LADSPA_Data Filter_evaluate(
+/*
+ * Runs one filter over a chunk of at most SVF_CHUNK samples.
+ */
+static void Filter_run(
     Filter_Data *filter,
     LADSPA_Data sample_rate,
-    LADSPA_Data x)
+    const LADSPA_Data *src,
+    LADSPA_Data *dst,
+    unsigned long n)
 {
-    LADSPA_Data l_frequency = *filter->m_port_data->m_frequency +
-                              (0.5f+0.5f*sinf(filter->m_lfo_theta)) * *filter->m_port_data->m_lfo_amount;
-    LADSPA_Data l_theta = 2.0f * M_PIf * l_frequency / sample_rate;
-    filter->m_a1 = -2.0f * filter->m_R * cosf(l_theta);
-    LADSPA_Data m = x - filter->m_a1*filter->m_z1 - filter->m_a2*filter->m_z2;
-    LADSPA_Data y = filter->m_G*(m - filter->m_R*filter->m_z2);
-    filter->m_z2 = filter->m_z1;
-    filter->m_z1 = m;
-    filter->m_lfo_theta += filter->m_lfo_dtheta;
-    if( filter->m_lfo_theta >= 2.0f*M_PIf )
-        filter->m_lfo_theta -= 2.0f*M_PIf;
-    return y;
+    LADSPA_Data l_lfo[SVF_CHUNK];
+    LADSPA_Data l_fn[SVF_CHUNK];
+    SVF_Coeffs l_coeffs;
+    LADSPA_Data l_rfs = 1.0f/sample_rate;
+    LFO_run(&filter->m_lfo, filter->m_lfo_shape, filter->m_lfo_dphase, l_lfo, n);
+    for(unsigned long i=0;i<n;i++){
+        LADSPA_Data l_frequency = *filter->m_port_data->m_frequency +
+                                  (0.5f+0.5f*l_lfo[i]) * *filter->m_port_data->m_lfo_amount;
+        l_fn[i] = SVF_fn(l_frequency, l_rfs);
+    }
+    SVF_bandpass_coeffs(&l_coeffs, l_fn, filter->m_b, n);
+    SVF_bandpass(&filter->m_svf, &l_coeffs, src, dst, filter->m_G, n);
 }
 
 static LADSPA_Handle Bandpass_instantiate(
@@ -187,21 +189,31 @@ static void Bandpass_run(
 
     unsigned long l_filter;
 	Filter_Data *l_pFilter = l_pBandpass->m_filters;
+	int l_lfo_shape = LFO_shape( *l_pBandpass->m_pport[PORT_LFO_SHAPE] );
 	for( l_filter=0;l_filter<5;l_filter++){
-        Filter_set(l_pFilter, l_pBandpass->m_sample_rate);
+        Filter_set(l_pFilter, l_pBandpass->m_sample_rate, l_lfo_shape);
         l_pFilter++;
     }
 
-    for( l_sample = 0; l_sample < p_sample_count; l_sample++ ){
-        LADSPA_Data y = 0.0f;
+    // the input is copied, the output may share its buffer
+    LADSPA_Data l_in[SVF_CHUNK];
+    LADSPA_Data l_y[SVF_CHUNK];
+    while( p_sample_count ){
+        unsigned long l_n = p_sample_count < SVF_CHUNK ? p_sample_count : SVF_CHUNK;
+        for( l_sample = 0; l_sample < l_n; l_sample++ ){
+            l_in[l_sample] = l_psrc[l_sample];
+            l_pdst[l_sample] = 0.0f;
+        }
         l_pFilter = l_pBandpass->m_filters;
         for( l_filter=0;l_filter<5;l_filter++){
-            y += Filter_evaluate(l_pFilter, l_pBandpass->m_sample_rate, *l_psrc);
+            Filter_run(l_pFilter, l_pBandpass->m_sample_rate, l_in, l_y, l_n);
+            for( l_sample = 0; l_sample < l_n; l_sample++ )
+                l_pdst[l_sample] += l_y[l_sample];
             l_pFilter++;
         }
-        *l_pdst = y;
-        l_psrc++;
-        l_pdst++;
+        l_psrc += l_n;
+        l_pdst += l_n;
+        p_sample_count -= l_n;
     }
 }
 
@@ -243,8 +255,9 @@ static LADSPA_PortDescriptor Bandpass_PortDescriptors[]=
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
-	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL
 };
 
 static const char* Bandpass_PortNames[]=
@@ -275,7 +288,8 @@ static const char* Bandpass_PortNames[]=
 	"Bandwidth 5",
 	"Gain 5",
 	"LFO frequency 5",
-	"LFO amount 5"
+	"LFO amount 5",
+	"LFO shape"
 };
 
 static LADSPA_PortRangeHint Bandpass_PortRangeHints[]=
@@ -412,6 +426,12 @@ static LADSPA_PortRangeHint Bandpass_PortRangeHints[]=
 		LADSPA_HINT_DEFAULT_LOW,
 		0,5000
 	},
+	{ LADSPA_HINT_BOUNDED_BELOW|
+		LADSPA_HINT_BOUNDED_ABOVE|
+		LADSPA_HINT_INTEGER|
+		LADSPA_HINT_DEFAULT_MINIMUM,
+		0,LFO_NSHAPES-1
+	},
 };
 
 LADSPA_Descriptor LFOBandpass5_Descriptor=
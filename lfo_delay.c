@@ -24,10 +24,12 @@ Contact: tim.krause@twkrause.ca
 
 */
 #include <fad.h>
+#include "delay_ring.h"
 #include <ladspa.h>
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "lfo.h"
 
 #define DELAY_MAX 1.0f
 
@@ -41,6 +43,8 @@ enum {
 	PORT_FEEDBACK,
 	PORT_LFO_FREQUENCY,
 	PORT_LFO_AMOUNT,
+	PORT_LFO_SHAPE,
+	PORT_COMPACT,
 	PORT_NPORTS
 };
 
@@ -48,12 +52,20 @@ typedef struct
 {
 	unsigned long m_sample_rate;
 	LADSPA_Data *m_pport[PORT_NPORTS];
-	float      *m_pdata;
-	long  m_Nbuf;
+	Delay_Ring m_ring;
 	long  m_write_index;
-	float m_lfo_theta;
+	LFO   m_lfo;
 } LFODelay;
 
+/*
+ * Ring samples for delays up to p_delay samples, the sine LFO can
+ * overshoot 1 by 2e-6.
+ */
+static long LFODelay_Nring( float p_delay )
+{
+	return (long)ceilf(p_delay*1.0001f) + FadNwindow() + 2;
+}
+
 static LADSPA_Handle LFODelay_instantiate(
 	const struct _LADSPA_Descriptor *p_pDescriptor,
 	unsigned long p_sample_rate )
@@ -63,13 +75,16 @@ static LADSPA_Handle LFODelay_instantiate(
 		return NULL;
 
 	l_pLFODelay->m_sample_rate = p_sample_rate;
-	l_pLFODelay->m_Nbuf = (long)(p_sample_rate*DELAY_MAX*2) + FadNwindow() + 2;
 	l_pLFODelay->m_write_index = 0;
-	l_pLFODelay->m_lfo_theta=0.0;
+	LFO_reset( &l_pLFODelay->m_lfo );
+	int i;
+	for(i=0;i<PORT_NPORTS;i++)
+		l_pLFODelay->m_pport[i] = NULL;
 
-	l_pLFODelay->m_pdata = malloc( sizeof(float) * l_pLFODelay->m_Nbuf );
-	
-	if( l_pLFODelay->m_pdata == NULL ) {
+	// the LFO can double the delay
+	if( !Delay_Ring_init( &l_pLFODelay->m_ring,
+			LFODelay_Nring( Delay_Ring_hint()*p_sample_rate*2 ),
+			LFODelay_Nring( p_sample_rate*DELAY_MAX*2 ) ) ) {
 		free( l_pLFODelay );
 		return NULL;
 	}
@@ -89,12 +104,16 @@ static void LFODelay_connect_port(
 static void LFODelay_activate( LADSPA_Handle p_instance )
 {
 	LFODelay* l_pLFODelay = (LFODelay*)p_instance;
-	l_pLFODelay->m_lfo_theta=0.0;
+	LFO_reset( &l_pLFODelay->m_lfo );
 	l_pLFODelay->m_write_index = 0;
-	long i;
-	for(i=0;i<l_pLFODelay->m_Nbuf;i++){
-		l_pLFODelay->m_pdata[i]=0.0;
-	}
+	// size the ring for the delay and LFO set now, when connected
+	long l_N = 0;
+	if( l_pLFODelay->m_pport[PORT_DELAY] && l_pLFODelay->m_pport[PORT_LFO_AMOUNT] )
+		l_N = LFODelay_Nring( *l_pLFODelay->m_pport[PORT_DELAY] / 1000.0f * l_pLFODelay->m_sample_rate
+			* (1.0f + fabsf( *l_pLFODelay->m_pport[PORT_LFO_AMOUNT] )) );
+	// the storage follows the port at activate only
+	int l_compact = l_pLFODelay->m_pport[PORT_COMPACT] && *l_pLFODelay->m_pport[PORT_COMPACT] > 0.0f;
+	Delay_Ring_reset( &l_pLFODelay->m_ring, l_N, l_compact );
 }
 
 static void LFODelay_run( LADSPA_Handle p_instance, unsigned long p_sample_count )
@@ -103,45 +122,59 @@ static void LFODelay_run( LADSPA_Handle p_instance, unsigned long p_sample_count
 	LADSPA_Data *l_psrc = l_pLFODelay->m_pport[PORT_IN];
 	LADSPA_Data *l_pdst = l_pLFODelay->m_pport[PORT_OUT];
 	long l_sample;
-	float l_dtheta = 2.0 * M_PI * *l_pLFODelay->m_pport[PORT_LFO_FREQUENCY] / l_pLFODelay->m_sample_rate;
+	float l_dphase = *l_pLFODelay->m_pport[PORT_LFO_FREQUENCY] / l_pLFODelay->m_sample_rate;
+	int l_shape = LFO_shape( *l_pLFODelay->m_pport[PORT_LFO_SHAPE] );
+	float l_lfo[LFO_BLOCK];
 	float l_delay0 = *l_pLFODelay->m_pport[PORT_DELAY] / 1000.0f * l_pLFODelay->m_sample_rate;
 	float l_lfo_amount = *l_pLFODelay->m_pport[PORT_LFO_AMOUNT];
 	float l_wet_gain = *l_pLFODelay->m_pport[PORT_WET];
 	float l_dry_gain = *l_pLFODelay->m_pport[PORT_DRY];
 	float l_feedback = *l_pLFODelay->m_pport[PORT_FEEDBACK];
+
+	// past the ring the delay waits at its end for the worker to grow it
+	Delay_Ring_grow( &l_pLFODelay->m_ring, LFODelay_Nring( l_delay0*(1.0f + fabsf( l_lfo_amount )) ),
+		l_pLFODelay->m_write_index );
+	float l_delay_min = -(float)(l_pLFODelay->m_ring.m_Nbuf - FadNwindow() - 2);
 	
 	for( l_sample=0;l_sample<p_sample_count;l_sample++){
+		if( l_sample % LFO_BLOCK == 0 ){
+			unsigned long l_n = p_sample_count - l_sample;
+			LFO_run( &l_pLFODelay->m_lfo, l_shape, l_dphase, l_lfo, l_n < LFO_BLOCK ? l_n : LFO_BLOCK );
+		}
 		// write the incoming data to the cyclic buffer
-		l_pLFODelay->m_pdata[l_pLFODelay->m_write_index] = *l_psrc;
+		Delay_Ring_put( &l_pLFODelay->m_ring, l_pLFODelay->m_write_index, *l_psrc );
+		Delay_Ring_wrote( &l_pLFODelay->m_ring, 1 );
 		// calculate the start indicis and sample fractions
 		// for the dry and wet channels
         long l_dry_index = l_pLFODelay->m_write_index - (FadNwindow()/2) - 1;
-		if( l_dry_index < 0 )
-			l_dry_index += l_pLFODelay->m_Nbuf;
-		float l_dry = l_pLFODelay->m_pdata[l_dry_index];
-        float l_delay = -l_delay0*(1.0f + sinf( l_pLFODelay->m_lfo_theta ) * l_lfo_amount);
+		if( l_dry_index < 0 ){
+			l_dry_index += l_pLFODelay->m_ring.m_Nbuf;
+			Delay_Ring_clear( &l_pLFODelay->m_ring, l_dry_index );
+		}
+		float l_dry = Delay_Ring_dry( &l_pLFODelay->m_ring, *l_psrc );
+        float l_delay = -l_delay0*(1.0f + l_lfo[l_sample % LFO_BLOCK] * l_lfo_amount);
+		if( l_delay < l_delay_min ) l_delay = l_delay_min;
         long l_delay_int = (long)floorf(l_delay);
         float l_delay_frac = l_delay - l_delay_int;
         long l_wet_index = l_pLFODelay->m_write_index - FadNwindow() + l_delay_int;
-		if( l_wet_index < 0 )
-			l_wet_index += l_pLFODelay->m_Nbuf;
-        float l_wet = FadSample( l_pLFODelay->m_pdata, l_wet_index, l_pLFODelay->m_Nbuf, l_delay_frac );
+		if( l_wet_index < 0 ){
+			l_wet_index += l_pLFODelay->m_ring.m_Nbuf;
+			Delay_Ring_clear( &l_pLFODelay->m_ring, l_wet_index );
+		}
+        float l_wet = Delay_Ring_sample( &l_pLFODelay->m_ring, l_wet_index, l_delay_frac );
 
 		*l_pdst = l_wet*l_wet_gain + l_dry*l_dry_gain;
 		// perform the feedback
 		l_dry += l_wet*l_feedback;
 		if( l_dry > 1.0f ) l_dry = 1.0f;
 		if( l_dry <-1.0f ) l_dry =-1.0f;
-		l_pLFODelay->m_pdata[l_dry_index] = l_dry;
+		Delay_Ring_put( &l_pLFODelay->m_ring, l_dry_index, l_dry );
 		// update the pointers and write index
 		l_psrc++;
 		l_pdst++;
 		l_pLFODelay->m_write_index++;
-		if( l_pLFODelay->m_write_index == l_pLFODelay->m_Nbuf )
+		if( l_pLFODelay->m_write_index == l_pLFODelay->m_ring.m_Nbuf )
 			l_pLFODelay->m_write_index = 0;
-		l_pLFODelay->m_lfo_theta += l_dtheta;
-        if( l_pLFODelay->m_lfo_theta >= 2.0f*M_PIf )
-            l_pLFODelay->m_lfo_theta -= 2.0f*M_PIf;
 	}
 }
 
@@ -149,7 +182,7 @@ static void LFODelay_cleanup( LADSPA_Handle p_instance )
 {
 	LFODelay* l_pLFODelay = (LFODelay*)p_instance;
 	
-	free( l_pLFODelay->m_pdata );
+	Delay_Ring_free( &l_pLFODelay->m_ring );
 	free( l_pLFODelay );
 }
 
@@ -162,6 +195,8 @@ static LADSPA_PortDescriptor LFODelay_PortDescriptors[]=
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
 };
 
@@ -174,7 +209,9 @@ static const char* LFODelay_PortNames[]=
 	"Dry",
 	"Feedback",
 	"LFO Frequency(Hz)",
-	"LFO Amount"
+	"LFO Amount",
+	"LFO Shape",
+	"Compact storage(on activate)"
 };
 
 static LADSPA_PortRangeHint LFODelay_PortRangeHints[]=
@@ -211,6 +248,16 @@ static LADSPA_PortRangeHint LFODelay_PortRangeHints[]=
 		LADSPA_HINT_BOUNDED_ABOVE |
 		LADSPA_HINT_DEFAULT_LOW,
 		0.0,1.0
+	},
+	{ LADSPA_HINT_BOUNDED_BELOW |
+		LADSPA_HINT_BOUNDED_ABOVE |
+		LADSPA_HINT_INTEGER |
+		LADSPA_HINT_DEFAULT_MINIMUM,
+		0.0, LFO_NSHAPES - 1
+	},
+	{ LADSPA_HINT_TOGGLED |
+		LADSPA_HINT_DEFAULT_0,
+		0.0, 0.0
 	}
 };
 
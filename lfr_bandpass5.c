@@ -30,19 +30,17 @@ Contact: tim.krause@twkrause.ca
  * fs = sampling frequency
  * B = bandwidth
  * 
- *                        1 - R*z^-2
- * H(z) = (1-R)-----------------------------------
- *              1 - 2*R*cos(theta)*z^-1 + R^2*z^-2
+ * Zero delay feedback state variable band pass, unity gain at fc,
+ * see svf.h
  * 
- * theta = 2*pi*fc/fs
- * R = exp(-pi*B/fs)
- * G = 1-R
+ * b = pi*B/fs
  */
 
 #include <ladspa.h>
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "svf.h"
 
 #define RAND_FLOAT drand48()
 #define FREQUENCY_MIN 10.0f
@@ -106,11 +104,8 @@ typedef struct
 
 typedef struct
 {
-	LADSPA_Data m_z1;
-	LADSPA_Data m_z2;
-    LADSPA_Data m_a1;
-    LADSPA_Data m_a2;
-    LADSPA_Data m_R;
+    SVF_State   m_svf;
+    LADSPA_Data m_b;
     LADSPA_Data m_G;
     LADSPA_Data m_lfr_frequency;
     LADSPA_Data m_lfr_frequency1;
@@ -129,8 +124,7 @@ typedef struct
 
 static void Filter_init(Filter_Data *filter, Bandpass_Port_Data *port_data)
 {
-    filter->m_z1 = 0.0f;
-    filter->m_z2 = 0.0f;
+    SVF_init(&filter->m_svf);
     filter->m_lfr_frequency1 = 1000.0f;
     filter->m_lfr_sample = 0;
     filter->m_lfr_sample_count = 0;
@@ -139,40 +133,42 @@ static void Filter_init(Filter_Data *filter, Bandpass_Port_Data *port_data)
 
 static void Filter_set(Filter_Data *filter, LADSPA_Data sample_rate)
 {
-    filter->m_R = expf(-M_PIf * *filter->m_port_data->m_bandwidth / sample_rate );
-    filter->m_G = 1.0f - filter->m_R;
-    filter->m_G *= exp10f( *filter->m_port_data->m_gain / 20.0f );
-    filter->m_a2 = filter->m_R*filter->m_R;
+    filter->m_b = M_PIf * *filter->m_port_data->m_bandwidth / sample_rate;
+    filter->m_G = exp10f( *filter->m_port_data->m_gain / 20.0f );
 }
 
-static LADSPA_Data Filter_evaluate(Filter_Data *filter, Bandpass_Data *bp, LADSPA_Data x)
+/*
+ * Runs one filter over a chunk of at most SVF_CHUNK samples.
+ */
+static void Filter_run(Filter_Data *filter, Bandpass_Data *bp,
+                       const LADSPA_Data *src, LADSPA_Data *dst,
+                       unsigned long n)
 {
-
-    if( filter->m_lfr_sample == filter->m_lfr_sample_count ){
-        // reached the end of the last period
-        filter->m_lfr_frequency = filter->m_lfr_frequency1;
-        filter->m_lfr_frequency1 = *filter->m_port_data->m_frequency
-                                      + RAND_FLOAT * *filter->m_port_data->m_lfr_amount;
-        filter->m_lfr_sample_count =
-            (*bp->m_pport[PORT_PERIOD] +
-             RAND_FLOAT * *bp->m_pport[PORT_PERIOD_MOD])*
-            bp->m_sample_rate;
-        filter->m_lfr_sample = 0;
-        filter->m_lfr_dfrequency =
-            (filter->m_lfr_frequency1-filter->m_lfr_frequency)/filter->m_lfr_sample_count;
+    LADSPA_Data l_fn[SVF_CHUNK];
+    SVF_Coeffs l_coeffs;
+    LADSPA_Data l_rfs = 1.0f/bp->m_sample_rate;
+    for(unsigned long i=0;i<n;i++){
+        if( filter->m_lfr_sample == filter->m_lfr_sample_count ){
+            // reached the end of the last period
+            filter->m_lfr_frequency = filter->m_lfr_frequency1;
+            filter->m_lfr_frequency1 = *filter->m_port_data->m_frequency
+                                          + RAND_FLOAT * *filter->m_port_data->m_lfr_amount;
+            filter->m_lfr_sample_count =
+                (*bp->m_pport[PORT_PERIOD] +
+                 RAND_FLOAT * *bp->m_pport[PORT_PERIOD_MOD])*
+                bp->m_sample_rate;
+            filter->m_lfr_sample = 0;
+            filter->m_lfr_dfrequency =
+                (filter->m_lfr_frequency1-filter->m_lfr_frequency)/filter->m_lfr_sample_count;
+        }
+        l_fn[i] = SVF_fn(filter->m_lfr_frequency, l_rfs);
+        filter->m_lfr_frequency += filter->m_lfr_dfrequency;
+        filter->m_lfr_sample++;
     }
-    LADSPA_Data l_theta = 2.0f * M_PIf * filter->m_lfr_frequency / bp->m_sample_rate;
-    filter->m_a1 = -2.0f * filter->m_R * cosf(l_theta);
-    LADSPA_Data m = x - filter->m_a1*filter->m_z1 - filter->m_a2*filter->m_z2;
-    LADSPA_Data y = filter->m_G*(m - filter->m_R*filter->m_z2);
-    filter->m_z2 = filter->m_z1;
-    filter->m_z1 = m;
-    filter->m_lfr_frequency += filter->m_lfr_dfrequency;
-    filter->m_lfr_sample++;
-    return y;
+    SVF_bandpass_coeffs(&l_coeffs, l_fn, filter->m_b, n);
+    SVF_bandpass(&filter->m_svf, &l_coeffs, src, dst, filter->m_G, n);
 }
 
-
 static LADSPA_Handle Bandpass_instantiate(
 	const struct _LADSPA_Descriptor *p_pDescriptor,
 	unsigned long p_sample_rate )
@@ -218,16 +214,25 @@ static void Bandpass_run(
         l_pFilter++;
     }
 
-    for( l_sample = 0; l_sample < p_sample_count; l_sample++ ){
+    // the input is copied, the output may share its buffer
+    LADSPA_Data l_in[SVF_CHUNK];
+    LADSPA_Data l_y[SVF_CHUNK];
+    while( p_sample_count ){
+        unsigned long l_n = p_sample_count < SVF_CHUNK ? p_sample_count : SVF_CHUNK;
+        for( l_sample = 0; l_sample < l_n; l_sample++ ){
+            l_in[l_sample] = l_psrc[l_sample];
+            l_pdst[l_sample] = 0.0f;
+        }
         l_pFilter = l_pBandpass->m_filters;
-        LADSPA_Data y = 0.0f;
         for(int i=0;i<5;i++){
-            y += Filter_evaluate(l_pFilter, l_pBandpass, *l_psrc);
+            Filter_run(l_pFilter, l_pBandpass, l_in, l_y, l_n);
+            for( l_sample = 0; l_sample < l_n; l_sample++ )
+                l_pdst[l_sample] += l_y[l_sample];
             l_pFilter++;
         }
-        *l_pdst = y;
-        l_psrc++;
-        l_pdst++;
+        l_psrc += l_n;
+        l_pdst += l_n;
+        p_sample_count -= l_n;
     }
 }
 
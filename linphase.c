@@ -0,0 +1,398 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "linphase.h"
+#include "fft.h"
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+/*
+ * FIR design
+ *
+ *   Hd[k] = magnitude(2*pi*k/M), k = 0..M/2, zero phase
+ *   h0 = IDFT(Hd)
+ *   h[n] = h0[n - (T-1)/2]*w[n], n = 0..T-1
+ *
+ * with M = LINPHASE_NDESIGN, T = LINPHASE_TAPS and the 4 term
+ * Blackman-Harris window
+ *
+ *   w[n] = a0 - a1*cos(2*pi*n/(T-1)) + a2*cos(4*pi*n/(T-1))
+ *             - a3*cos(6*pi*n/(T-1))
+ *
+ * Partition p holds taps p*B..p*B+B-1, zero padded to 2*B and
+ * transformed. The 2/(2*B) factor undoes the unscaled inverse FFT.
+ *
+ * Overlap save, per block i of B input samples
+ *
+ *   X[i] = FFT(x[(i-1)*B..(i+1)*B-1])
+ *   Y = sum X[i-p]*H[p], p = 0..P-1
+ *   y[i*B..(i+1)*B-1] = last B samples of IFFT(Y)
+ */
+
+#define LINPHASE_NDESIGN 16384
+
+/*
+ * The convolution state, allocated by the worker with the first design
+ * and seen by the audio thread from the first handover on.
+ */
+typedef struct {
+    FFT_Plan       m_plan;
+    float          m_y[LINPHASE_NFFT];
+    float          m_y_old[LINPHASE_NFFT];
+    float complex  m_X[LINPHASE_NPART][LINPHASE_NBINS];
+    float complex  m_Y[LINPHASE_NBINS];
+    float complex  m_H[2][LINPHASE_NPART][LINPHASE_NBINS];
+} Linphase_Body;
+
+struct Linphase {
+    Linphase_Magnitude m_magnitude;
+
+    // audio thread
+    Linphase_Body *m_pbody;         // NULL until the first handover
+    float          m_in[LINPHASE_NFFT];
+    float          m_out[LINPHASE_B];
+    int            m_pos;
+    int            m_fdl;
+    int            m_cur;
+    int            m_ready;
+    unsigned char  m_last[LINPHASE_PARAMS_MAX];
+    size_t         m_last_size;
+    int            m_dirty;
+
+    // shared, under g_lock
+    atomic_int     m_handover;      // 1 while m_H[!m_cur] holds a new design
+    atomic_int     m_deferred;      // a request waits for the handover
+    Linphase_Body *m_pnew;
+    unsigned char  m_params[LINPHASE_PARAMS_MAX];
+    size_t         m_params_size;
+    int            m_pending;
+    int            m_queued;
+    Linphase      *m_pnext;
+};
+
+// one worker designs for all instances, g_life_lock starts and stops
+// it, g_lock guards the queue and the designs and is only tried from
+// the audio thread
+static pthread_mutex_t g_life_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static sem_t           g_wake;
+static pthread_t       g_thread;
+static int             g_nusers;
+static int             g_quit;
+static Linphase       *g_pqueue;
+
+static void Linphase_design( Linphase *p_plp, FFT_Plan *p_pdesign,
+                             FFT_Plan *p_ppart, float complex *p_pHd,
+                             float *p_ph0, float *p_ph,
+                             const void *p_pparams, int p_set )
+{
+    const int l_M = LINPHASE_NDESIGN;
+    const int l_T = LINPHASE_TAPS;
+    for(int k=0;k<=l_M/2;k++){
+        p_pHd[k] = (float)p_plp->m_magnitude( p_pparams, 2.0*M_PI*k/l_M );
+    }
+    FFT_real_inverse( p_pdesign, p_pHd, p_ph0 );
+
+    const double a0 = 0.35875, a1 = 0.48829, a2 = 0.14128, a3 = 0.01168;
+    float l_part[LINPHASE_NFFT];
+    for(int n=0;n<LINPHASE_NPART*LINPHASE_B;n++){
+        if( n >= l_T ){
+            p_ph[n] = 0.0f;
+            continue;
+        }
+        double l_x = 2.0*M_PI*n/(l_T - 1);
+        double l_w = a0 - a1*cos( l_x ) + a2*cos( 2.0*l_x ) - a3*cos( 3.0*l_x );
+        int l_i = (n - (l_T - 1)/2 + l_M) % l_M;
+        p_ph[n] = (float)(p_ph0[l_i]*2.0/l_M*l_w);
+    }
+    for(int p=0;p<LINPHASE_NPART;p++){
+        memcpy( l_part, &p_ph[p*LINPHASE_B], sizeof(float)*LINPHASE_B );
+        memset( &l_part[LINPHASE_B], 0, sizeof(float)*LINPHASE_B );
+        FFT_real_forward( p_ppart, l_part, p_plp->m_pnew->m_H[p_set][p] );
+        for(int k=0;k<LINPHASE_NBINS;k++){
+            p_plp->m_pnew->m_H[p_set][p][k] *= 2.0f/LINPHASE_NFFT;
+        }
+    }
+}
+
+static Linphase_Body *Linphase_Body_new( void )
+{
+    Linphase_Body *l_pbody = calloc( 1, sizeof(Linphase_Body) );
+    if( l_pbody && !FFT_Plan_init( &l_pbody->m_plan, LINPHASE_NFFT ) ){
+        free( l_pbody );
+        return NULL;
+    }
+    return l_pbody;
+}
+
+static void Linphase_Body_free( Linphase_Body *p_pbody )
+{
+    if( !p_pbody )
+        return;
+    FFT_Plan_free( &p_pbody->m_plan );
+    free( p_pbody );
+}
+
+static void *Linphase_worker( void *p_parg )
+{
+    FFT_Plan l_design;
+    FFT_Plan l_part;
+    unsigned char l_params[LINPHASE_PARAMS_MAX];
+    float complex *l_pHd = malloc( sizeof(float complex)*(LINPHASE_NDESIGN/2 + 1) );
+    float *l_ph0 = malloc( sizeof(float)*LINPHASE_NDESIGN );
+    float *l_ph = malloc( sizeof(float)*LINPHASE_NPART*LINPHASE_B );
+    int l_ok = l_pHd && l_ph0 && l_ph &&
+               FFT_Plan_init( &l_design, LINPHASE_NDESIGN );
+    if( l_ok && !FFT_Plan_init( &l_part, LINPHASE_NFFT ) ){
+        FFT_Plan_free( &l_design );
+        l_ok = 0;
+    }
+
+    for(;;){
+        sem_wait( &g_wake );
+        pthread_mutex_lock( &g_lock );
+        if( g_quit ){
+            pthread_mutex_unlock( &g_lock );
+            break;
+        }
+        while( g_pqueue ){
+            Linphase *l_plp = g_pqueue;
+            g_pqueue = l_plp->m_pnext;
+            l_plp->m_queued = 0;
+            if( !l_plp->m_pending || !l_ok )
+                continue;
+            // the last design is not taken yet, the audio thread asks
+            // again when it is
+            if( atomic_load( &l_plp->m_handover ) ){
+                atomic_store( &l_plp->m_deferred, 1 );
+                continue;
+            }
+            if( !l_plp->m_pnew )
+                l_plp->m_pnew = Linphase_Body_new();
+            if( !l_plp->m_pnew )
+                continue;
+            memcpy( l_params, l_plp->m_params, l_plp->m_params_size );
+            l_plp->m_pending = 0;
+            Linphase_design( l_plp, &l_design, &l_part, l_pHd, l_ph0, l_ph,
+                             l_params, !l_plp->m_cur );
+            atomic_store_explicit( &l_plp->m_handover, 1, memory_order_release );
+        }
+        pthread_mutex_unlock( &g_lock );
+    }
+
+    if( l_ok ){
+        FFT_Plan_free( &l_design );
+        FFT_Plan_free( &l_part );
+    }
+    free( l_pHd );
+    free( l_ph0 );
+    free( l_ph );
+    return NULL;
+}
+
+// with g_lock held
+static void Linphase_unqueue( Linphase *p_plp )
+{
+    if( !p_plp->m_queued )
+        return;
+    Linphase **l_pplp = &g_pqueue;
+    while( *l_pplp != p_plp )
+        l_pplp = &(*l_pplp)->m_pnext;
+    *l_pplp = p_plp->m_pnext;
+    p_plp->m_queued = 0;
+}
+
+Linphase *Linphase_new( Linphase_Magnitude p_magnitude )
+{
+    Linphase *l_plp = calloc( 1, sizeof(Linphase) );
+    if( !l_plp )
+        return NULL;
+    l_plp->m_magnitude = p_magnitude;
+    atomic_init( &l_plp->m_handover, 0 );
+    atomic_init( &l_plp->m_deferred, 0 );
+
+    pthread_mutex_lock( &g_life_lock );
+    if( g_nusers == 0 ){
+        g_quit = 0;
+        sem_init( &g_wake, 0, 0 );
+        if( pthread_create( &g_thread, NULL, Linphase_worker, NULL ) ){
+            sem_destroy( &g_wake );
+            pthread_mutex_unlock( &g_life_lock );
+            free( l_plp );
+            return NULL;
+        }
+    }
+    g_nusers++;
+    pthread_mutex_unlock( &g_life_lock );
+    return l_plp;
+}
+
+void Linphase_free( Linphase *p_plp )
+{
+    if( !p_plp )
+        return;
+    pthread_mutex_lock( &g_life_lock );
+    pthread_mutex_lock( &g_lock );
+    Linphase_unqueue( p_plp );
+    Linphase_Body_free( p_plp->m_pnew );
+    int l_stop = --g_nusers == 0;
+    if( l_stop )
+        g_quit = 1;
+    pthread_mutex_unlock( &g_lock );
+    if( l_stop ){
+        sem_post( &g_wake );
+        pthread_join( g_thread, NULL );
+        sem_destroy( &g_wake );
+    }
+    pthread_mutex_unlock( &g_life_lock );
+    free( p_plp );
+}
+
+/*
+ * Clear the signal history, used when the plugin switches into linear
+ * phase mode.
+ */
+void Linphase_reset( Linphase *p_plp )
+{
+    memset( p_plp->m_in, 0, sizeof(p_plp->m_in) );
+    memset( p_plp->m_out, 0, sizeof(p_plp->m_out) );
+    if( p_plp->m_pbody )
+        memset( p_plp->m_pbody->m_X, 0, sizeof(p_plp->m_pbody->m_X) );
+    p_plp->m_pos = 0;
+    p_plp->m_fdl = 0;
+}
+
+/*
+ * Ask for a design with p_pparams. Nothing happens when the parameters
+ * equal the last ones asked for. Never blocks: if the worker holds the
+ * lock the request is retried on the next call.
+ */
+void Linphase_request( Linphase *p_plp, const void *p_pparams, size_t p_size )
+{
+    if( p_size > LINPHASE_PARAMS_MAX )
+        return;
+    // a request the worker put off, post it again once the handover
+    // is taken
+    if( atomic_load( &p_plp->m_deferred ) &&
+        !atomic_load( &p_plp->m_handover ) ){
+        atomic_store( &p_plp->m_deferred, 0 );
+        p_plp->m_dirty = 1;
+    }
+    if( !p_plp->m_dirty && p_size == p_plp->m_last_size &&
+        memcmp( p_pparams, p_plp->m_last, p_size ) == 0 )
+        return;
+    memcpy( p_plp->m_last, p_pparams, p_size );
+    p_plp->m_last_size = p_size;
+    p_plp->m_dirty = 1;
+    if( pthread_mutex_trylock( &g_lock ) )
+        return;
+    memcpy( p_plp->m_params, p_pparams, p_size );
+    p_plp->m_params_size = p_size;
+    p_plp->m_pending = 1;
+    if( !p_plp->m_queued ){
+        p_plp->m_pnext = g_pqueue;
+        g_pqueue = p_plp;
+        p_plp->m_queued = 1;
+    }
+    pthread_mutex_unlock( &g_lock );
+    sem_post( &g_wake );
+    p_plp->m_dirty = 0;
+}
+
+static void Linphase_convolve( Linphase *p_plp, int p_set, float *p_py )
+{
+    Linphase_Body *l_pbody = p_plp->m_pbody;
+    float complex *l_pY = l_pbody->m_Y;
+    memset( l_pY, 0, sizeof(l_pbody->m_Y) );
+    for(int p=0;p<LINPHASE_NPART;p++){
+        int l_i = p_plp->m_fdl - p;
+        if( l_i < 0 )
+            l_i += LINPHASE_NPART;
+        const float complex *l_pX = l_pbody->m_X[l_i];
+        const float complex *l_pH = l_pbody->m_H[p_set][p];
+        for(int k=0;k<LINPHASE_NBINS;k++){
+            l_pY[k] += l_pX[k]*l_pH[k];
+        }
+    }
+    FFT_real_inverse( &l_pbody->m_plan, l_pY, p_py );
+}
+
+static void Linphase_block( Linphase *p_plp )
+{
+    int l_handover = atomic_load_explicit( &p_plp->m_handover, memory_order_acquire );
+    if( l_handover && !p_plp->m_pbody )
+        p_plp->m_pbody = p_plp->m_pnew;
+    Linphase_Body *l_pbody = p_plp->m_pbody;
+    if( !l_pbody ){
+        // silent until the first design
+        memmove( p_plp->m_in, &p_plp->m_in[LINPHASE_B], sizeof(float)*LINPHASE_B );
+        return;
+    }
+
+    if( ++p_plp->m_fdl == LINPHASE_NPART )
+        p_plp->m_fdl = 0;
+    FFT_real_forward( &l_pbody->m_plan, p_plp->m_in, l_pbody->m_X[p_plp->m_fdl] );
+    memmove( p_plp->m_in, &p_plp->m_in[LINPHASE_B], sizeof(float)*LINPHASE_B );
+
+    if( l_handover ){
+        int l_old = p_plp->m_cur;
+        p_plp->m_cur = !l_old;
+        Linphase_convolve( p_plp, p_plp->m_cur, l_pbody->m_y );
+        if( p_plp->m_ready ){
+            Linphase_convolve( p_plp, l_old, l_pbody->m_y_old );
+            for(int n=0;n<LINPHASE_B;n++){
+                float l_w = (n + 0.5f)/LINPHASE_B;
+                float *l_py = &l_pbody->m_y[LINPHASE_B + n];
+                *l_py = l_w**l_py + (1.0f - l_w)*l_pbody->m_y_old[LINPHASE_B + n];
+            }
+        }
+        p_plp->m_ready = 1;
+        atomic_store_explicit( &p_plp->m_handover, 0, memory_order_release );
+    } else if( p_plp->m_ready ){
+        Linphase_convolve( p_plp, p_plp->m_cur, l_pbody->m_y );
+    } else {
+        memset( l_pbody->m_y, 0, sizeof(l_pbody->m_y) );
+    }
+    memcpy( p_plp->m_out, &l_pbody->m_y[LINPHASE_B], sizeof(float)*LINPHASE_B );
+}
+
+void Linphase_run( Linphase *p_plp, LADSPA_Data *p_psrc, LADSPA_Data *p_pdst,
+                   unsigned long p_nsamples )
+{
+    LADSPA_Data *l_psrc_end = p_psrc + p_nsamples;
+    for(;p_psrc!=l_psrc_end;p_psrc++,p_pdst++){
+        p_plp->m_in[LINPHASE_B + p_plp->m_pos] = *p_psrc;
+        *p_pdst = p_plp->m_out[p_plp->m_pos];
+        if( ++p_plp->m_pos == LINPHASE_B ){
+            p_plp->m_pos = 0;
+            Linphase_block( p_plp );
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+#include <stddef.h>
+
+/*
+ * Linear phase filtering by fast convolution.
+ *
+ * A zero phase FIR is designed from a magnitude response, windowed to
+ * LINPHASE_TAPS taps and applied with a uniformly partitioned overlap
+ * save convolution: blocks of LINPHASE_B samples, FFTs of 2*LINPHASE_B
+ * and a frequency domain delay line of LINPHASE_NPART input spectra.
+ *
+ * Designs run on one worker thread shared by all instances. run()
+ * only posts the new parameters and keeps the current filter until
+ * the worker hands over the next one, which is then faded in over one
+ * block. The worker allocates an instance's convolution state, about
+ * 200 KB, with its first design, so filters that never switch to
+ * linear phase only keep a small struct, and the output is silent
+ * until that first design is in.
+ *
+ * The output is delayed by LINPHASE_LATENCY samples, one block for the
+ * buffering plus half the FIR length.
+ */
+
+#define LINPHASE_B 256
+#define LINPHASE_NFFT (2*LINPHASE_B)
+#define LINPHASE_NBINS (LINPHASE_B+1)
+#define LINPHASE_TAPS 8191
+#define LINPHASE_NPART ((LINPHASE_TAPS + LINPHASE_B - 1)/LINPHASE_B)
+#define LINPHASE_LATENCY (LINPHASE_B + (LINPHASE_TAPS - 1)/2)
+#define LINPHASE_PARAMS_MAX 256
+
+/*
+ * Magnitude response at the digital frequency p_omega, 0..pi rad per
+ * sample, for the parameter block p_pparams.
+ */
+typedef double (*Linphase_Magnitude)( const void *p_pparams, double p_omega );
+
+typedef struct Linphase Linphase;
+
+Linphase *Linphase_new( Linphase_Magnitude p_magnitude );
+void Linphase_free( Linphase *p_plp );
+void Linphase_reset( Linphase *p_plp );
+void Linphase_request( Linphase *p_plp, const void *p_pparams, size_t p_size );
+void Linphase_run( Linphase *p_plp, LADSPA_Data *p_psrc, LADSPA_Data *p_pdst,
+                   unsigned long p_nsamples );
@@ -0,0 +1,294 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include "ellip_design.h"
+#include "freq_table.h"
+
+/*
+ * Butterworth and elliptic low/high pass filters with the cutoff taken
+ * from an audio rate input port. The sections run from log frequency
+ * tables, see freq_table.h, which are rebuilt only when the type, order
+ * or elliptic prototype changes.
+ *
+ * Butterworth, order N, c = 2*cos(m*pi/(2*N)), m = 1,3,..,N-1 for N
+ * even, c = 2*cos(k*pi/N), k = 1..(N-1)/2 plus a real pole for N odd
+ *
+ *                     1                           s^2
+ *  Hlp(s) = ------------------     Hhp(s) = ------------------
+ *             s^2 + c*s + 1                   s^2 + c*s + 1
+ *
+ *                  1                               s
+ *  Hlp(s) = -----------            Hhp(s) = -----------
+ *                s + 1                           s + 1
+ *
+ * w0 = 1, R = c/2
+ *
+ * Elliptic, (N+1)/2 prototype stages, see ellip_design.h
+ *
+ *                     s^2 + cn0                    cn0*s^2 + 1
+ *  Hlp(s) = --------------------   Hhp(s) = ----------------------
+ *            s^2 + cd1*s + cd0               cd0*s^2 + cd1*s + 1
+ *
+ * lp: w0 = sqrt(cd0), n2 = 1, n0 = cn0
+ * hp: w0 = 1/sqrt(cd0), n2 = cn0/cd0, n0 = 1/cd0
+ * R = cd1/(2*sqrt(cd0))
+ */
+
+enum {
+    PORT_IN,
+    PORT_OUT,
+    PORT_CUTOFF,
+    PORT_TYPE,
+    PORT_N,
+    PORT_RIPPLE,
+    PORT_ATTENUATION,
+    PORT_NPORTS
+};
+
+enum {
+    TYPE_BW_LP,
+    TYPE_BW_HP,
+    TYPE_ELLIP_LP,
+    TYPE_ELLIP_HP,
+    TYPE_NTYPES
+};
+
+#define N_ORDER_MAX 10
+
+typedef struct {
+    int             m_type;
+    int             m_N;
+    Ellip_Prototype m_proto;
+} ModFilter_Design;
+
+typedef struct {
+    LADSPA_Data  m_sample_rate;
+    LADSPA_Data *m_pport[PORT_NPORTS];
+    ModFilter_Design m_design;
+    LADSPA_Data  m_ripple;
+    LADSPA_Data  m_attenuation;
+    FT_Filter    m_ft;
+} ModFilter_Data;
+
+static int ModFilter_sections( const ModFilter_Design *p_pd,
+                               FT_Section *p_psec )
+{
+    FT_Section *l_psec = p_psec;
+    if(p_pd->m_type == TYPE_BW_LP || p_pd->m_type == TYPE_BW_HP){
+        int l_hp = p_pd->m_type == TYPE_BW_HP;
+        int l_N = p_pd->m_N;
+        if(l_N&1){
+            l_psec->m_order = 1;
+            l_psec->m_w0 = 1.0;
+            l_psec->m_R = 0.0;
+            l_psec->m_n2 = 0.0;
+            l_psec->m_n1 = l_hp ? 1.0 : 0.0;
+            l_psec->m_n0 = l_hp ? 0.0 : 1.0;
+            l_psec++;
+        }
+        for(int m=1;m<=l_N/2;m++){
+            double c = (l_N&1) ? 2.0*cos(m*M_PI/l_N)
+                               : 2.0*cos((2*m-1)*M_PI/2.0/l_N);
+            l_psec->m_order = 2;
+            l_psec->m_w0 = 1.0;
+            l_psec->m_R = c/2.0;
+            l_psec->m_n2 = l_hp ? 1.0 : 0.0;
+            l_psec->m_n1 = 0.0;
+            l_psec->m_n0 = l_hp ? 0.0 : 1.0;
+            l_psec++;
+        }
+    } else {
+        int l_hp = p_pd->m_type == TYPE_ELLIP_HP;
+        for(int i=0;i<p_pd->m_proto.m_N_stages;i++,l_psec++){
+            const ec_stage *ec = &p_pd->m_proto.m_stages[i];
+            l_psec->m_order = 2;
+            l_psec->m_R = ec->cden1/(2.0*sqrt(ec->cden0));
+            l_psec->m_n1 = 0.0;
+            if(l_hp){
+                l_psec->m_w0 = 1.0/sqrt(ec->cden0);
+                l_psec->m_n2 = ec->cnum0/ec->cden0;
+                l_psec->m_n0 = 1.0/ec->cden0;
+            } else {
+                l_psec->m_w0 = sqrt(ec->cden0);
+                l_psec->m_n2 = 1.0;
+                l_psec->m_n0 = ec->cnum0;
+            }
+        }
+    }
+    return (int)(l_psec - p_psec);
+}
+
+static LADSPA_Handle ModFilter_instantiate(
+    const struct _LADSPA_Descriptor *p_pDescriptor,
+    unsigned long p_sample_rate)
+{
+    ModFilter_Data *l_pModFilter = malloc( sizeof(ModFilter_Data) );
+    if(l_pModFilter){
+        l_pModFilter->m_sample_rate = (float)p_sample_rate;
+        l_pModFilter->m_design.m_type = -1;
+        l_pModFilter->m_design.m_N = 0;
+        l_pModFilter->m_design.m_proto.m_N_stages = 0;
+        l_pModFilter->m_ripple = 0.0f;
+        l_pModFilter->m_attenuation = 0.0f;
+        FT_Filter_init(&l_pModFilter->m_ft, l_pModFilter->m_sample_rate);
+    }
+    return (LADSPA_Handle)l_pModFilter;
+}
+
+static void ModFilter_connect_port(
+        LADSPA_Handle p_pInstance,
+        unsigned long p_port,
+        LADSPA_Data *p_pdata)
+{
+    ModFilter_Data *l_pModFilter = (ModFilter_Data*)p_pInstance;
+    l_pModFilter->m_pport[p_port] = p_pdata;
+}
+
+static void ModFilter_run(
+        LADSPA_Handle p_pInstance,
+        unsigned long p_sample_count)
+{
+    ModFilter_Data *l_pModFilter = (ModFilter_Data*)p_pInstance;
+    ModFilter_Design *l_pd = &l_pModFilter->m_design;
+
+    int l_type = (int)*l_pModFilter->m_pport[PORT_TYPE];
+    if(l_type < 0 || l_type >= TYPE_NTYPES)
+        l_type = TYPE_BW_LP;
+    int l_N = (int)*l_pModFilter->m_pport[PORT_N];
+    if(l_N < 1)
+        l_N = 1;
+    if(l_N > N_ORDER_MAX)
+        l_N = N_ORDER_MAX;
+    int l_ellip = l_type == TYPE_ELLIP_LP || l_type == TYPE_ELLIP_HP;
+    LADSPA_Data l_ripple = *l_pModFilter->m_pport[PORT_RIPPLE];
+    LADSPA_Data l_attenuation = *l_pModFilter->m_pport[PORT_ATTENUATION];
+
+    if(l_type != l_pd->m_type || l_N != l_pd->m_N ||
+       (l_ellip && (l_ripple != l_pModFilter->m_ripple ||
+                    l_attenuation != l_pModFilter->m_attenuation))){
+        double l_gain = 1.0;
+        if(l_ellip){
+            int l_N_stages = (l_N+1)/2;
+            if(l_N_stages > ELLIP_STAGES_MAX)
+                l_N_stages = ELLIP_STAGES_MAX;
+            Ellip_Prototype_get(&l_pd->m_proto, l_N_stages, l_ripple,
+                                l_attenuation);
+            l_gain = l_pd->m_proto.m_gain;
+        }
+        if(l_type != l_pd->m_type){
+            // a different filter, restart from rest
+            FT_Filter_reset(&l_pModFilter->m_ft);
+        }
+        l_pd->m_type = l_type;
+        l_pd->m_N = l_N;
+        l_pModFilter->m_ripple = l_ripple;
+        l_pModFilter->m_attenuation = l_attenuation;
+        FT_Section l_sections[FT_SECTIONS_MAX];
+        int l_nsections = ModFilter_sections(l_pd, l_sections);
+        FT_Filter_design(&l_pModFilter->m_ft, l_sections, l_nsections,
+                         l_gain);
+    }
+
+    FT_Filter_run(&l_pModFilter->m_ft,
+                  l_pModFilter->m_pport[PORT_IN],
+                  l_pModFilter->m_pport[PORT_CUTOFF],
+                  l_pModFilter->m_pport[PORT_OUT],
+                  p_sample_count);
+}
+
+static void ModFilter_cleanup( LADSPA_Handle p_pInstance )
+{
+    free( p_pInstance );
+}
+
+static LADSPA_PortDescriptor ModFilter_PortDescriptors[]=
+{
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL,
+    LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL
+};
+
+static const char *ModFilter_PortNames[]=
+{
+    "Input",
+    "Output",
+    "Cutoff(Hertz)",
+    "Type(0=BW LP,1=BW HP,2=Ellip LP,3=Ellip HP)",
+    "N(Filter order)",
+    "Passband ripple(dB)",
+    "Stopband attenuation(dB)"
+};
+
+static LADSPA_PortRangeHint ModFilter_PortRangeHints[]=
+{
+    {0,0.0f,0.0f},
+    {0,0.0f,0.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
+     10.0f,20.0e3f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_INTEGER | LADSPA_HINT_DEFAULT_0,
+     0.0f, TYPE_NTYPES-1},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_INTEGER | LADSPA_HINT_DEFAULT_LOW,
+     1.0f, N_ORDER_MAX},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE,
+     0.01f,1.0f},
+    {LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE |
+     LADSPA_HINT_DEFAULT_MIDDLE,
+     20.0f,100.0f}
+};
+
+LADSPA_Descriptor ModFilter_Descriptor=
+{
+    5836,
+    "Mod_Filter",
+    LADSPA_PROPERTY_HARD_RT_CAPABLE,
+    "Low/High Pass with Audio Rate Cutoff",
+    "Timothy William Krause",
+    "None",
+    PORT_NPORTS,
+    ModFilter_PortDescriptors,
+    ModFilter_PortNames,
+    ModFilter_PortRangeHints,
+    NULL,
+    ModFilter_instantiate,
+    ModFilter_connect_port,
+    NULL,
+    ModFilter_run,
+    NULL,
+    NULL,
+    NULL,
+    ModFilter_cleanup
+};
@@ -0,0 +1,173 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include "multirate.h"
+#include <string.h>
+
+/*
+ * Halfband FIR, 23 taps, Kaiser window beta = 10.06
+ *
+ *   h[11] = 0.5
+ *   h[11 +/- (2*k+1)] = g_hb[k], k = 0..5
+ *   all other taps are zero
+ *
+ * Passband edge 0.1*fs (+/-0.0002 dB), stopband edge 0.4*fs (-96 dB).
+ * The side taps are scaled so the DC gain is exactly 1.
+ *
+ * Decimator output m, computed once x[2*m+1] arrived:
+ *   y[m] = 0.5*x[c] + sum g_hb[k]*(x[c+2*k+1] + x[c-2*k-1]), c = 2*m-10
+ *
+ * Interpolator for input s[j], q = j-5, two outputs:
+ *   y0 = 2*sum g_hb[k]*(s[q+k] + s[q-1-k])
+ *   y1 = s[q]
+ */
+
+#define MR_HB_CENTER 11
+#define MR_HB_SIDE 6
+#define MR_RING_MASK (MR_RING-1)
+#define MR_DRY_MASK (MR_DRY_SIZE-1)
+
+static const LADSPA_Data g_hb[MR_HB_SIDE]={
+     3.05976543370496956e-01f,
+    -7.39161808501970219e-02f,
+     2.25076218013095276e-02f,
+    -5.21367087762078778e-03f,
+     6.55394988428187829e-04f,
+    -9.70843241685654761e-06f
+};
+
+/*
+ * The D for p_fn, or p_D, the one in use, while fn at its rate stays
+ * within MR_HYSTERESIS of the range it was picked for, so a cutoff
+ * moving about a switch point does not keep restarting the filter.
+ */
+int MR_stages( LADSPA_Data p_fn, int p_D )
+{
+    int l_D = 0;
+    LADSPA_Data l_fn = p_fn;
+    while( l_fn < MR_FN_MIN && l_D < MR_STAGES_MAX ){
+        l_fn *= 2.0f;
+        l_D++;
+    }
+    if( l_D != p_D && p_D >= 0 && p_D <= MR_STAGES_MAX ){
+        l_fn = p_fn*(float)(1 << p_D);
+        if( ( p_D == MR_STAGES_MAX || l_fn >= MR_FN_MIN/MR_HYSTERESIS ) &&
+            ( p_D == 0 || l_fn < 2.0f*MR_FN_MIN*MR_HYSTERESIS ) )
+            return p_D;
+    }
+    return l_D;
+}
+
+/*
+ * Every decimator and interpolator stage delays by MR_HB_CENTER samples
+ * at its high rate, and the low rate sample is picked up by the
+ * interpolators one sample after the decimators produced it.
+ */
+int MR_latency( int p_D )
+{
+    if( p_D == 0 )
+        return 0;
+    return 2*MR_HB_CENTER*((1 << p_D) - 1) + 1;
+}
+
+void MR_init( MR_Data *p_pmr, int p_D )
+{
+    memset( p_pmr, 0, sizeof(MR_Data) );
+    p_pmr->m_D = p_D;
+    p_pmr->m_latency = MR_latency( p_D );
+    for(int j=0;j<MR_STAGES_MAX;j++){
+        p_pmr->m_int[j].m_i = 2;
+    }
+}
+
+static int MR_Decimator_push( MR_Decimator *p_pd, LADSPA_Data p_x,
+                              LADSPA_Data *p_py )
+{
+    unsigned int l_c = p_pd->m_p - MR_HB_CENTER;
+    p_pd->m_r[p_pd->m_p++ & MR_RING_MASK] = p_x;
+    p_pd->m_phase ^= 1;
+    if( p_pd->m_phase )
+        return 0;
+    LADSPA_Data l_y = 0.5f*p_pd->m_r[l_c & MR_RING_MASK];
+    for(int k=0;k<MR_HB_SIDE;k++){
+        l_y += g_hb[k]*( p_pd->m_r[(l_c + 2*k + 1) & MR_RING_MASK] +
+                         p_pd->m_r[(l_c - 2*k - 1) & MR_RING_MASK] );
+    }
+    *p_py = l_y;
+    return 1;
+}
+
+static void MR_Interpolator_push( MR_Interpolator *p_pi, LADSPA_Data p_s )
+{
+    unsigned int l_q = p_pi->m_p - (MR_HB_SIDE - 1);
+    p_pi->m_r[p_pi->m_p++ & MR_RING_MASK] = p_s;
+    LADSPA_Data l_y = 0.0f;
+    for(int k=0;k<MR_HB_SIDE;k++){
+        l_y += g_hb[k]*( p_pi->m_r[(l_q + k) & MR_RING_MASK] +
+                         p_pi->m_r[(l_q - 1 - k) & MR_RING_MASK] );
+    }
+    p_pi->m_y[0] = 2.0f*l_y;
+    p_pi->m_y[1] = p_pi->m_r[l_q & MR_RING_MASK];
+    p_pi->m_i = 0;
+}
+
+static LADSPA_Data MR_pull( MR_Data *p_pmr, int p_j )
+{
+    MR_Interpolator *l_pi = &p_pmr->m_int[p_j];
+    if( l_pi->m_i == 2 ){
+        LADSPA_Data l_s = p_j+1 < p_pmr->m_D ? MR_pull( p_pmr, p_j+1 )
+                                             : p_pmr->m_low;
+        MR_Interpolator_push( l_pi, l_s );
+    }
+    return l_pi->m_y[l_pi->m_i++];
+}
+
+void MR_run( MR_Data *p_pmr, LADSPA_Data *p_psrc, LADSPA_Data *p_pdst,
+             unsigned long p_nsamples, MR_Filter p_filter,
+             void *p_pcontext, int p_complement )
+{
+    int l_D = p_pmr->m_D;
+    LADSPA_Data *l_psrc_end = p_psrc + p_nsamples;
+    for(;p_psrc!=l_psrc_end;p_psrc++,p_pdst++){
+        LADSPA_Data l_x = *p_psrc;
+        LADSPA_Data l_v = l_x;
+        int j;
+        for(j=0;j<l_D;j++){
+            if( !MR_Decimator_push( &p_pmr->m_dec[j], l_v, &l_v ) )
+                break;
+        }
+        if( j == l_D ){
+            LADSPA_Data l_u = p_filter( p_pcontext, l_v );
+            p_pmr->m_low = p_complement ? l_v - l_u : l_u;
+        }
+        LADSPA_Data l_y = MR_pull( p_pmr, 0 );
+        if( p_complement ){
+            unsigned int l_p = p_pmr->m_dry_p++;
+            p_pmr->m_dry[l_p & MR_DRY_MASK] = l_x;
+            l_y = p_pmr->m_dry[(l_p - p_pmr->m_latency) & MR_DRY_MASK] - l_y;
+        }
+        *p_pdst = l_y;
+    }
+}
@@ -0,0 +1,81 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+
+/*
+ * Multirate processing for low cutoff filters.
+ *
+ * The input is decimated by 2^D through a cascade of halfband FIR
+ * stages, filtered at fs/2^D and interpolated back through the mirror
+ * cascade. D is picked so that the filter's fc/fs at the reduced rate
+ * is at least MR_FN_MIN, which keeps the poles away from z = 1 and
+ * runs the filter 2^D times less often. A new D restarts the filter
+ * and changes the latency, so D only changes once fc is MR_HYSTERESIS
+ * past the point where it would switch.
+ *
+ * High pass filters pass the band above the reduced Nyquist frequency
+ * unchanged, so they run as the complement: the low rate path computes
+ * u - Hhp(u) and the result is subtracted from the input delayed by the
+ * latency of the halfband cascade.
+ */
+
+#define MR_STAGES_MAX 6
+#define MR_FN_MIN (1.0f/128.0f)
+#define MR_HYSTERESIS 1.25f
+#define MR_RING 32
+#define MR_DRY_SIZE 2048
+
+typedef LADSPA_Data (*MR_Filter)( void *p_pcontext, LADSPA_Data p_x );
+
+typedef struct {
+    LADSPA_Data  m_r[MR_RING];
+    unsigned int m_p;
+    int          m_phase;
+} MR_Decimator;
+
+typedef struct {
+    LADSPA_Data  m_r[MR_RING];
+    unsigned int m_p;
+    LADSPA_Data  m_y[2];
+    int          m_i;
+} MR_Interpolator;
+
+typedef struct {
+    int             m_D;
+    int             m_latency;
+    MR_Decimator    m_dec[MR_STAGES_MAX];
+    MR_Interpolator m_int[MR_STAGES_MAX];
+    LADSPA_Data     m_low;
+    LADSPA_Data     m_dry[MR_DRY_SIZE];
+    unsigned int    m_dry_p;
+} MR_Data;
+
+int  MR_stages( LADSPA_Data p_fn, int p_D );
+int  MR_latency( int p_D );
+void MR_init( MR_Data *p_pmr, int p_D );
+void MR_run( MR_Data *p_pmr, LADSPA_Data *p_psrc, LADSPA_Data *p_pdst,
+             unsigned long p_nsamples, MR_Filter p_filter,
+             void *p_pcontext, int p_complement );
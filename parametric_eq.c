@@ -0,0 +1,471 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Parametric EQ - N_BANDS RBJ cookbook biquads in a single instance.
+ *
+ *			(b0/a0) + (b1/a0)*z^-1 + (b2/a0)*z^-2
+ *   H(z) = ---------------------------------------
+ *              1 + (a1/a0)*z^-1 + (a2/a0)*z^-2
+ *
+ * Peaking EQ
+ * b0 = 1 + alpha*A
+ * b1 = -2 cos(w0)
+ * b2 = 1 - alpha*A
+ * a0 = 1 + alpha/A
+ * a1 = -2 cos(w0)
+ * a2 = 1 - alpha/A
+ *
+ * Low shelf
+ *	b0 =    A*( (A+1) - (A-1)*cos(w0) + beta*sin(w0) )
+ *	b1 =  2*A*( (A-1) - (A+1)*cos(w0) )
+ *	b2 =    A*( (A+1) - (A-1)*cos(w0) - beta*sin(w0) )
+ *	a0 =        (A+1) + (A-1)*cos(w0) + beta*sin(w0)
+ *	a1 =   -2*( (A-1) + (A+1)*cos(w0) )
+ *	a2 =        (A+1) + (A-1)*cos(w0) - beta*sin(w0)
+ *
+ * High shelf
+ *	b0 =    A*( (A+1) + (A-1)*cos(w0) + beta*sin(w0) )
+ *	b1 = -2*A*( (A-1) + (A+1)*cos(w0) )
+ *	b2 =    A*( (A+1) + (A-1)*cos(w0) - beta*sin(w0) )
+ *	a0 =        (A+1) - (A-1)*cos(w0) + beta*sin(w0)
+ *	a1 =    2*( (A-1) - (A+1)*cos(w0) )
+ *	a2 =        (A+1) - (A-1)*cos(w0) - beta*sin(w0)
+ *
+ * Low pass (G = 10^(dBgain/20) applied to b0..b2)
+ * b0 = (1 - cos(w0))/2
+ * b1 =  1 - cos(w0)
+ * b2 = (1 - cos(w0))/2
+ * a0 =  1 + alpha
+ * a1 = -2 cos(w0)
+ * a2 =  1 - alpha
+ *
+ * High pass (G = 10^(dBgain/20) applied to b0..b2)
+ * b0 =  (1 + cos(w0))/2
+ * b1 = -(1 + cos(w0))
+ * b2 =  (1 + cos(w0))/2
+ * a0 =   1 + alpha
+ * a1 =  -2 cos(w0)
+ * a2 =   1 - alpha
+ *
+ * A = 10^(dBgain/40)
+ * w0 = 2 * pi * fc / fs
+ * alpha = sin(w0) / (2*Q)
+ * beta = sqrt(A)/Q
+ *
+ * With Q = 1/sqrt(2) the shelf beta equals the S = 1 slope used by
+ * RBJ_lowshelf and RBJ_highshelf.
+ *
+ * The bands are run one after the other over sub-blocks of N_SUBBLOCK
+ * samples so the block being equalized stays in the cache between
+ * bands. Bands that are off, or shelves/peaks at 0dB, are skipped and
+ * the coefficients of a band are only recomputed when one of its
+ * controls has changed.
+ */
+
+#define N_BANDS 8
+#define N_SUBBLOCK 64
+#define GAIN_BYPASS_DB 0.01f
+#define FREQUENCY_MAX 0.45f
+
+enum {
+	BAND_OFF,
+	BAND_LOWSHELF,
+	BAND_PEAKING,
+	BAND_HIGHSHELF,
+	BAND_LOWPASS,
+	BAND_HIGHPASS,
+	BAND_NTYPES
+};
+
+enum {
+	PORT_IN,
+	PORT_OUT,
+
+	PORT_TYPE1,
+	PORT_FREQUENCY1,
+	PORT_GAIN1,
+	PORT_Q1,
+
+	PORT_TYPE2,
+	PORT_FREQUENCY2,
+	PORT_GAIN2,
+	PORT_Q2,
+
+	PORT_TYPE3,
+	PORT_FREQUENCY3,
+	PORT_GAIN3,
+	PORT_Q3,
+
+	PORT_TYPE4,
+	PORT_FREQUENCY4,
+	PORT_GAIN4,
+	PORT_Q4,
+
+	PORT_TYPE5,
+	PORT_FREQUENCY5,
+	PORT_GAIN5,
+	PORT_Q5,
+
+	PORT_TYPE6,
+	PORT_FREQUENCY6,
+	PORT_GAIN6,
+	PORT_Q6,
+
+	PORT_TYPE7,
+	PORT_FREQUENCY7,
+	PORT_GAIN7,
+	PORT_Q7,
+
+	PORT_TYPE8,
+	PORT_FREQUENCY8,
+	PORT_GAIN8,
+	PORT_Q8,
+
+	PORT_NPORTS
+};
+
+typedef struct
+{
+	LADSPA_Data *m_type;
+	LADSPA_Data *m_frequency;
+	LADSPA_Data *m_gain;
+	LADSPA_Data *m_Q;
+} Band_Port_Data;
+
+typedef struct
+{
+	LADSPA_Data m_z1;
+	LADSPA_Data m_z2;
+	LADSPA_Data m_a1;
+	LADSPA_Data m_a2;
+	LADSPA_Data m_b0;
+	LADSPA_Data m_b1;
+	LADSPA_Data m_b2;
+	int         m_active;
+	int         m_type;
+	LADSPA_Data m_frequency;
+	LADSPA_Data m_gain;
+	LADSPA_Data m_Q;
+	Band_Port_Data *m_port_data;
+} Band_Data;
+
+typedef struct
+{
+	LADSPA_Data  m_sample_rate;
+	LADSPA_Data *m_pport[PORT_NPORTS];
+	Band_Data    m_bands[N_BANDS];
+} ParametricEQ_Data;
+
+static void Band_init(Band_Data *band, Band_Port_Data *port_data)
+{
+	band->m_z1 = 0.0f;
+	band->m_z2 = 0.0f;
+	band->m_active = 0;
+	band->m_type = -1;
+	band->m_port_data = port_data;
+}
+
+static void Band_set(Band_Data *band, LADSPA_Data sample_rate)
+{
+	int l_type = (int)*band->m_port_data->m_type;
+	LADSPA_Data l_frequency = *band->m_port_data->m_frequency;
+	LADSPA_Data l_gain = *band->m_port_data->m_gain;
+	LADSPA_Data l_Q = *band->m_port_data->m_Q;
+
+	if( l_type == band->m_type &&
+		l_frequency == band->m_frequency &&
+		l_gain == band->m_gain &&
+		l_Q == band->m_Q )
+		return;
+
+	band->m_type = l_type;
+	band->m_frequency = l_frequency;
+	band->m_gain = l_gain;
+	band->m_Q = l_Q;
+
+	int l_active = 1;
+	switch( l_type ){
+	case BAND_LOWSHELF:
+	case BAND_PEAKING:
+	case BAND_HIGHSHELF:
+		if( fabsf(l_gain) < GAIN_BYPASS_DB )
+			l_active = 0;
+		break;
+	case BAND_LOWPASS:
+	case BAND_HIGHPASS:
+		break;
+	default:
+		l_active = 0;
+		break;
+	}
+	if( !l_active ){
+		band->m_active = 0;
+		return;
+	}
+	if( !band->m_active ){
+		// band coming online
+		band->m_z1 = 0.0f;
+		band->m_z2 = 0.0f;
+		band->m_active = 1;
+	}
+
+	if( l_frequency > FREQUENCY_MAX*sample_rate )
+		l_frequency = FREQUENCY_MAX*sample_rate;
+	LADSPA_Data l_omega = 2.0f*M_PIf*l_frequency/sample_rate;
+	LADSPA_Data l_sin = sinf(l_omega);
+	LADSPA_Data l_cos = cosf(l_omega);
+	LADSPA_Data l_alpha = l_sin/(2.0f*l_Q);
+	LADSPA_Data l_a0, l_a1, l_a2, l_b0, l_b1, l_b2;
+	switch( l_type ){
+	case BAND_LOWSHELF:
+	case BAND_HIGHSHELF:
+	{
+		LADSPA_Data l_A = exp10f( l_gain/40.0f );
+		LADSPA_Data l_bs = sqrtf(l_A)/l_Q*l_sin;
+		LADSPA_Data l_sign = l_type==BAND_LOWSHELF ? 1.0f : -1.0f;
+		LADSPA_Data l_Am1_cos = l_sign*(l_A-1.0f)*l_cos;
+		l_a0 =                (l_A+1.0f) + l_Am1_cos + l_bs;
+		l_a1 = -2.0f*l_sign*( (l_A-1.0f) + l_sign*(l_A+1.0f)*l_cos );
+		l_a2 =                (l_A+1.0f) + l_Am1_cos - l_bs;
+		l_b0 =            l_A*( (l_A+1.0f) - l_Am1_cos + l_bs );
+		l_b1 = 2.0f*l_sign*l_A*( (l_A-1.0f) - l_sign*(l_A+1.0f)*l_cos );
+		l_b2 =            l_A*( (l_A+1.0f) - l_Am1_cos - l_bs );
+		break;
+	}
+	case BAND_PEAKING:
+	{
+		LADSPA_Data l_A = exp10f( l_gain/40.0f );
+		l_a0 = 1.0f + l_alpha/l_A;
+		l_a1 = -2.0f*l_cos;
+		l_a2 = 1.0f - l_alpha/l_A;
+		l_b0 = 1.0f + l_alpha*l_A;
+		l_b1 = l_a1;
+		l_b2 = 1.0f - l_alpha*l_A;
+		break;
+	}
+	default:
+	{
+		LADSPA_Data l_G = exp10f( l_gain/20.0f );
+		LADSPA_Data l_c = l_type==BAND_LOWPASS ? 1.0f - l_cos : 1.0f + l_cos;
+		l_a0 = 1.0f + l_alpha;
+		l_a1 = -2.0f*l_cos;
+		l_a2 = 1.0f - l_alpha;
+		l_b0 = l_G*l_c/2.0f;
+		l_b1 = l_type==BAND_LOWPASS ? l_G*l_c : -l_G*l_c;
+		l_b2 = l_b0;
+		break;
+	}
+	}
+	band->m_a1 = l_a1/l_a0;
+	band->m_a2 = l_a2/l_a0;
+	band->m_b0 = l_b0/l_a0;
+	band->m_b1 = l_b1/l_a0;
+	band->m_b2 = l_b2/l_a0;
+}
+
+static void Band_process(Band_Data *band, LADSPA_Data *p_pbuf, unsigned long p_n)
+{
+	register LADSPA_Data l_a1 = band->m_a1;
+	register LADSPA_Data l_a2 = band->m_a2;
+	register LADSPA_Data l_b0 = band->m_b0;
+	register LADSPA_Data l_b1 = band->m_b1;
+	register LADSPA_Data l_b2 = band->m_b2;
+	LADSPA_Data l_z1 = band->m_z1;
+	LADSPA_Data l_z2 = band->m_z2;
+	LADSPA_Data *l_pend = p_pbuf + p_n;
+	for(;p_pbuf!=l_pend;p_pbuf++){
+		register LADSPA_Data l_m = *p_pbuf - l_a1*l_z1 - l_a2*l_z2;
+		*p_pbuf = l_b0*l_m + l_b1*l_z1 + l_b2*l_z2;
+		l_z2 = l_z1;
+		l_z1 = l_m;
+	}
+	band->m_z1 = l_z1;
+	band->m_z2 = l_z2;
+}
+
+static LADSPA_Handle ParametricEQ_instantiate(
+	const struct _LADSPA_Descriptor *p_pDescriptor,
+	unsigned long p_sample_rate )
+{
+	ParametricEQ_Data *l_pEQ = malloc( sizeof(ParametricEQ_Data) );
+	if( l_pEQ ){
+		l_pEQ->m_sample_rate = (float)p_sample_rate;
+		Band_Port_Data *l_pPortData = (Band_Port_Data*)&l_pEQ->m_pport[PORT_TYPE1];
+		for(int b=0;b<N_BANDS;b++){
+			Band_init(&l_pEQ->m_bands[b], l_pPortData);
+			l_pPortData++;
+		}
+	}
+	return (LADSPA_Handle)l_pEQ;
+}
+
+static void ParametricEQ_connect_port(
+	LADSPA_Handle p_pInstance,
+	unsigned long p_port,
+	LADSPA_Data  *p_pdata )
+{
+	ParametricEQ_Data *l_pEQ = (ParametricEQ_Data*)p_pInstance;
+	l_pEQ->m_pport[p_port] = p_pdata;
+}
+
+static void ParametricEQ_activate( LADSPA_Handle p_pInstance )
+{
+	ParametricEQ_Data *l_pEQ = (ParametricEQ_Data*)p_pInstance;
+	for(int b=0;b<N_BANDS;b++){
+		l_pEQ->m_bands[b].m_z1 = 0.0f;
+		l_pEQ->m_bands[b].m_z2 = 0.0f;
+	}
+}
+
+static void ParametricEQ_run(
+	LADSPA_Handle p_pInstance,
+	unsigned long p_sample_count )
+{
+	ParametricEQ_Data *l_pEQ = (ParametricEQ_Data*)p_pInstance;
+	LADSPA_Data *l_psrc = l_pEQ->m_pport[PORT_IN];
+	LADSPA_Data *l_pdst = l_pEQ->m_pport[PORT_OUT];
+	Band_Data *l_pActive[N_BANDS];
+	int l_nactive = 0;
+
+	for(int b=0;b<N_BANDS;b++){
+		Band_set(&l_pEQ->m_bands[b], l_pEQ->m_sample_rate);
+		if( l_pEQ->m_bands[b].m_active )
+			l_pActive[l_nactive++] = &l_pEQ->m_bands[b];
+	}
+
+	if( l_psrc != l_pdst )
+		memcpy( l_pdst, l_psrc, sizeof(LADSPA_Data)*p_sample_count );
+
+	for(unsigned long l_start=0;l_start<p_sample_count;l_start+=N_SUBBLOCK){
+		unsigned long l_n = p_sample_count - l_start;
+		if( l_n > N_SUBBLOCK ) l_n = N_SUBBLOCK;
+		for(int b=0;b<l_nactive;b++){
+			Band_process(l_pActive[b], &l_pdst[l_start], l_n);
+		}
+	}
+}
+
+static void ParametricEQ_cleanup( LADSPA_Handle p_pInstance )
+{
+	free( p_pInstance );
+}
+
+#define BAND_PORT_DESCRIPTORS \
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL, \
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL, \
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL, \
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL
+
+static LADSPA_PortDescriptor ParametricEQ_PortDescriptors[]=
+{
+	LADSPA_PORT_INPUT|LADSPA_PORT_AUDIO,
+	LADSPA_PORT_OUTPUT|LADSPA_PORT_AUDIO,
+	BAND_PORT_DESCRIPTORS,
+	BAND_PORT_DESCRIPTORS,
+	BAND_PORT_DESCRIPTORS,
+	BAND_PORT_DESCRIPTORS,
+	BAND_PORT_DESCRIPTORS,
+	BAND_PORT_DESCRIPTORS,
+	BAND_PORT_DESCRIPTORS,
+	BAND_PORT_DESCRIPTORS
+};
+
+#define BAND_PORT_NAMES(N) \
+	"Type " #N "(0=off,1=lowshelf,2=peak,3=highshelf,4=LP,5=HP)", \
+	"Frequency " #N "(Hz)", \
+	"Gain " #N "(dB)", \
+	"Q " #N
+
+static const char *ParametricEQ_PortNames[]=
+{
+	"Input",
+	"Output",
+	BAND_PORT_NAMES(1),
+	BAND_PORT_NAMES(2),
+	BAND_PORT_NAMES(3),
+	BAND_PORT_NAMES(4),
+	BAND_PORT_NAMES(5),
+	BAND_PORT_NAMES(6),
+	BAND_PORT_NAMES(7),
+	BAND_PORT_NAMES(8)
+};
+
+#define BAND_PORT_RANGE_HINTS(FREQUENCY_DEFAULT) \
+	{LADSPA_HINT_BOUNDED_BELOW|LADSPA_HINT_BOUNDED_ABOVE| \
+		LADSPA_HINT_INTEGER|LADSPA_HINT_DEFAULT_0, \
+		0.0f,BAND_NTYPES-1}, \
+	{LADSPA_HINT_BOUNDED_BELOW|LADSPA_HINT_BOUNDED_ABOVE| \
+		LADSPA_HINT_LOGARITHMIC|FREQUENCY_DEFAULT, \
+		20.0f,20.0e3f}, \
+	{LADSPA_HINT_BOUNDED_BELOW|LADSPA_HINT_BOUNDED_ABOVE| \
+		LADSPA_HINT_DEFAULT_0, \
+		-30.0f,30.0f}, \
+	{LADSPA_HINT_BOUNDED_BELOW|LADSPA_HINT_BOUNDED_ABOVE| \
+		LADSPA_HINT_LOGARITHMIC|LADSPA_HINT_DEFAULT_MIDDLE, \
+		0.1f,20.0f}
+
+static LADSPA_PortRangeHint ParametricEQ_PortRangeHints[]=
+{
+	{0,0,0},
+	{0,0,0},
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_MINIMUM),
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_LOW),
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_LOW),
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_MIDDLE),
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_MIDDLE),
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_HIGH),
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_HIGH),
+	BAND_PORT_RANGE_HINTS(LADSPA_HINT_DEFAULT_MAXIMUM)
+};
+
+LADSPA_Descriptor ParametricEQ_Descriptor=
+{
+	5835,
+	"parametric_eq",
+	LADSPA_PROPERTY_HARD_RT_CAPABLE,
+	"Parametric EQ RBJ 8 band",
+	"Timothy William Krause",
+	"None",
+	PORT_NPORTS,
+	ParametricEQ_PortDescriptors,
+	ParametricEQ_PortNames,
+	ParametricEQ_PortRangeHints,
+	NULL,
+	ParametricEQ_instantiate,
+	ParametricEQ_connect_port,
+	ParametricEQ_activate,
+	ParametricEQ_run,
+	NULL,
+	NULL,
+	NULL,
+	ParametricEQ_cleanup
+};
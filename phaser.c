@@ -28,6 +28,8 @@ Contact: tim.krause@twkrause.ca
 #include <math.h>
 #include <complex.h>
 #include <stdlib.h>
+#include "svf.h"
+#include "lfo.h"
 
 #define N_FILTERS 8
 
@@ -39,42 +41,25 @@ enum {
 	PORT_NFILTERS,
 	PORT_LFO_FREQUENCY,
 	PORT_LFO_AMOUNT,
+	PORT_LFO_SHAPE,
 	PORT_NPORTS
 };
 
-typedef struct
-{
-	LADSPA_Data m_e_c;
-	LADSPA_Data m_x_last;
-	LADSPA_Data m_alpha;
-} Filter;
-
-static void FilterCoefficients( Filter *p_filter, LADSPA_Data p_frequency, unsigned long p_sample_rate )
-{
-	LADSPA_Data l_T = (LADSPA_Data)1.0f/p_sample_rate;
-	LADSPA_Data l_tau = 1.0f/(2.0f*M_PIf*p_frequency);
-	p_filter->m_alpha = l_tau/(l_T + l_tau);
-}
-
-static void FilterInit( Filter *p_filter )
-{
-	p_filter->m_e_c = 0.0;
-	p_filter->m_x_last = 0.0;
-}
-
-static LADSPA_Data FilterEvaluate( Filter *p_filter, LADSPA_Data p_in )
-{
-	p_filter->m_e_c = p_filter->m_alpha*( p_filter->m_e_c + p_in - p_filter->m_x_last );
-	LADSPA_Data l_v_o = 2.0f*p_filter->m_e_c - p_in;
-	p_filter->m_x_last = p_in;
-	return -l_v_o;
-}
+/*
+ * Each stage is a first order all pass
+ *
+ *           1 - s/wc
+ *  H(s) = ------------
+ *           1 + s/wc
+ *
+ * run as a zero delay feedback one pole, see svf.h.
+ */
 
 typedef struct {
 	LADSPA_Data   m_sample_rate;
 	LADSPA_Data  *m_pport[PORT_NPORTS];
-	Filter        m_filters[N_FILTERS];
-	LADSPA_Data   m_lfo_theta;
+	SVF_State     m_filters[N_FILTERS];
+	LFO           m_lfo;
 } Phaser_Data;
 
 static LADSPA_Handle Phaser_instantiate(
@@ -84,10 +69,10 @@ static LADSPA_Handle Phaser_instantiate(
 	Phaser_Data *l_pPhaser = malloc( sizeof(Phaser_Data) );
 	if(l_pPhaser){
 		l_pPhaser->m_sample_rate = (float)p_sample_rate;
-		l_pPhaser->m_lfo_theta = 0.0f;
+		LFO_reset( &l_pPhaser->m_lfo );
 		unsigned long l_f;
 		for( l_f=0;l_f<N_FILTERS;l_f++){
-			FilterInit( &l_pPhaser->m_filters[l_f] );
+			SVF_init( &l_pPhaser->m_filters[l_f] );
 		}
 	}
 	return (LADSPA_Handle)l_pPhaser;
@@ -113,24 +98,32 @@ static void Phaser_run( LADSPA_Handle p_instance, unsigned long p_sample_count )
 	unsigned long l_sample;
 	LADSPA_Data l_freq0 = *l_pPhaser->m_pport[PORT_FREQUENCY];
 	LADSPA_Data l_lfo_amount = *l_pPhaser->m_pport[PORT_LFO_AMOUNT];
-	LADSPA_Data l_dtheta = 2.0f*M_PIf* *l_pPhaser->m_pport[PORT_LFO_FREQUENCY] / l_pPhaser->m_sample_rate;
-	for( l_sample=0;l_sample<p_sample_count;l_sample++){
-		LADSPA_Data l_out = *l_psrc;
-		Filter *l_pFilter = l_pPhaser->m_filters;
-		LADSPA_Data l_lfo_freq = l_freq0 + (0.5f+0.5f*sinf(l_pPhaser->m_lfo_theta))*l_lfo_amount;
-		for(l_f=0;l_f<l_nfilters;l_f++,l_pFilter++){
-			FilterCoefficients(
-				l_pFilter,
-				l_lfo_freq,
-				l_pPhaser->m_sample_rate);
-			l_out = FilterEvaluate( l_pFilter, l_out );
+	LADSPA_Data l_dphase = *l_pPhaser->m_pport[PORT_LFO_FREQUENCY] / l_pPhaser->m_sample_rate;
+	int l_lfo_shape = LFO_shape( *l_pPhaser->m_pport[PORT_LFO_SHAPE] );
+	LADSPA_Data l_rfs = 1.0f/l_pPhaser->m_sample_rate;
+	LADSPA_Data l_lfo[SVF_CHUNK];
+	LADSPA_Data l_fn[SVF_CHUNK];
+	LADSPA_Data l_G[SVF_CHUNK];
+	LADSPA_Data l_out[SVF_CHUNK];
+	while(p_sample_count){
+		unsigned long l_n = p_sample_count < SVF_CHUNK ? p_sample_count : SVF_CHUNK;
+		LFO_run( &l_pPhaser->m_lfo, l_lfo_shape, l_dphase, l_lfo, l_n );
+		for( l_sample=0;l_sample<l_n;l_sample++){
+			LADSPA_Data l_lfo_freq = l_freq0 + (0.5f+0.5f*l_lfo[l_sample])*l_lfo_amount;
+			l_fn[l_sample] = SVF_fn( l_lfo_freq, l_rfs );
+			l_out[l_sample] = l_psrc[l_sample];
+		}
+		// all stages share the LFO frequency
+		SVF_allpass1_coeffs( l_G, l_fn, l_n );
+		for(l_f=0;l_f<l_nfilters;l_f++){
+			SVF_allpass1( &l_pPhaser->m_filters[l_f], l_G, l_out, l_n );
 		}
-		*l_pdst = (l_out*l_wet_gain + *l_psrc)*0.5f;
-		l_pdst++;
-		l_psrc++;
-		l_pPhaser->m_lfo_theta += l_dtheta;
-		if(l_pPhaser->m_lfo_theta >= 2.0f*M_PIf)
-			l_pPhaser->m_lfo_theta-=2.0f*M_PIf;
+		for( l_sample=0;l_sample<l_n;l_sample++){
+			l_pdst[l_sample] = (l_out[l_sample]*l_wet_gain + l_psrc[l_sample])*0.5f;
+		}
+		l_psrc += l_n;
+		l_pdst += l_n;
+		p_sample_count -= l_n;
 	}
 }
 
@@ -147,6 +140,7 @@ static LADSPA_PortDescriptor Phaser_PortDescriptors[]=
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL
 };
 
@@ -158,7 +152,8 @@ static const char* Phaser_PortNames[]=
 	"Frequency",
 	"N stages",
 	"LFO Frequency",
-	"LFO Amount"
+	"LFO Amount",
+	"LFO Shape"
 };
 
 static LADSPA_PortRangeHint Phaser_PortRangeHints[]=
@@ -192,6 +187,12 @@ static LADSPA_PortRangeHint Phaser_PortRangeHints[]=
 		LADSPA_HINT_BOUNDED_ABOVE|
 		LADSPA_HINT_DEFAULT_LOW,
 		0.0, 5000.0
+	},
+	{ LADSPA_HINT_BOUNDED_BELOW|
+		LADSPA_HINT_BOUNDED_ABOVE|
+		LADSPA_HINT_INTEGER|
+		LADSPA_HINT_DEFAULT_MINIMUM,
+		0.0, LFO_NSHAPES - 1
 	}
 };
 
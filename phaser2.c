@@ -28,6 +28,8 @@ Contact: tim.krause@twkrause.ca
 #include <math.h>
 #include <complex.h>
 #include <stdlib.h>
+#include "fast_math.h"
+#include "lfo.h"
 
 #define N_FILTERS 8
 
@@ -40,6 +42,7 @@ enum {
 	PORT_NFILTERS,
 	PORT_LFO_FREQUENCY,
 	PORT_LFO_AMOUNT,
+	PORT_LFO_SHAPE,
 	PORT_NPORTS
 };
 
@@ -56,7 +59,7 @@ static void FilterCoefficients( Filter *p_filter,
 						 unsigned long p_sample_rate )
 {
 	LADSPA_Data theta=2*M_PI*p_frequency/p_sample_rate;
-	p_filter->two_real_z0 = 2.0f*p_radius*cosf(theta);
+	p_filter->two_real_z0 = 2.0f*p_radius*FM_cosf(theta);
 	p_filter->mag_z0_2 = p_radius*p_radius;
 }
 
@@ -84,7 +87,7 @@ typedef struct {
     LADSPA_Data   m_sample_rate;
 	LADSPA_Data  *m_pport[PORT_NPORTS];
 	Filter        m_filters[N_FILTERS];
-	LADSPA_Data   m_lfo_theta;
+	LFO           m_lfo;
 } Phaser_Data;
 
 static LADSPA_Handle Phaser_instantiate(
@@ -94,7 +97,7 @@ static LADSPA_Handle Phaser_instantiate(
 	Phaser_Data *l_pPhaser = malloc( sizeof(Phaser_Data) );
 	if(l_pPhaser){
 		l_pPhaser->m_sample_rate = p_sample_rate;
-		l_pPhaser->m_lfo_theta = 0.0;
+		LFO_reset( &l_pPhaser->m_lfo );
 		unsigned long l_f;
 		for( l_f=0;l_f<N_FILTERS;l_f++){
 			FilterInit( &l_pPhaser->m_filters[l_f] );
@@ -124,12 +127,19 @@ static void Phaser_run( LADSPA_Handle p_instance, unsigned long p_sample_count )
 	LADSPA_Data l_freq0 = *l_pPhaser->m_pport[PORT_FREQUENCY];
 	LADSPA_Data l_radius = *l_pPhaser->m_pport[PORT_RADIUS];
 	LADSPA_Data l_lfo_amount = *l_pPhaser->m_pport[PORT_LFO_AMOUNT];
-    LADSPA_Data l_dtheta = 2.0f*M_PIf* *l_pPhaser->m_pport[PORT_LFO_FREQUENCY] / l_pPhaser->m_sample_rate;
-    for(;l_psrc!=l_psrc_end;l_psrc++,l_pdst++){
+    LADSPA_Data l_dphase = *l_pPhaser->m_pport[PORT_LFO_FREQUENCY] / l_pPhaser->m_sample_rate;
+	int l_lfo_shape = LFO_shape( *l_pPhaser->m_pport[PORT_LFO_SHAPE] );
+	LADSPA_Data l_lfo[LFO_BLOCK];
+	unsigned long l_sample = 0;
+    for(;l_psrc!=l_psrc_end;l_psrc++,l_pdst++,l_sample++){
+		if( l_sample % LFO_BLOCK == 0 ){
+			unsigned long l_n = p_sample_count - l_sample;
+			LFO_run( &l_pPhaser->m_lfo, l_lfo_shape, l_dphase, l_lfo, l_n < LFO_BLOCK ? l_n : LFO_BLOCK );
+		}
 		LADSPA_Data l_out = *l_psrc;
 		Filter *l_pFilter = l_pPhaser->m_filters;
 		Filter l_filter;
-		LADSPA_Data l_lfo_freq = l_freq0 + (0.5f+0.5f*sinf(l_pPhaser->m_lfo_theta))*l_lfo_amount;
+		LADSPA_Data l_lfo_freq = l_freq0 + (0.5f+0.5f*l_lfo[l_sample % LFO_BLOCK])*l_lfo_amount;
 		FilterCoefficients(
 			&l_filter,
 			l_lfo_freq,
@@ -141,9 +151,6 @@ static void Phaser_run( LADSPA_Handle p_instance, unsigned long p_sample_count )
 			l_out = FilterEvaluate( l_pFilter, l_out );
 		}
 		*l_pdst = (l_out*l_wet_gain + *l_psrc)*0.5f;
-		l_pPhaser->m_lfo_theta += l_dtheta;
-        if(l_pPhaser->m_lfo_theta >= 2.0f*M_PIf)
-            l_pPhaser->m_lfo_theta-=2.0f*M_PIf;
 	}
 }
 
@@ -161,6 +168,7 @@ static LADSPA_PortDescriptor Phaser_PortDescriptors[]=
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
+	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL,
 	LADSPA_PORT_INPUT|LADSPA_PORT_CONTROL
 };
 
@@ -173,7 +181,8 @@ static const char* Phaser_PortNames[]=
 	"Pole Radius",
 	"N stages",
 	"LFO Frequency",
-	"LFO Amount"
+	"LFO Amount",
+	"LFO Shape"
 };
 
 static LADSPA_PortRangeHint Phaser_PortRangeHints[]=
@@ -213,6 +222,12 @@ static LADSPA_PortRangeHint Phaser_PortRangeHints[]=
 		LADSPA_HINT_BOUNDED_ABOVE|
 		LADSPA_HINT_DEFAULT_LOW,
         0.0f, 5000.0f
+	},
+	{ LADSPA_HINT_BOUNDED_BELOW|
+		LADSPA_HINT_BOUNDED_ABOVE|
+		LADSPA_HINT_INTEGER|
+		LADSPA_HINT_DEFAULT_MINIMUM,
+        0.0f, LFO_NSHAPES - 1
 	}
 };
 
@@ -27,9 +27,12 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define N_ALLPASS 20
 #define N_COMB 20
+#define LINE_ALIGN 16	// floats in a cache line
+#define REVERB_BLOCK 256
 
 #define COMB_T0 0.0351
 #define ALLPASS_T0 0.0007708
@@ -83,112 +86,122 @@ typedef struct {
 	LADSPA_Data *data;
 } CyclicBuffer;
 
-static CyclicBuffer *cb_new(unsigned int N)
+static unsigned int line_length(int N)
 {
-	CyclicBuffer *cb = (CyclicBuffer*)malloc(sizeof(CyclicBuffer));
-	if(!cb)return NULL;
-	cb->N = N;
-	cb->data = (LADSPA_Data*)malloc(sizeof(LADSPA_Data)*N);
-	cb->current = cb->data;
-	cb->end = &cb->data[N];
-	unsigned int i;
-	for(i=0;i<N;i++){
-		cb->data[i]=0.0;
-	}
-	return cb;
+	return N < 1 ? 1 : N;
+}
+
+// the arena a line takes, up to the next cache line
+static unsigned long line_size(int N)
+{
+	return (line_length(N) + LINE_ALIGN - 1) & ~(LINE_ALIGN - 1);
 }
 
-static void cb_destroy(CyclicBuffer *cb)
+/*
+ * The delay lines live in one arena per instance, each starts on a
+ * cache line. Returns where the next line starts.
+ */
+static LADSPA_Data *cb_init(CyclicBuffer *cb,LADSPA_Data *data,int N)
 {
-	free(cb->data);
-	free(cb);
+	cb->N = line_length(N);
+	cb->data = data;
+	cb->current = cb->data;
+	cb->end = &cb->data[cb->N];
+	return data + line_size(N);
 }
 
-static inline LADSPA_Data cb_read(CyclicBuffer *cb)
+/*
+ * The samples from the current one to the end of the line, at most n.
+ * A span holds each sample of the line once at most, so a filter can
+ * read and write it in one pass.
+ */
+static inline unsigned long cb_span(CyclicBuffer *cb,unsigned long n)
 {
-	return *cb->current;
+	unsigned long m = cb->end - cb->current;
+	return m < n ? m : n;
 }
 
-static inline void cb_write(CyclicBuffer *cb,LADSPA_Data x)
+static inline void cb_advance(CyclicBuffer *cb,unsigned long m)
 {
-	*cb->current = x;
-	if(++cb->current == cb->end) cb->current=cb->data;
+	cb->current += m;
+	if(cb->current == cb->end) cb->current=cb->data;
 }
 
 static void cb_zero(CyclicBuffer *cb)
 {
-	int n;
-	for(n=0;n<cb->N;n++){
-		cb->data[n]=0.0;
-	}
+	memset(cb->data,0,sizeof(LADSPA_Data)*cb->N);
 }
 
 typedef struct {
-	CyclicBuffer *cb;
+	CyclicBuffer cb;
 	LADSPA_Data g;
 } APF;
 
-static APF* apf_new(unsigned int N)
-{
-	APF *apf = (APF*)malloc(sizeof(APF));
-	apf->cb = cb_new(N);
-	apf->g = 0.5f;
-	return apf;
-}
-
-static void apf_destroy(APF *apf)
-{
-	cb_destroy(apf->cb);
-	free(apf);
-}
-
-static inline LADSPA_Data apf_evaluate(APF *apf,LADSPA_Data x_in)
+/*
+ * Runs n samples of x through the allpass in place.
+ */
+static void apf_run(APF *apf,LADSPA_Data *x,unsigned long n)
 {
-	LADSPA_Data z=cb_read(apf->cb);
-	LADSPA_Data s=x_in + apf->g*z;
-	cb_write(apf->cb,s);
-	return z - apf->g*s;
+	LADSPA_Data g = apf->g;
+	while(n){
+		unsigned long m = cb_span(&apf->cb,n);
+		LADSPA_Data *z = apf->cb.current;
+		for(unsigned long j=0;j<m;j++){
+			LADSPA_Data s=x[j] + g*z[j];
+			x[j] = z[j] - g*s;
+			z[j] = s;
+		}
+		cb_advance(&apf->cb,m);
+		x += m;
+		n -= m;
+	}
 }
 
 typedef struct {
-	CyclicBuffer *cb;
+	CyclicBuffer cb;
 	LADSPA_Data g;
 } FBCF;
 
-static FBCF* fbcf_new(unsigned int N)
-{
-	FBCF *fbcf = (FBCF*)malloc(sizeof(FBCF));
-	if(!fbcf)return NULL;
-	fbcf->cb = cb_new(N);
-	fbcf->g = 0.5f;
-	return fbcf;
-}
-
-static void fbcf_destroy(FBCF *fbcf)
-{
-	cb_destroy(fbcf->cb);
-	free(fbcf);
-}
-
-static inline LADSPA_Data fbcf_evaluate(FBCF *fbcf,LADSPA_Data x_in)
+/*
+ * Runs n samples of x through the comb and adds its output to sum.
+ */
+static void fbcf_run(FBCF *fbcf,const LADSPA_Data *x,LADSPA_Data *sum,unsigned long n)
 {
-	LADSPA_Data y=x_in + fbcf->g*cb_read(fbcf->cb);
-	cb_write(fbcf->cb,y);
-	return y;
+	LADSPA_Data g = fbcf->g;
+	while(n){
+		unsigned long m = cb_span(&fbcf->cb,n);
+		LADSPA_Data *z = fbcf->cb.current;
+		for(unsigned long j=0;j<m;j++){
+			LADSPA_Data y=x[j] + g*z[j];
+			z[j] = y;
+			sum[j] += y;
+		}
+		cb_advance(&fbcf->cb,m);
+		x += m;
+		sum += m;
+		n -= m;
+	}
 }
 
 typedef struct {
 	unsigned long sample_rate;
 	LADSPA_Data *port[PORT_NPORTS];
-	APF *apfs_l[N_ALLPASS];
-	APF *apfs_r[N_ALLPASS];
-	FBCF *fbcfs_l[N_COMB];
-	FBCF *fbcfs_r[N_COMB];
+	APF apfs_l[N_ALLPASS];
+	APF apfs_r[N_ALLPASS];
+	FBCF fbcfs_l[N_COMB];
+	FBCF fbcfs_r[N_COMB];
+	LADSPA_Data *arena;
 	unsigned int n_allpass_prev;
 	unsigned int n_comb_prev;
 }
  Reverb;
 
+/*
+ * The arena holds the lines in the order run() walks them, left next
+ * to right, the allpasses and then the combs, so the filters that are
+ * on are the front of each part. The ports reach all N_ALLPASS and
+ * N_COMB, and may be raised in run(), so all of them are allocated.
+ */
 static LADSPA_Handle Reverb_instantiate(const struct _LADSPA_Descriptor * Descriptor,
                                unsigned long                     SampleRate)
 {
@@ -199,13 +212,30 @@ static LADSPA_Handle Reverb_instantiate(const struct _LADSPA_Descriptor * Descri
 
 	r->sample_rate = SampleRate;
 	int i;
+	unsigned long size = 0;
+	for(i=0;i<N_ALLPASS;i++)
+		size += line_size(allpass_init_left[i]) + line_size(allpass_init_right[i]);
+	for(i=0;i<N_COMB;i++)
+		size += line_size(comb_init_left[i]) + line_size(comb_init_right[i]);
+	size *= sizeof(LADSPA_Data);
+	r->arena = (LADSPA_Data*)aligned_alloc(LINE_ALIGN*sizeof(LADSPA_Data),size);
+	if(!r->arena){
+		free(r);
+		return NULL;
+	}
+	memset(r->arena,0,size);
+	LADSPA_Data *data = r->arena;
 	for(i=0;i<N_ALLPASS;i++){
-		r->apfs_l[i] = apf_new(allpass_init_left[i]);
-		r->apfs_r[i] = apf_new(allpass_init_right[i]);
+		data = cb_init(&r->apfs_l[i].cb,data,allpass_init_left[i]);
+		data = cb_init(&r->apfs_r[i].cb,data,allpass_init_right[i]);
+		r->apfs_l[i].g = 0.5f;
+		r->apfs_r[i].g = 0.5f;
 	}
 	for(i=0;i<N_COMB;i++){
-		r->fbcfs_l[i] = fbcf_new(comb_init_left[i]);
-		r->fbcfs_r[i] = fbcf_new(comb_init_right[i]);
+		data = cb_init(&r->fbcfs_l[i].cb,data,comb_init_left[i]);
+		data = cb_init(&r->fbcfs_r[i].cb,data,comb_init_right[i]);
+		r->fbcfs_l[i].g = 0.5f;
+		r->fbcfs_r[i].g = 0.5f;
 	}
 	r->n_allpass_prev = 0;
 	r->n_comb_prev = 0;
@@ -233,6 +263,8 @@ static void Reverb_run(LADSPA_Handle Instance,
     LADSPA_Data mix=*r->port[PORT_WETDRY];
 	unsigned int n_allpass = (unsigned int)*r->port[PORT_N_ALLPASS];
 	unsigned int n_comb = (unsigned int)*r->port[PORT_N_COMB];
+	if(n_allpass > N_ALLPASS) n_allpass = N_ALLPASS;
+	if(n_comb > N_COMB) n_comb = N_COMB;
 	
 	unsigned long i;
 
@@ -242,68 +274,68 @@ static void Reverb_run(LADSPA_Handle Instance,
 	// initialize filters coming online
 	if(n_allpass > r->n_allpass_prev){
 		for(i=r->n_allpass_prev;i<n_allpass;i++){
-			cb_zero(r->apfs_l[i]->cb);
-			cb_zero(r->apfs_r[i]->cb);
+			cb_zero(&r->apfs_l[i].cb);
+			cb_zero(&r->apfs_r[i].cb);
 		}
 	}
 	
 	if(n_comb > r->n_comb_prev){
 		for(i=r->n_comb_prev;i<n_comb;i++){
-			cb_zero(r->fbcfs_l[i]->cb);
-			cb_zero(r->fbcfs_r[i]->cb);
+			cb_zero(&r->fbcfs_l[i].cb);
+			cb_zero(&r->fbcfs_r[i].cb);
 		}
 	}
 	
 	// initialize the gain coefficients for the active filters
 	for(i=0;i<n_allpass;i++){
-		r->apfs_l[i]->g = g;
-		r->apfs_r[i]->g = g;
+		r->apfs_l[i].g = g;
+		r->apfs_r[i].g = g;
 	}
 	
 	LADSPA_Data alpha = powf(10.0,-60/20);
 	for(i=0;i<n_comb;i++){
-		r->fbcfs_l[i]->g = -powf(alpha,(float)r->fbcfs_l[i]->cb->N/r->sample_rate/t60db);
-		r->fbcfs_r[i]->g = -powf(alpha,(float)r->fbcfs_r[i]->cb->N/r->sample_rate/t60db);
+		r->fbcfs_l[i].g = -powf(alpha,(float)r->fbcfs_l[i].cb.N/r->sample_rate/t60db);
+		r->fbcfs_r[i].g = -powf(alpha,(float)r->fbcfs_r[i].cb.N/r->sample_rate/t60db);
 	}
 	
-	for(i=SampleCount;i;i--){
-		LADSPA_Data x_l=*src_l;
-		LADSPA_Data x_r=*src_r;
-		if(n_allpass){
-			int a;
-			APF **apf_l = r->apfs_l;
-			APF **apf_r = r->apfs_r;
-			for(a=n_allpass;a;a--){
-				x_l = apf_evaluate(*apf_l,x_l);
-				x_r = apf_evaluate(*apf_r,x_r);
-				apf_l++;
-				apf_r++;
-			}
+	// each filter runs through a block at a time, the allpasses in
+	// turn and then the combs into the sums
+	while(SampleCount){
+		unsigned long n = SampleCount < REVERB_BLOCK ? SampleCount : REVERB_BLOCK;
+		LADSPA_Data x_l[REVERB_BLOCK];
+		LADSPA_Data x_r[REVERB_BLOCK];
+		LADSPA_Data s_l[REVERB_BLOCK];
+		LADSPA_Data s_r[REVERB_BLOCK];
+		memcpy(x_l,src_l,sizeof(LADSPA_Data)*n);
+		memcpy(x_r,src_r,sizeof(LADSPA_Data)*n);
+		for(i=0;i<n_allpass;i++){
+			apf_run(&r->apfs_l[i],x_l,n);
+			apf_run(&r->apfs_r[i],x_r,n);
 		}
-		LADSPA_Data s_l=0.0;
-		LADSPA_Data s_r=0.0;
 		if(n_comb){
-			int c;
-			FBCF **fbcf_l = r->fbcfs_l;
-			FBCF **fbcf_r = r->fbcfs_r;
-			for(c=n_comb;c;c--){
-				s_l+=fbcf_evaluate(*fbcf_l,x_l);
-				s_r+=fbcf_evaluate(*fbcf_r,x_r);
-				fbcf_l++;
-				fbcf_r++;
+			memset(s_l,0,sizeof(LADSPA_Data)*n);
+			memset(s_r,0,sizeof(LADSPA_Data)*n);
+			for(i=0;i<n_comb;i++){
+				fbcf_run(&r->fbcfs_l[i],x_l,s_l,n);
+				fbcf_run(&r->fbcfs_r[i],x_r,s_r,n);
+			}
+			for(i=0;i<n;i++){
+				s_l[i]/=n_comb;
+				s_r[i]/=n_comb;
 			}
-			s_l/=n_comb;
-			s_r/=n_comb;
 		}else{
-			s_l = x_l;
-			s_r = x_r;
+			memcpy(s_l,x_l,sizeof(LADSPA_Data)*n);
+			memcpy(s_r,x_r,sizeof(LADSPA_Data)*n);
 		}
-        *dst_l = s_l*A_wet + *src_l*A_dry;
-        *dst_r = s_r*A_wet + *src_r*A_dry;
-		src_l++;
-		src_r++;
-		dst_l++;
-		dst_r++;
+		for(i=0;i<n;i++){
+			dst_l[i] = s_l[i]*A_wet + src_l[i]*A_dry;
+			dst_r[i] = s_r[i]*A_wet + src_r[i]*A_dry;
+		}
+		src_l += n;
+		src_r += n;
+		dst_l += n;
+		dst_r += n;
+		SampleCount -= n;
 	}
 	r->n_allpass_prev = n_allpass;
 	r->n_comb_prev = n_comb;
@@ -312,15 +344,7 @@ static void Reverb_run(LADSPA_Handle Instance,
 static void Reverb_cleanup(LADSPA_Handle Instance)
 {
 	Reverb *r=(Reverb*)Instance;
-	int i;
-	for(i=0;i<N_ALLPASS;i++){
-		apf_destroy(r->apfs_l[i]);
-		apf_destroy(r->apfs_r[i]);
-	}
-	for(i=0;i<N_COMB;i++){
-		fbcf_destroy(r->fbcfs_l[i]);
-		fbcf_destroy(r->fbcfs_r[i]);
-	}
+	free(r->arena);
 	free(r);
 }
 
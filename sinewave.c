@@ -27,6 +27,7 @@ Contact: tim.krause@twkrause.ca
 #define _GNU_SOURCE
 #include <math.h>
 #include <stdlib.h>
+#include "fast_math.h"
 
 enum {
 	PORT_OUT,
@@ -108,7 +109,7 @@ static void SineWave_run(
     LADSPA_Data *l_pdst_end = l_pdst + p_sample_count;
     LADSPA_Data l_phase = p_pSineWave->m_phase;
     for(;l_pdst!=l_pdst_end;l_pdst++){
-        *l_pdst = sinf(l_phase)*l_amp;
+        *l_pdst = FM_sinf(l_phase)*l_amp;
         l_dphase = 2.0f*M_PIf*l_f/p_pSineWave->m_sample_rate;
         l_phase+=l_dphase;
         if(l_phase >= 2.0f*M_PIf){
@@ -0,0 +1,191 @@
+/*
+
+twk.so is a set of LADSPA plugins.
+
+Copyright 2024 Tim Krause
+
+This file is part of twk.so.
+
+twk.so is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published
+by the Free Software Foundation, either version 3 of the License,
+or (at your option) any later version.
+
+twk.so is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with twk.so. If not, see
+<https://www.gnu.org/licenses/>.
+
+Contact: tim.krause@twkrause.ca
+
+*/
+#include <ladspa.h>
+
+/*
+ * Zero delay feedback (topology preserving transform) state variable
+ * filter core for the modulated filters. The integrators are
+ * trapezoidal, so the response is the bilinear transform of the
+ * analog one and the filter stays stable however fast the cutoff
+ * moves.
+ *
+ * g = tan(pi*fc/fs) comes from the [5/4] Pade approximant
+ *
+ *              x*(945 - 105*x^2 + x^4)     n
+ *   tan(x) ~= ------------------------- = ---
+ *              945 - 420*x^2 + 15*x^4      d
+ *
+ * which is within 3e-5 relative up to fc = 0.45*fs. fc is clamped to
+ * [SVF_FN_MIN*fs, SVF_FN_MAX*fs], n > 0 and d > 0 there.
+ *
+ * Band pass, unity gain at fc, -3 dB bandwidth B in Hertz
+ *
+ *   b  = pi*B/fs
+ *   k  = b*(1 + g^2)/g           (keeps B constant in Hertz)
+ *   a1 = 1/(1 + g*(g + k)) = 1/((1 + b)*(1 + g^2))
+ *   a2 = g*a1
+ *   a3 = g*a2
+ *
+ *   v3 = x - ic2
+ *   v1 = a1*ic1 + a2*v3
+ *   v2 = ic2 + a2*ic1 + a3*v3
+ *   ic1 = 2*v1 - ic1, ic2 = 2*v2 - ic2
+ *   y  = k*v1
+ *
+ * With g = n/d all of k, a1, a2, a3 share one reciprocal
+ *
+ *   r  = 1/(n*d*(1 + b)*(n^2 + d^2))
+ *   a1 = n*d^3*r, a2 = n^2*d^2*r, a3 = n^3*d*r
+ *   k  = b*(1 + b)*(n^2 + d^2)^2*r
+ *
+ * First order all pass, G = g/(1 + g) = n/(n + d)
+ *
+ *   v  = (x - s)*G
+ *   lp = v + s, s = lp + v
+ *   y  = 2*lp - x
+ */
+
+#define SVF_FN_MAX 0.49f
+#define SVF_FN_MIN 1.0e-6f
+#define SVF_CHUNK 64
+
+typedef struct {
+    LADSPA_Data m_ic1;
+    LADSPA_Data m_ic2;
+} SVF_State;
+
+/*
+ * Per sample coefficients for up to SVF_CHUNK samples. They do not
+ * depend on the filter state, so they are computed for a whole chunk
+ * in a loop without branches, which the compiler vectorizes, before
+ * the recursion runs.
+ */
+typedef struct {
+    LADSPA_Data m_a1[SVF_CHUNK];
+    LADSPA_Data m_a2[SVF_CHUNK];
+    LADSPA_Data m_a3[SVF_CHUNK];
+    LADSPA_Data m_k[SVF_CHUNK];
+} SVF_Coeffs;
+
+static inline void SVF_init( SVF_State *p_psvf )
+{
+    p_psvf->m_ic1 = 0.0f;
+    p_psvf->m_ic2 = 0.0f;
+}
+
+/*
+ * fc/fs clamped to [SVF_FN_MIN, SVF_FN_MAX], use when filling the
+ * frequency arrays below.
+ */
+static inline LADSPA_Data SVF_fn( LADSPA_Data p_fc, LADSPA_Data p_rfs )
+{
+    LADSPA_Data l_fn = p_fc*p_rfs;
+    if(!(l_fn > SVF_FN_MIN))
+        l_fn = SVF_FN_MIN;
+    if(l_fn > SVF_FN_MAX)
+        l_fn = SVF_FN_MAX;
+    return l_fn;
+}
+
+/*
+ * p_pfn[i] = fc/fs from SVF_fn(), p_b = pi*B/fs
+ */
+static inline void SVF_bandpass_coeffs( SVF_Coeffs *p_pc,
+                                        const LADSPA_Data *p_pfn,
+                                        LADSPA_Data p_b,
+                                        unsigned long p_n )
+{
+    for(unsigned long i=0;i<p_n;i++){
+        LADSPA_Data x = 3.14159265f*p_pfn[i];
+        LADSPA_Data x2 = x*x;
+        LADSPA_Data n = x*(945.0f + x2*(-105.0f + x2));
+        LADSPA_Data d = 945.0f + x2*(-420.0f + 15.0f*x2);
+        LADSPA_Data nd = n*d;
+        LADSPA_Data m = n*n + d*d;
+        LADSPA_Data r = 1.0f/(nd*(1.0f + p_b)*m);
+        p_pc->m_a1[i] = nd*d*d*r;
+        p_pc->m_a2[i] = nd*nd*r;
+        p_pc->m_a3[i] = nd*n*n*r;
+        p_pc->m_k[i] = p_b*(1.0f + p_b)*m*m*r;
+    }
+}
+
+/*
+ * p_pdst[i] = p_G*y[i], may run in place
+ */
+static inline void SVF_bandpass( SVF_State *p_psvf,
+                                     const SVF_Coeffs *p_pc,
+                                     const LADSPA_Data *p_psrc,
+                                     LADSPA_Data *p_pdst,
+                                     LADSPA_Data p_G,
+                                     unsigned long p_n )
+{
+    LADSPA_Data ic1 = p_psvf->m_ic1;
+    LADSPA_Data ic2 = p_psvf->m_ic2;
+    for(unsigned long i=0;i<p_n;i++){
+        LADSPA_Data v3 = p_psrc[i] - ic2;
+        LADSPA_Data v1 = p_pc->m_a1[i]*ic1 + p_pc->m_a2[i]*v3;
+        LADSPA_Data v2 = ic2 + p_pc->m_a2[i]*ic1 + p_pc->m_a3[i]*v3;
+        ic1 = 2.0f*v1 - ic1;
+        ic2 = 2.0f*v2 - ic2;
+        p_pdst[i] = p_G*p_pc->m_k[i]*v1;
+    }
+    p_psvf->m_ic1 = ic1;
+    p_psvf->m_ic2 = ic2;
+}
+
+/*
+ * G of the first order sections, p_pfn[i] = fc/fs from SVF_fn()
+ */
+static inline void SVF_allpass1_coeffs( LADSPA_Data *p_pG,
+                                        const LADSPA_Data *p_pfn,
+                                        unsigned long p_n )
+{
+    for(unsigned long i=0;i<p_n;i++){
+        LADSPA_Data x = 3.14159265f*p_pfn[i];
+        LADSPA_Data x2 = x*x;
+        LADSPA_Data n = x*(945.0f + x2*(-105.0f + x2));
+        LADSPA_Data d = 945.0f + x2*(-420.0f + 15.0f*x2);
+        p_pG[i] = n/(n + d);
+    }
+}
+
+/*
+ * In place, p_pbuf[i] = H(p_pbuf[i])
+ */
+static inline void SVF_allpass1( SVF_State *p_psvf, const LADSPA_Data *p_pG,
+                                 LADSPA_Data *p_pbuf, unsigned long p_n )
+{
+    LADSPA_Data s = p_psvf->m_ic1;
+    for(unsigned long i=0;i<p_n;i++){
+        LADSPA_Data x = p_pbuf[i];
+        LADSPA_Data v = (x - s)*p_pG[i];
+        LADSPA_Data lp = v + s;
+        s = lp + v;
+        p_pbuf[i] = 2.0f*lp - x;
+    }
+    p_psvf->m_ic1 = s;
+}
@@ -59,6 +59,12 @@ Contact: tim.krause@twkrause.ca
 #include "elliptical_bp.h"
 #include "elliptical_bs.h"
 #include "pitch_shifter.h"
+#include "parametric_eq.h"
+#include "mod_filter.h"
+#include "compressor_linked.h"
+#include "compressor_multiband.h"
+#include "delay_multitap.h"
+#include "chorus.h"
 
 const LADSPA_Descriptor *dTable[]=
 {
@@ -96,6 +102,12 @@ const LADSPA_Descriptor *dTable[]=
     &Ellip_BP_Descriptor,          // 5832
     &Ellip_BS_Descriptor,          // 5833
     &PShift_Descriptor,            // 5834
+    &ParametricEQ_Descriptor,      // 5835
+    &ModFilter_Descriptor,         // 5836
+    &CompressorLinked_Descriptor,  // 5837
+    &CompressorMultiband_Descriptor, // 5838
+    &DelayMultitap_Descriptor,     // 5839
+    &Chorus_Descriptor,            // 5840
     NULL
 };
 